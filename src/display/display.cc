@@ -29,6 +29,7 @@
 #include "display.hh"
 
 #include "util/exception.hh"
+#include "util/latency.hh"
 
 using namespace std;
 
@@ -97,21 +98,14 @@ const string VideoDisplay::shader_source_rgb = R"( #version 130
 
       precision mediump float;
 
-      uniform sampler2DRect yTex;
-      uniform sampler2DRect uTex;
-      uniform sampler2DRect vTex;
+      uniform sampler2DRect rgbTex;
 
-      in vec2 uv_texcoord;
       in vec2 raw_position;
       out vec4 outColor;
 
       void main()
       {
-        float fR = texture(yTex, raw_position).x;
-        float fG = texture(uTex, uv_texcoord).x;
-        float fB = texture(vTex, uv_texcoord).x;
-
-        outColor = vec4(fR, fG, fB, 1.0);
+        outColor = vec4(texture(rgbTex, raw_position).rgb, 1.0);
       }
     )";
 
@@ -138,9 +132,7 @@ VideoDisplay::VideoDisplay( const BaseRaster& raster,
                              display_height_,
                              "VP8 Player",
                              fullscreen )
-  , Y_( width_, height_ )
-  , U_( width_ / image_ratio_, height_ / image_ratio_ )
-  , V_( width_ / image_ratio_, height_ / image_ratio_ )
+  , textures_( width_, height_, fromRGB_ )
 {
   texture_shader_program_.attach( scale_from_pixel_coordinates_ );
   if ( fromRGB_ ) {
@@ -163,21 +155,22 @@ VideoDisplay::VideoDisplay( const BaseRaster& raster,
   glEnableVertexAttribArray(
     texture_shader_program_.attribute_location( "position" ) );
 
-  glVertexAttribPointer(
-    texture_shader_program_.attribute_location( "chroma_texcoord" ),
-    2,
-    GL_FLOAT,
-    GL_FALSE,
-    sizeof( VertexObject ),
-    reinterpret_cast<const void*>( 2 * sizeof( float ) ) );
-  glEnableVertexAttribArray(
-    texture_shader_program_.attribute_location( "chroma_texcoord" ) );
+  /* the RGB shader samples at pixel coordinates only */
+  if ( not fromRGB_ ) {
+    glVertexAttribPointer(
+      texture_shader_program_.attribute_location( "chroma_texcoord" ),
+      2,
+      GL_FLOAT,
+      GL_FALSE,
+      sizeof( VertexObject ),
+      reinterpret_cast<const void*>( 2 * sizeof( float ) ) );
+    glEnableVertexAttribArray(
+      texture_shader_program_.attribute_location( "chroma_texcoord" ) );
+  }
 
   glfwSwapInterval( 1 );
 
-  Y_.bind( GL_TEXTURE0 );
-  U_.bind( GL_TEXTURE1 );
-  V_.bind( GL_TEXTURE2 );
+  textures_.use();
 
   const pair<unsigned int, unsigned int> window_size = window().size();
   resize( window_size );
@@ -194,9 +187,13 @@ void VideoDisplay::resize( const pair<unsigned int, unsigned int>& target_size )
                 target_size.first,
                 target_size.second );
 
-  glUniform1i( texture_shader_program_.uniform_location( "yTex" ), 0 );
-  glUniform1i( texture_shader_program_.uniform_location( "uTex" ), 1 );
-  glUniform1i( texture_shader_program_.uniform_location( "vTex" ), 2 );
+  if ( fromRGB_ ) {
+    glUniform1i( texture_shader_program_.uniform_location( "rgbTex" ), 0 );
+  } else {
+    glUniform1i( texture_shader_program_.uniform_location( "yTex" ), 0 );
+    glUniform1i( texture_shader_program_.uniform_location( "uTex" ), 1 );
+    glUniform1i( texture_shader_program_.uniform_location( "vTex" ), 2 );
+  }
 
   const float xoffset = 0.25;
 
@@ -221,23 +218,16 @@ void VideoDisplay::resize( const pair<unsigned int, unsigned int>& target_size )
 
 void VideoDisplay::draw( const BaseRaster& raster )
 {
-  current_context_window_.window_.make_context_current( true );
-
-  if ( width_ != raster.width() or height_ != raster.height() ) {
-    throw Invalid( "inconsistent raster dimensions." );
-  }
-
-  Y_.load( raster.Y() );
-  U_.load( raster.U() );
-  V_.load( raster.V() );
+  current_context_window_.window_.make_context_current();
 
+  textures_.upload( raster );
   repaint();
 }
 
 void VideoDisplay::repaint( void )
 {
   pair<unsigned int, unsigned int> window_size
-    = current_context_window_.window_.window_size();
+    = current_context_window_.window_.size();
 
   if ( window_size.first != display_width_
        or window_size.second != display_height_ ) {
@@ -251,5 +241,6 @@ void VideoDisplay::repaint( void )
   texture_shader_program_.use();
   glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
 
+  const latency::ScopedTimer swap_timer { latency::Stage::Swap };
   current_context_window_.window_.swap_buffers();
 }
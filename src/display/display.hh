@@ -32,16 +32,25 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+
+#include "frame_sink.hh"
+#include "frame_textures.hh"
 #include "gl_objects.hh"
 #include "util/raster.hh"
 
-class VideoDisplay
+class VideoDisplay : public FrameSink
 {
-private:
-  static const std::string shader_source_scale_from_pixel_coordinates;
+public:
+  using UploadStatistics = FrameTextures::UploadStatistics;
+
+  // Fragment shaders that sample a frame at raw_position (and its chroma
+  // at uv_texcoord); shared with MultiViewDisplay
   static const std::string shader_source_ycbcr;
   static const std::string shader_source_rgb;
 
+private:
+  static const std::string shader_source_scale_from_pixel_coordinates;
+
   unsigned int display_width_, display_height_;
   unsigned int width_, height_;
   bool fromRGB_;
@@ -49,7 +58,6 @@ private:
 
   struct CurrentContextWindow
   {
-    GLFWContext glfw_context_ = {};
     Window window_;
 
     CurrentContextWindow( const unsigned int width,
@@ -65,7 +73,7 @@ private:
 
   Program texture_shader_program_ = {};
 
-  Texture Y_, U_, V_;
+  FrameTextures textures_;
 
   VertexArrayObject texture_shader_array_object_ = {};
   VertexBufferObject screen_corners_ = {};
@@ -79,11 +87,19 @@ public:
   VideoDisplay( const VideoDisplay& other ) = delete;
   VideoDisplay& operator=( const VideoDisplay& other ) = delete;
 
-  void draw( const BaseRaster& raster );
+  using FrameSink::draw;
+  void draw( const BaseRaster& raster ) override;
   void repaint( void );
   void resize( const std::pair<unsigned int, unsigned int>& target_size );
 
   const Window& window( void ) const { return current_context_window_.window_; }
+  Window& window( void ) { return current_context_window_.window_; }
+
+  // Time spent in draw() getting frames to the GPU (not drawing them)
+  const UploadStatistics& upload_statistics() const
+  {
+    return textures_.upload_statistics();
+  }
 };
 
 #endif /* DISPLAY_HH */
@@ -0,0 +1,50 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "frame_mailbox.hh"
+
+#include "util/exception.hh"
+
+using namespace std;
+
+FrameMailbox::FrameMailbox( const uint16_t width,
+                            const uint16_t height,
+                            const bool fromRGB )
+{
+  const uint8_t ratio = fromRGB ? 1 : 2;
+  for ( auto& buffer : buffers_ ) {
+    buffer
+      = make_unique<BaseRaster>( width, height, width, height, ratio, ratio );
+  }
+}
+
+void FrameMailbox::publish( const BaseRaster& raster )
+{
+  BaseRaster& back = *buffers_[back_buffer_];
+  if ( raster.width() != back.width() or raster.height() != back.height()
+       or raster.U().width() != back.U().width()
+       or raster.U().height() != back.U().height() ) {
+    throw Invalid( "inconsistent raster dimensions." );
+  }
+
+  back.copy_from( raster );
+
+  const uint8_t previous
+    = slot_.exchange( back_buffer_ | NEW_FRAME, memory_order_acq_rel );
+  back_buffer_ = previous & BUFFER_MASK;
+
+  published_frames_++;
+  if ( previous & NEW_FRAME ) {
+    skipped_frames_++;
+  }
+}
+
+const BaseRaster* FrameMailbox::take_if_new()
+{
+  if ( not( slot_.load( memory_order_acquire ) & NEW_FRAME ) ) {
+    return nullptr;
+  }
+
+  front_buffer_ = slot_.exchange( front_buffer_, memory_order_acq_rel )
+                  & BUFFER_MASK;
+  return buffers_[front_buffer_].get();
+}
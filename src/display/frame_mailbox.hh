@@ -0,0 +1,64 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef FRAME_MAILBOX_HH
+#define FRAME_MAILBOX_HH
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+#include "util/raster.hh"
+
+/* Hands the newest frame from one thread (the producer) to another (the
+   consumer) without either ever waiting for the other.
+
+   The mailbox has three frame buffers: one being filled, one in the single
+   slot, and one held by the consumer. publish() copies the frame into the
+   spare buffer and atomically exchanges it with the one in the slot;
+   take_if_new() exchanges the consumer's buffer with the slot when a newer
+   frame is waiting there. A frame replaced before the consumer took it is
+   counted as skipped. */
+
+class FrameMailbox
+{
+private:
+  static constexpr uint8_t NEW_FRAME = 0x80;
+  static constexpr uint8_t BUFFER_MASK = 0x7f;
+
+  std::array<std::unique_ptr<BaseRaster>, 3> buffers_ {};
+
+  // Index of the buffer in the slot, plus NEW_FRAME if it is unseen
+  std::atomic<uint8_t> slot_ { 1 };
+
+  // Used only by publish()
+  uint8_t back_buffer_ { 0 };
+
+  // Used only by take_if_new()
+  uint8_t front_buffer_ { 2 };
+
+  std::atomic<uint64_t> published_frames_ { 0 };
+  std::atomic<uint64_t> skipped_frames_ { 0 };
+
+public:
+  // Buffers for frames of this size, with full-size chroma planes if
+  // fromRGB and 2:1 subsampled ones otherwise
+  FrameMailbox( const uint16_t width,
+                const uint16_t height,
+                const bool fromRGB );
+
+  /* forbid copying */
+  FrameMailbox( const FrameMailbox& other ) = delete;
+  FrameMailbox& operator=( const FrameMailbox& other ) = delete;
+
+  // Producer: copies the frame in, replacing any frame not yet taken
+  void publish( const BaseRaster& raster );
+
+  // Consumer: the newest frame if it arrived since the last call, or null;
+  // valid until the next call
+  const BaseRaster* take_if_new();
+
+  uint64_t published_frames() const { return published_frames_; }
+  uint64_t skipped_frames() const { return skipped_frames_; }
+};
+
+#endif /* FRAME_MAILBOX_HH */
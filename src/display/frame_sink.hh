@@ -0,0 +1,26 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef FRAME_SINK_HH
+#define FRAME_SINK_HH
+
+#include "util/raster.hh"
+
+/* Where finished frames go: a window (VideoDisplay), or one of the headless
+   sinks for servers and benchmarks.
+
+   Sinks that can only take RGB frames override the RGBRaster overload and
+   reject everything drawn as a BaseRaster; the rest override only the
+   BaseRaster overload, which RGB frames are passed on to. */
+
+class FrameSink
+{
+public:
+  virtual void draw( const BaseRaster& raster ) = 0;
+  virtual void draw( const RGBRaster& raster )
+  {
+    draw( static_cast<const BaseRaster&>( raster ) );
+  }
+  virtual ~FrameSink() = default;
+};
+
+#endif /* FRAME_SINK_HH */
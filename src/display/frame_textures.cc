@@ -0,0 +1,154 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "frame_textures.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "util/exception.hh"
+#include "util/latency.hh"
+#include "util/pixel_convert.hh"
+
+using namespace std;
+
+FrameTextures::FrameTextures( const unsigned int width,
+                              const unsigned int height,
+                              const bool fromRGB )
+  : width_( width )
+  , height_( height )
+  , fromRGB_( fromRGB )
+  , Y_( width_, height_ )
+  , U_( fromRGB_ ? 1 : width_ / 2, fromRGB_ ? 1 : height_ / 2 )
+  , V_( fromRGB_ ? 1 : width_ / 2, fromRGB_ ? 1 : height_ / 2 )
+{
+  /* allocates each texture's storage */
+  Y_.bind( GL_TEXTURE0 );
+  if ( not fromRGB_ ) {
+    U_.bind( GL_TEXTURE1 );
+    V_.bind( GL_TEXTURE2 );
+  }
+}
+
+void FrameTextures::use()
+{
+  Y_.use( GL_TEXTURE0 );
+  if ( not fromRGB_ ) {
+    U_.use( GL_TEXTURE1 );
+    V_.use( GL_TEXTURE2 );
+  }
+}
+
+uint8_t* FrameTextures::map_upload_buffer( const size_t length )
+{
+  PixelUnpackBuffer::bind( upload_buffers_[next_upload_buffer_] );
+  next_upload_buffer_ = ( next_upload_buffer_ + 1 ) % UPLOAD_BUFFER_COUNT;
+
+  /* orphan the buffer's old storage, in case a copy out of it is still in
+     flight, so mapping it never waits for the GPU */
+  glBufferData( PixelUnpackBuffer::id, length, nullptr, GL_STREAM_DRAW );
+  uint8_t* const staging = static_cast<uint8_t*>(
+    glMapBufferRange( PixelUnpackBuffer::id,
+                      0,
+                      length,
+                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT ) );
+
+  if ( not staging ) {
+    glCheck( "mapping upload buffer", true );
+    PixelUnpackBuffer::unbind();
+    upload_statistics_.unbuffered_frames++;
+  }
+
+  return staging;
+}
+
+void FrameTextures::upload( const BaseRaster& raster )
+{
+  if ( width_ != raster.width() or height_ != raster.height() ) {
+    throw Invalid( "inconsistent raster dimensions." );
+  }
+
+  const auto upload_start = chrono::steady_clock::now();
+
+  if ( fromRGB_ ) {
+    upload_rgba( raster );
+  } else {
+    upload_planes( raster );
+  }
+
+  const uint64_t upload_ns = chrono::duration_cast<chrono::nanoseconds>(
+                               chrono::steady_clock::now() - upload_start )
+                               .count();
+
+  upload_statistics_.frames++;
+  upload_statistics_.total_ns += upload_ns;
+  upload_statistics_.max_ns = max( upload_statistics_.max_ns, upload_ns );
+  latency::record( latency::Stage::Upload, upload_ns );
+}
+
+void FrameTextures::upload_planes( const BaseRaster& raster )
+{
+  const TwoD<uint8_t>* const planes[]
+    = { &raster.Y(), &raster.U(), &raster.V() };
+  Texture* const textures[] = { &Y_, &U_, &V_ };
+
+  size_t plane_offsets[3], plane_lengths[3];
+  size_t length = 0;
+  for ( unsigned int i = 0; i < 3; i++ ) {
+    plane_offsets[i] = length;
+    plane_lengths[i] = size_t { planes[i]->width() } * planes[i]->height();
+    length += plane_lengths[i];
+  }
+
+  uint8_t* const staging = map_upload_buffer( length );
+
+  if ( not staging ) {
+    for ( unsigned int i = 0; i < 3; i++ ) {
+      textures[i]->load( *planes[i] );
+    }
+    return;
+  }
+
+  for ( unsigned int i = 0; i < 3; i++ ) {
+    memcpy(
+      staging + plane_offsets[i], &planes[i]->at( 0, 0 ), plane_lengths[i] );
+  }
+  glUnmapBuffer( PixelUnpackBuffer::id );
+
+  for ( unsigned int i = 0; i < 3; i++ ) {
+    textures[i]->load_from_buffer( plane_offsets[i] );
+  }
+
+  PixelUnpackBuffer::unbind();
+}
+
+void FrameTextures::upload_rgba( const BaseRaster& raster )
+{
+  /* the planes are interleaved on the way into the staging buffer, so the
+     frame goes up as a single RGBA texture */
+  const size_t row_length = 4 * size_t { width_ };
+
+  uint8_t* staging = map_upload_buffer( row_length * height_ );
+  const bool buffered = staging != nullptr;
+
+  if ( not buffered ) {
+    unbuffered_rgba_.resize( row_length * height_ );
+    staging = unbuffered_rgba_.data();
+  }
+
+  for ( unsigned int row = 0; row < height_; row++ ) {
+    pixel_convert::rgb_row_to_rgba( &raster.Y().at( 0, row ),
+                                    &raster.U().at( 0, row ),
+                                    &raster.V().at( 0, row ),
+                                    staging + row * row_length,
+                                    width_ );
+  }
+
+  if ( buffered ) {
+    glUnmapBuffer( PixelUnpackBuffer::id );
+    Y_.load_from_buffer( 0, GL_RGBA );
+    PixelUnpackBuffer::unbind();
+  } else {
+    Y_.load_pixels( staging, GL_RGBA );
+  }
+}
@@ -0,0 +1,84 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef FRAME_TEXTURES_HH
+#define FRAME_TEXTURES_HH
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "gl_objects.hh"
+#include "util/raster.hh"
+
+/* The textures holding one frame on the GPU, and the path that gets frames
+   into them. A YCbCr frame is three GL_LUMINANCE planes; an RGB frame is a
+   single RGBA texture in Y(), with U() and V() unused.
+
+   Frames are staged in a ring of pixel buffer objects, each orphaned
+   before it is refilled, so the texture upload is an asynchronous copy out
+   of a buffer the driver owns instead of a synchronous copy out of the
+   raster. RGB planes are interleaved on their way into the buffer.
+
+   Needs the context it was created in to be current. */
+
+class FrameTextures
+{
+public:
+  struct UploadStatistics
+  {
+    uint64_t frames;
+    uint64_t total_ns;
+    uint64_t max_ns;
+
+    // frames uploaded straight from client memory, because a buffer could
+    // not be mapped
+    uint64_t unbuffered_frames;
+  };
+
+private:
+  unsigned int width_, height_;
+  bool fromRGB_;
+
+  Texture Y_, U_, V_;
+
+  static constexpr unsigned int UPLOAD_BUFFER_COUNT = 3;
+  std::array<PixelBufferObject, UPLOAD_BUFFER_COUNT> upload_buffers_ {};
+  unsigned int next_upload_buffer_ { 0 };
+
+  // RGBA staging for when no buffer can be mapped
+  std::vector<uint8_t> unbuffered_rgba_ {};
+
+  UploadStatistics upload_statistics_ {};
+
+  // The bound, mapped next upload buffer, or nullptr (and none bound)
+  uint8_t* map_upload_buffer( const size_t length );
+
+  void upload_planes( const BaseRaster& raster );
+  void upload_rgba( const BaseRaster& raster );
+
+public:
+  FrameTextures( const unsigned int width,
+                 const unsigned int height,
+                 const bool fromRGB );
+
+  /* forbid copying */
+  FrameTextures( const FrameTextures& other ) = delete;
+  FrameTextures& operator=( const FrameTextures& other ) = delete;
+
+  void upload( const BaseRaster& raster );
+
+  // Binds the textures to units 0 (Y or RGBA), 1 (U) and 2 (V)
+  void use();
+
+  unsigned int width() const { return width_; }
+  unsigned int height() const { return height_; }
+  bool fromRGB() const { return fromRGB_; }
+
+  // Time spent getting frames to the GPU (not drawing them)
+  const UploadStatistics& upload_statistics() const
+  {
+    return upload_statistics_;
+  }
+};
+
+#endif /* FRAME_TEXTURES_HH */
@@ -28,6 +28,7 @@
 
 #include "gl_objects.hh"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -53,11 +54,32 @@ GLFWContext::~GLFWContext()
   glfwTerminate();
 }
 
+/* only touched from the main thread */
+static weak_ptr<GLFWContext> glfw_instance;
+
+shared_ptr<GLFWContext> GLFWContext::shared()
+{
+  shared_ptr<GLFWContext> context = glfw_instance.lock();
+  if ( not context ) {
+    context.reset( new GLFWContext );
+    glfw_instance = context;
+  }
+  return context;
+}
+
+void GLFWContext::process_events()
+{
+  if ( not glfw_instance.expired() ) {
+    glfwPollEvents();
+  }
+}
+
 Window::Window( const unsigned int width,
                 const unsigned int height,
                 const string& title,
                 const bool fullscreen )
-  : window_()
+  : glfw_context_( GLFWContext::shared() )
+  , window_()
 {
   glfwDefaultWindowHints();
 
@@ -76,6 +98,27 @@ Window::Window( const unsigned int width,
   if ( not window_.get() ) {
     throw runtime_error( "could not create window" );
   }
+
+  glfwSetWindowUserPointer( window_.get(), this );
+  glfwSetFramebufferSizeCallback( window_.get(), resize_callback );
+
+  int framebuffer_width, framebuffer_height;
+  glfwGetFramebufferSize(
+    window_.get(), &framebuffer_width, &framebuffer_height );
+  if ( framebuffer_width < 0 or framebuffer_height < 0 ) {
+    throw runtime_error( "negative framebuffer width or height" );
+  }
+  resize_callback( window_.get(), framebuffer_width, framebuffer_height );
+}
+
+void Window::resize_callback( GLFWwindow* window,
+                              const int width,
+                              const int height )
+{
+  Window* const self
+    = static_cast<Window*>( glfwGetWindowUserPointer( window ) );
+  self->width_ = max( 0, width );
+  self->height_ = max( 0, height );
 }
 
 void Window::make_context_current( const bool initialize_extensions )
@@ -115,26 +158,12 @@ bool Window::key_pressed( const int key ) const
 
 pair<unsigned int, unsigned int> Window::size( void ) const
 {
-  int width, height;
-  glfwGetFramebufferSize( window_.get(), &width, &height );
-
-  if ( width < 0 or height < 0 ) {
-    throw runtime_error( "negative framebuffer width or height" );
-  }
-
-  return pair<unsigned int, unsigned int>( width, height );
+  return pair<unsigned int, unsigned int>( width_, height_ );
 }
 
-pair<unsigned int, unsigned int> Window::window_size() const
+void Window::release_context()
 {
-  int width, height;
-  glfwGetWindowSize( window_.get(), &width, &height );
-
-  if ( width < 0 or height < 0 ) {
-    throw runtime_error( "negative window width or height" );
-  }
-
-  return pair<unsigned int, unsigned int>( width, height );
+  glfwMakeContextCurrent( nullptr );
 }
 
 void Window::Deleter::operator()( GLFWwindow* x ) const
@@ -154,6 +183,17 @@ VertexBufferObject::~VertexBufferObject()
   glDeleteBuffers( 1, &num_ );
 }
 
+PixelBufferObject::PixelBufferObject()
+  : num_()
+{
+  glGenBuffers( 1, &num_ );
+}
+
+PixelBufferObject::~PixelBufferObject()
+{
+  glDeleteBuffers( 1, &num_ );
+}
+
 VertexArrayObject::VertexArrayObject()
   : num_()
 {
@@ -194,6 +234,12 @@ void Texture::bind( const GLenum texture_unit )
   glTexParameteri( GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 }
 
+void Texture::use( const GLenum texture_unit )
+{
+  glActiveTexture( texture_unit );
+  glBindTexture( GL_TEXTURE_RECTANGLE, num_ );
+}
+
 void Texture::resize( const unsigned int width, const unsigned int height )
 {
   width_ = width;
@@ -229,6 +275,27 @@ void Texture::load( const TwoD<uint8_t>& raster )
                    &( raster.at( 0, 0 ) ) );
 }
 
+void Texture::load_pixels( const void* pixels, const GLenum format )
+{
+  glBindTexture( GL_TEXTURE_RECTANGLE, num_ );
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, width_ );
+  glTexSubImage2D( GL_TEXTURE_RECTANGLE_ARB,
+                   0,
+                   0,
+                   0,
+                   width_,
+                   height_,
+                   format,
+                   GL_UNSIGNED_BYTE,
+                   pixels );
+}
+
+void Texture::load_from_buffer( const size_t offset, const GLenum format )
+{
+  /* with a pixel unpack buffer bound, GL takes the pointer as an offset */
+  load_pixels( reinterpret_cast<const void*>( offset ), format );
+}
+
 void compile_shader( const GLuint num, const string& source )
 {
   const char* source_c_str = source.c_str();
@@ -34,20 +34,32 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "util/raster.hh"
 
+/* GLFW itself, initialized while any Window exists. GLFW must be set up and
+   torn down, and its windows created, destroyed and sent events, on the
+   main thread; only making a window's context current and drawing into it
+   (including the swap) may happen on another thread. */
 class GLFWContext
 {
   static void error_callback( const int, const char* const description );
 
-public:
   GLFWContext();
+
+public:
   ~GLFWContext();
 
+  // The process's one GLFWContext, created if there is none
+  static std::shared_ptr<GLFWContext> shared();
+
+  // Handles pending window events (e.g. resizes), if GLFW is initialized
+  static void process_events();
+
   /* forbid copy */
   GLFWContext( const GLFWContext& other ) = delete;
   GLFWContext& operator=( const GLFWContext& other ) = delete;
@@ -59,8 +71,16 @@ class Window
   {
     void operator()( GLFWwindow* x ) const;
   };
+  std::shared_ptr<GLFWContext> glfw_context_;
   std::unique_ptr<GLFWwindow, Deleter> window_;
 
+  // The framebuffer size, updated by GLFWContext::process_events()
+  std::atomic<unsigned int> width_ { 0 }, height_ { 0 };
+
+  static void resize_callback( GLFWwindow* window,
+                               const int width,
+                               const int height );
+
 public:
   Window( const unsigned int width,
           const unsigned int height,
@@ -71,8 +91,12 @@ public:
   void swap_buffers( void );
   void hide_cursor( const bool hidden );
   bool key_pressed( const int key ) const;
+
+  // The framebuffer size, in pixels; may be called from any thread
   std::pair<unsigned int, unsigned int> size( void ) const;
-  std::pair<unsigned int, unsigned int> window_size() const;
+
+  // Leaves the calling thread with no current context
+  static void release_context();
 };
 
 struct VertexObject
@@ -93,6 +117,8 @@ public:
     glBindBuffer( id_, obj.num_ );
   }
 
+  static void unbind( void ) { glBindBuffer( id_, 0 ); }
+
   static void load( const std::vector<VertexObject>& vertices,
                     const GLenum usage )
   {
@@ -104,6 +130,7 @@ public:
 };
 
 using ArrayBuffer = Buffer<GL_ARRAY_BUFFER>;
+using PixelUnpackBuffer = Buffer<GL_PIXEL_UNPACK_BUFFER>;
 
 class VertexBufferObject
 {
@@ -120,6 +147,21 @@ public:
   VertexBufferObject& operator=( const VertexBufferObject& other ) = delete;
 };
 
+class PixelBufferObject
+{
+  friend PixelUnpackBuffer;
+
+  GLuint num_;
+
+public:
+  PixelBufferObject();
+  ~PixelBufferObject();
+
+  /* forbid copy */
+  PixelBufferObject( const PixelBufferObject& other ) = delete;
+  PixelBufferObject& operator=( const PixelBufferObject& other ) = delete;
+};
+
 class VertexArrayObject
 {
   GLuint num_;
@@ -145,8 +187,20 @@ public:
   Texture( const unsigned int width, const unsigned int height );
   ~Texture();
 
+  // Allocates the texture and binds it to `texture_unit`
   void bind( const GLenum texture_unit );
+
+  // Binds the (already allocated) texture to `texture_unit`
+  void use( const GLenum texture_unit );
+
   void load( const TwoD<uint8_t>& raster );
+
+  // Loads `format` pixels (a row per texture row) from client memory
+  void load_pixels( const void* pixels, const GLenum format );
+
+  // Loads from the bound PixelUnpackBuffer, starting `offset` bytes in
+  void load_from_buffer( const size_t offset,
+                         const GLenum format = GL_LUMINANCE );
   void resize( const unsigned int width, const unsigned int height );
   std::pair<unsigned int, unsigned int> size( void ) const
   {
@@ -0,0 +1,52 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "headless_sinks.hh"
+
+#include <stdexcept>
+
+#include "util/bytes.hh"
+
+using namespace std;
+
+static uint64_t fnv1a( const uint64_t hash, const TwoD<uint8_t>& plane )
+{
+  return fnv1a(
+    &plane.at( 0, 0 ), size_t { plane.width() } * plane.height(), hash );
+}
+
+uint64_t ChecksumSink::checksum( const BaseRaster& raster )
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+  hash = fnv1a( hash, raster.Y() );
+  hash = fnv1a( hash, raster.U() );
+  return fnv1a( hash, raster.V() );
+}
+
+void ChecksumSink::draw( const BaseRaster& raster )
+{
+  last_checksum_ = checksum( raster );
+  running_checksum_ = ( running_checksum_ ^ last_checksum_ ) * FNV_PRIME;
+  frame_count_++;
+}
+
+FileSink::FileSink( const string& filename,
+                    const uint16_t width,
+                    const uint16_t height )
+  : recorder_( filename,
+               width,
+               height,
+               30,
+               1,
+               8,
+               Y4MRecorder::OverflowPolicy::Block )
+{}
+
+void FileSink::draw( const BaseRaster& )
+{
+  throw runtime_error( "FileSink records RGB frames only" );
+}
+
+void FileSink::draw( const RGBRaster& raster )
+{
+  recorder_.record( raster );
+}
@@ -0,0 +1,65 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef HEADLESS_SINKS_HH
+#define HEADLESS_SINKS_HH
+
+#include <cstdint>
+#include <string>
+
+#include "frame_sink.hh"
+#include "util/y4m_recorder.hh"
+
+/* Discards frames, only counting them */
+class NullSink : public FrameSink
+{
+private:
+  uint64_t frame_count_ { 0 };
+
+public:
+  using FrameSink::draw;
+  void draw( const BaseRaster& ) override { frame_count_++; }
+
+  uint64_t frame_count() const { return frame_count_; }
+};
+
+/* Hashes every frame (FNV-1a over the Y/U/V or R/G/B planes), so that two
+   runs of the pipeline can be compared without keeping their output */
+class ChecksumSink : public FrameSink
+{
+private:
+  uint64_t frame_count_ { 0 };
+  uint64_t last_checksum_ { 0 };
+  uint64_t running_checksum_ { 0 };
+
+public:
+  using FrameSink::draw;
+  void draw( const BaseRaster& raster ) override;
+
+  static uint64_t checksum( const BaseRaster& raster );
+
+  uint64_t frame_count() const { return frame_count_; }
+
+  // Checksum of the most recent frame
+  uint64_t last_checksum() const { return last_checksum_; }
+
+  // Combines the checksums of all frames so far, in order
+  uint64_t running_checksum() const { return running_checksum_; }
+};
+
+/* Records RGB frames to a Y4M file (through a Y4MRecorder that waits
+   rather than drop frames). Frames drawn as a BaseRaster are rejected. */
+class FileSink : public FrameSink
+{
+private:
+  Y4MRecorder recorder_;
+
+public:
+  FileSink( const std::string& filename,
+            const uint16_t width,
+            const uint16_t height );
+
+  void draw( const BaseRaster& raster ) override;
+  void draw( const RGBRaster& raster ) override;
+};
+
+#endif /* HEADLESS_SINKS_HH */
@@ -0,0 +1,200 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "multi_view_display.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#include "display.hh"
+#include "util/exception.hh"
+#include "util/latency.hh"
+
+using namespace std;
+
+/* positions arrive in normalized device coordinates and texture coordinates
+   in source pixels; chroma is sited as in VideoDisplay */
+const string MultiViewDisplay::shader_source_scale_to_view
+  = R"( #version 130
+
+      in vec2 position;
+      in vec2 texcoord;
+      out vec2 raw_position;
+      out vec2 uv_texcoord;
+
+      void main()
+      {
+        gl_Position = vec4( position.x, position.y, 0.0, 1.0 );
+        raw_position = texcoord;
+        uv_texcoord = vec2( texcoord.x / 2 + 0.25, texcoord.y / 2 );
+      }
+    )";
+
+MultiViewDisplay::CurrentContextWindow::CurrentContextWindow(
+  const unsigned int width,
+  const unsigned int height,
+  const bool fullscreen )
+  : window_( width, height, "Multiview", fullscreen )
+{
+  window_.make_context_current( true );
+}
+
+MultiViewDisplay::MultiViewDisplay( const vector<ViewFormat>& views,
+                                    const unsigned int width,
+                                    const unsigned int height,
+                                    const bool fullscreen )
+  : current_context_window_( width, height, fullscreen )
+  , ycbcr_shader_( VideoDisplay::shader_source_ycbcr )
+  , rgb_shader_( VideoDisplay::shader_source_rgb )
+{
+  if ( views.empty() ) {
+    throw runtime_error( "MultiViewDisplay needs at least one view" );
+  }
+
+  setup_program( ycbcr_program_, ycbcr_array_object_, false );
+  setup_program( rgb_program_, rgb_array_object_, true );
+
+  for ( const auto& view : views ) {
+    views_.push_back(
+      make_unique<FrameTextures>( view.width, view.height, view.fromRGB ) );
+  }
+  has_frame_.resize( views_.size(), false );
+
+  glfwSwapInterval( 1 );
+
+  const pair<unsigned int, unsigned int> window_size = window().size();
+  layout( window_size.first, window_size.second );
+
+  glCheck( "after creating multiview" );
+}
+
+void MultiViewDisplay::setup_program( Program& program,
+                                      VertexArrayObject& array_object,
+                                      const bool fromRGB )
+{
+  program.attach( scale_to_view_ );
+  program.attach( fromRGB ? rgb_shader_ : ycbcr_shader_ );
+  program.link();
+  glCheck( "after linking multiview shader program" );
+
+  array_object.bind();
+  ArrayBuffer::bind( view_corners_ );
+  glVertexAttribPointer( program.attribute_location( "position" ),
+                         2,
+                         GL_FLOAT,
+                         GL_FALSE,
+                         sizeof( VertexObject ),
+                         0 );
+  glEnableVertexAttribArray( program.attribute_location( "position" ) );
+  glVertexAttribPointer( program.attribute_location( "texcoord" ),
+                         2,
+                         GL_FLOAT,
+                         GL_FALSE,
+                         sizeof( VertexObject ),
+                         reinterpret_cast<const void*>( 2 * sizeof( float ) ) );
+  glEnableVertexAttribArray( program.attribute_location( "texcoord" ) );
+
+  program.use();
+  if ( fromRGB ) {
+    glUniform1i( program.uniform_location( "rgbTex" ), 0 );
+  } else {
+    glUniform1i( program.uniform_location( "yTex" ), 0 );
+    glUniform1i( program.uniform_location( "uTex" ), 1 );
+    glUniform1i( program.uniform_location( "vTex" ), 2 );
+  }
+}
+
+void MultiViewDisplay::layout( const unsigned int width,
+                               const unsigned int height )
+{
+  display_width_ = width;
+  display_height_ = height;
+  glViewport( 0, 0, width, height );
+
+  /* a grid as close to square as possible, filled row by row */
+  const unsigned int columns = ceil( sqrt( views_.size() ) );
+  const unsigned int rows = ( views_.size() + columns - 1 ) / columns;
+  const float cell_width = float( width ) / columns;
+  const float cell_height = float( height ) / rows;
+
+  vector<VertexObject> corners;
+  for ( size_t i = 0; i < views_.size(); i++ ) {
+    const float source_width = views_[i]->width();
+    const float source_height = views_[i]->height();
+    const float scale
+      = min( cell_width / source_width, cell_height / source_height );
+
+    const float left = ( i % columns ) * cell_width
+                       + ( cell_width - source_width * scale ) / 2;
+    const float top = ( i / columns ) * cell_height
+                      + ( cell_height - source_height * scale ) / 2;
+    const float right = left + source_width * scale;
+    const float bottom = top + source_height * scale;
+
+    const float x0 = 2 * left / width - 1, x1 = 2 * right / width - 1;
+    const float y0 = 1 - 2 * top / height, y1 = 1 - 2 * bottom / height;
+
+    corners.push_back( { { x0, y0, 0, 0 } } );
+    corners.push_back( { { x0, y1, 0, source_height } } );
+    corners.push_back( { { x1, y1, source_width, source_height } } );
+    corners.push_back( { { x1, y0, source_width, 0 } } );
+  }
+
+  ArrayBuffer::bind( view_corners_ );
+  ArrayBuffer::load( corners, GL_STATIC_DRAW );
+
+  glCheck( "after laying out views" );
+}
+
+void MultiViewDisplay::update( const size_t view, const BaseRaster& raster )
+{
+  current_context_window_.window_.make_context_current();
+
+  views_.at( view )->upload( raster );
+  has_frame_[view] = true;
+}
+
+void MultiViewDisplay::repaint()
+{
+  current_context_window_.window_.make_context_current();
+
+  const pair<unsigned int, unsigned int> window_size
+    = current_context_window_.window_.size();
+  if ( window_size.first != display_width_
+       or window_size.second != display_height_ ) {
+    layout( window_size.first, window_size.second );
+  }
+
+  glClear( GL_COLOR_BUFFER_BIT );
+
+  for ( size_t i = 0; i < views_.size(); i++ ) {
+    if ( not has_frame_[i] ) {
+      continue;
+    }
+
+    const bool fromRGB = views_[i]->fromRGB();
+    ( fromRGB ? rgb_array_object_ : ycbcr_array_object_ ).bind();
+    ( fromRGB ? rgb_program_ : ycbcr_program_ ).use();
+    views_[i]->use();
+
+    glDrawArrays( GL_TRIANGLE_FAN, 4 * i, 4 );
+  }
+
+  const latency::ScopedTimer swap_timer { latency::Stage::Swap };
+  current_context_window_.window_.swap_buffers();
+}
+
+void MultiViewDisplay::draw( const vector<const BaseRaster*>& frames )
+{
+  if ( frames.size() != views_.size() ) {
+    throw runtime_error( "MultiViewDisplay: need one frame (or nullptr) per "
+                         "view" );
+  }
+
+  for ( size_t i = 0; i < frames.size(); i++ ) {
+    if ( frames[i] ) {
+      update( i, *frames[i] );
+    }
+  }
+
+  repaint();
+}
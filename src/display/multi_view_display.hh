@@ -0,0 +1,100 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef MULTI_VIEW_DISPLAY_HH
+#define MULTI_VIEW_DISPLAY_HH
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frame_textures.hh"
+#include "gl_objects.hh"
+#include "util/raster.hh"
+
+/* Shows several frames (e.g. program, preview and per-source views) side by
+   side in one window. Every view is drawn from its own textures into its
+   own cell of a grid, in a single GL context with a single swap per repaint,
+   and a view's textures are only uploaded when it gets a new frame. Each
+   view keeps its aspect ratio inside its cell.
+
+   The GL context is made current on the constructing thread, and every
+   repaint waits for vsync; MultiViewRenderThread draws one from its own
+   thread. */
+
+class MultiViewDisplay
+{
+public:
+  struct ViewFormat
+  {
+    uint16_t width;
+    uint16_t height;
+    bool fromRGB;
+  };
+
+private:
+  static const std::string shader_source_scale_to_view;
+
+  unsigned int display_width_ { 0 }, display_height_ { 0 };
+
+  struct CurrentContextWindow
+  {
+    Window window_;
+
+    CurrentContextWindow( const unsigned int width,
+                          const unsigned int height,
+                          const bool fullscreen );
+  } current_context_window_;
+
+  VertexShader scale_to_view_ = { shader_source_scale_to_view };
+  FragmentShader ycbcr_shader_;
+  FragmentShader rgb_shader_;
+
+  Program ycbcr_program_ = {};
+  Program rgb_program_ = {};
+
+  VertexArrayObject ycbcr_array_object_ = {};
+  VertexArrayObject rgb_array_object_ = {};
+
+  // Four corners per view, in normalized device and texture coordinates
+  VertexBufferObject view_corners_ = {};
+
+  std::vector<std::unique_ptr<FrameTextures>> views_ {};
+  std::vector<bool> has_frame_ {};
+
+  void setup_program( Program& program,
+                      VertexArrayObject& array_object,
+                      const bool fromRGB );
+  void layout( const unsigned int width, const unsigned int height );
+
+public:
+  MultiViewDisplay( const std::vector<ViewFormat>& views,
+                    const unsigned int width,
+                    const unsigned int height,
+                    const bool fullscreen = false );
+
+  /* forbid copying */
+  MultiViewDisplay( const MultiViewDisplay& other ) = delete;
+  MultiViewDisplay& operator=( const MultiViewDisplay& other ) = delete;
+
+  // Uploads a new frame for one view; shown at the next repaint()
+  void update( const size_t view, const BaseRaster& raster );
+
+  // Draws every view that has a frame, then swaps once
+  void repaint();
+
+  // Uploads the non-null frames (the views that changed), then repaints
+  void draw( const std::vector<const BaseRaster*>& frames );
+
+  size_t view_count() const { return views_.size(); }
+
+  const FrameTextures::UploadStatistics& upload_statistics(
+    const size_t view ) const
+  {
+    return views_.at( view )->upload_statistics();
+  }
+
+  const Window& window() const { return current_context_window_.window_; }
+  Window& window() { return current_context_window_.window_; }
+};
+
+#endif /* MULTI_VIEW_DISPLAY_HH */
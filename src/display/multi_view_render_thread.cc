@@ -0,0 +1,81 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "multi_view_render_thread.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+vector<unique_ptr<FrameMailbox>> make_mailboxes(
+  const vector<MultiViewDisplay::ViewFormat>& formats )
+{
+  vector<unique_ptr<FrameMailbox>> mailboxes;
+  for ( const auto& format : formats ) {
+    mailboxes.push_back( make_unique<FrameMailbox>(
+      format.width, format.height, format.fromRGB ) );
+  }
+  return mailboxes;
+}
+
+}
+
+MultiViewRenderThread::MultiViewRenderThread(
+  const vector<MultiViewDisplay::ViewFormat>& formats,
+  const unsigned int width,
+  const unsigned int height,
+  const bool fullscreen )
+  : mailboxes_( make_mailboxes( formats ) )
+  , display_( formats, width, height, fullscreen )
+  , render_loop_( display_.window(), [this] { return render_step(); } )
+{}
+
+bool MultiViewRenderThread::render_step()
+{
+  bool new_frame = false;
+  for ( size_t i = 0; i < mailboxes_.size(); i++ ) {
+    if ( const BaseRaster* frame = mailboxes_[i]->take_if_new() ) {
+      display_.update( i, *frame );
+      new_frame = true;
+      drawn_frames_++;
+    }
+  }
+
+  if ( new_frame or have_frame_ ) {
+    /* the swap waits for vsync, which paces the loop */
+    display_.repaint();
+    if ( not new_frame ) {
+      repaints_++;
+    }
+    have_frame_ = true;
+  }
+
+  return have_frame_;
+}
+
+void MultiViewRenderThread::draw( const vector<const BaseRaster*>& frames )
+{
+  render_loop_.check();
+
+  if ( frames.size() != mailboxes_.size() ) {
+    throw runtime_error( "MultiViewRenderThread: need one frame (or nullptr) "
+                         "per view" );
+  }
+
+  for ( size_t i = 0; i < frames.size(); i++ ) {
+    if ( frames[i] ) {
+      mailboxes_[i]->publish( *frames[i] );
+    }
+  }
+}
+
+MultiViewRenderThread::Statistics MultiViewRenderThread::statistics() const
+{
+  Statistics statistics { 0, 0, drawn_frames_, repaints_ };
+  for ( const auto& mailbox : mailboxes_ ) {
+    statistics.submitted_frames += mailbox->published_frames();
+    statistics.skipped_frames += mailbox->skipped_frames();
+  }
+  return statistics;
+}
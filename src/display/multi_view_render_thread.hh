@@ -0,0 +1,69 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef MULTI_VIEW_RENDER_THREAD_HH
+#define MULTI_VIEW_RENDER_THREAD_HH
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "frame_mailbox.hh"
+#include "multi_view_display.hh"
+#include "render_loop.hh"
+#include "util/raster.hh"
+
+/* Shows frames in a MultiViewDisplay drawn from its own thread, as
+   RenderThread does for a single VideoDisplay.
+
+   The window is opened and closed on the thread that constructs and
+   destroys the MultiViewRenderThread, which must be the main thread. Every
+   view has its own FrameMailbox: draw() publishes each frame it is given
+   and never waits for the display, and the render thread uploads a view
+   only when a newer frame is waiting for it. */
+
+class MultiViewRenderThread
+{
+public:
+  struct Statistics
+  {
+    uint64_t submitted_frames;
+    uint64_t skipped_frames;
+    uint64_t drawn_frames;
+    uint64_t repaints;
+  };
+
+private:
+  std::vector<std::unique_ptr<FrameMailbox>> mailboxes_;
+  MultiViewDisplay display_;
+
+  // Used only by the render thread
+  bool have_frame_ { false };
+
+  std::atomic<uint64_t> drawn_frames_ { 0 };
+  std::atomic<uint64_t> repaints_ { 0 };
+
+  // Last, so the render thread stops before anything else is destroyed
+  RenderLoop render_loop_;
+
+  bool render_step();
+
+public:
+  MultiViewRenderThread(
+    const std::vector<MultiViewDisplay::ViewFormat>& formats,
+    const unsigned int width,
+    const unsigned int height,
+    const bool fullscreen = false );
+
+  /* forbid copying */
+  MultiViewRenderThread( const MultiViewRenderThread& other ) = delete;
+  MultiViewRenderThread& operator=( const MultiViewRenderThread& other )
+    = delete;
+
+  // Copies the non-null frames (one entry per view) and returns without
+  // waiting for the display
+  void draw( const std::vector<const BaseRaster*>& frames );
+
+  Statistics statistics() const;
+};
+
+#endif /* MULTI_VIEW_RENDER_THREAD_HH */
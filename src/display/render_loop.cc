@@ -0,0 +1,54 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "render_loop.hh"
+
+#include <chrono>
+
+#include "util/telemetry.hh"
+
+using namespace std;
+
+RenderLoop::RenderLoop( Window& window, Step step )
+  : window_( window )
+  , step_( move( step ) )
+{
+  /* a context can only be current on one thread at a time */
+  Window::release_context();
+
+  render_thread_ = thread( &RenderLoop::loop, this );
+}
+
+RenderLoop::~RenderLoop()
+{
+  terminate_ = true;
+  render_thread_.join();
+
+  window_.make_context_current();
+}
+
+void RenderLoop::loop()
+{
+  telemetry::set_thread_name( "render" );
+
+  try {
+    window_.make_context_current();
+
+    while ( not terminate_ ) {
+      if ( not step_() ) {
+        this_thread::sleep_for( chrono::milliseconds( 1 ) );
+      }
+    }
+  } catch ( ... ) {
+    render_error_ = current_exception();
+    failed_.store( true, memory_order_release );
+  }
+
+  Window::release_context();
+}
+
+void RenderLoop::check() const
+{
+  if ( failed_.load( memory_order_acquire ) ) {
+    rethrow_exception( render_error_ );
+  }
+}
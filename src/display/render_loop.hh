@@ -0,0 +1,55 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef RENDER_LOOP_HH
+#define RENDER_LOOP_HH
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+
+#include "gl_objects.hh"
+
+/* Draws into a window from a dedicated thread.
+
+   The window, and the display that owns it, are created and destroyed on
+   the main thread, as GLFW requires. The constructor takes the window's GL
+   context away from the calling thread and starts a thread that makes it
+   current and calls `step` over and over; the destructor stops that thread
+   and makes the context current on the calling thread again, so the
+   display's GL objects can be deleted there.
+
+   `step` draws or repaints and returns true, or returns false if there is
+   nothing to show yet (the loop then sleeps for a millisecond). An error on
+   the render thread stops the loop and is rethrown by check(). */
+
+class RenderLoop
+{
+public:
+  using Step = std::function<bool()>;
+
+private:
+  Window& window_;
+  Step step_;
+
+  std::atomic<bool> terminate_ { false };
+  std::exception_ptr render_error_ {};
+  std::atomic<bool> failed_ { false };
+
+  std::thread render_thread_ {};
+
+  void loop();
+
+public:
+  RenderLoop( Window& window, Step step );
+  ~RenderLoop();
+
+  /* forbid copying */
+  RenderLoop( const RenderLoop& other ) = delete;
+  RenderLoop& operator=( const RenderLoop& other ) = delete;
+
+  // Rethrows the error that stopped the render thread, if there was one
+  void check() const;
+};
+
+#endif /* RENDER_LOOP_HH */
@@ -0,0 +1,56 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "render_thread.hh"
+
+#include "headless_sinks.hh"
+
+using namespace std;
+
+RenderThread::RenderThread( const BaseRaster& raster,
+                            const bool fullscreen,
+                            const bool fromRGB )
+  : mailbox_( raster.width(), raster.height(), fromRGB )
+  , display_( raster, fullscreen, fromRGB )
+  , render_loop_( display_.window(), [this] { return render_step(); } )
+{}
+
+bool RenderThread::render_step()
+{
+  if ( const BaseRaster* frame = mailbox_.take_if_new() ) {
+    display_.draw( *frame );
+    have_frame_ = true;
+    drawn_frames_++;
+  } else if ( have_frame_ ) {
+    /* the swap waits for vsync, which paces the loop */
+    display_.repaint();
+    repaints_++;
+  }
+
+  return have_frame_;
+}
+
+void RenderThread::draw( const BaseRaster& raster )
+{
+  render_loop_.check();
+  mailbox_.publish( raster );
+}
+
+RenderThread::Statistics RenderThread::statistics() const
+{
+  return { mailbox_.published_frames(),
+           mailbox_.skipped_frames(),
+           drawn_frames_,
+           repaints_ };
+}
+
+unique_ptr<FrameSink> make_sink( const BaseRaster& raster,
+                                 const bool fullscreen,
+                                 const bool headless,
+                                 const bool fromRGB )
+{
+  if ( headless ) {
+    return make_unique<NullSink>();
+  }
+  /* each window repaints on its own thread, so drawing never waits on vsync */
+  return make_unique<RenderThread>( raster, fullscreen, fromRGB );
+}
@@ -0,0 +1,72 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef RENDER_THREAD_HH
+#define RENDER_THREAD_HH
+
+#include <atomic>
+#include <memory>
+
+#include "display.hh"
+#include "frame_mailbox.hh"
+#include "frame_sink.hh"
+#include "render_loop.hh"
+#include "util/raster.hh"
+
+/* Shows frames in a VideoDisplay that is drawn from its own thread, so the
+   thread producing the frames never waits for vsync.
+
+   The window is opened and closed on the thread that constructs and
+   destroys the RenderThread, which must be the main thread (see
+   GLFWContext); the render thread only draws, repainting whatever frame is
+   newest at each swap. draw() hands a frame over through a FrameMailbox,
+   so neither side ever blocks the other. */
+
+class RenderThread : public FrameSink
+{
+public:
+  struct Statistics
+  {
+    uint64_t submitted_frames;
+    uint64_t skipped_frames;
+    uint64_t drawn_frames;
+    uint64_t repaints;
+  };
+
+private:
+  FrameMailbox mailbox_;
+  VideoDisplay display_;
+
+  // Used only by the render thread
+  bool have_frame_ { false };
+
+  std::atomic<uint64_t> drawn_frames_ { 0 };
+  std::atomic<uint64_t> repaints_ { 0 };
+
+  // Last, so the render thread stops before anything else is destroyed
+  RenderLoop render_loop_;
+
+  bool render_step();
+
+public:
+  RenderThread( const BaseRaster& raster,
+                const bool fullscreen = false,
+                const bool fromRGB = false );
+
+  /* forbid copying */
+  RenderThread( const RenderThread& other ) = delete;
+  RenderThread& operator=( const RenderThread& other ) = delete;
+
+  // Copies the frame and returns without waiting for the display
+  using FrameSink::draw;
+  void draw( const BaseRaster& raster ) override;
+
+  Statistics statistics() const;
+};
+
+/* A RenderThread showing frames like `raster`, or a NullSink if headless */
+std::unique_ptr<FrameSink> make_sink( const BaseRaster& raster,
+                                      const bool fullscreen,
+                                      const bool headless,
+                                      const bool fromRGB = false );
+
+#endif /* RENDER_THREAD_HH */
@@ -0,0 +1,48 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "shared_frame_sink.hh"
+
+#include <chrono>
+#include <cstring>
+
+using namespace std;
+
+SharedFrameSink::SharedFrameSink( const uint16_t width,
+                                  const uint16_t height,
+                                  const uint32_t slot_count )
+  : ring_( width, height, slot_count )
+{}
+
+SharedFrameSink::~SharedFrameSink()
+{
+  ring_.close();
+}
+
+void SharedFrameSink::draw( const BaseRaster& )
+{
+  throw runtime_error( "SharedFrameSink publishes RGB frames only" );
+}
+
+void SharedFrameSink::draw( const RGBRaster& raster )
+{
+  if ( raster.width() != ring_.width() or raster.height() != ring_.height() ) {
+    throw runtime_error( "size mismatch" );
+  }
+
+  const optional<uint32_t> slot = ring_.claim();
+  if ( not slot.has_value() ) {
+    dropped_frames_++;
+    return;
+  }
+
+  const size_t length = ring_.plane_length();
+  memcpy( ring_.plane( *slot, 0 ), &raster.R().at( 0, 0 ), length );
+  memcpy( ring_.plane( *slot, 1 ), &raster.G().at( 0, 0 ), length );
+  memcpy( ring_.plane( *slot, 2 ), &raster.B().at( 0, 0 ), length );
+  memcpy( ring_.plane( *slot, 3 ), &raster.A().at( 0, 0 ), length );
+
+  ring_.publish( *slot,
+                 chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::steady_clock::now().time_since_epoch() )
+                   .count() );
+}
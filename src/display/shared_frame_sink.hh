@@ -0,0 +1,42 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SHARED_FRAME_SINK_HH
+#define SHARED_FRAME_SINK_HH
+
+#include <string>
+
+#include "frame_sink.hh"
+#include "util/frame_ring.hh"
+
+/* Publishes frames to other processes through a FrameRing. Drawing a frame
+   copies each plane once into shared memory and never waits for readers. */
+
+class SharedFrameSink : public FrameSink
+{
+private:
+  FrameRing ring_;
+  uint64_t dropped_frames_ { 0 };
+
+public:
+  SharedFrameSink( const uint16_t width,
+                   const uint16_t height,
+                   const uint32_t slot_count = 4 );
+
+  // Tells readers that no more frames are coming
+  ~SharedFrameSink();
+
+  /* forbid copying */
+  SharedFrameSink( const SharedFrameSink& other ) = delete;
+  SharedFrameSink& operator=( const SharedFrameSink& other ) = delete;
+
+  // Drops the frame if every slot is held by readers
+  void draw( const RGBRaster& raster ) override;
+
+  // Throws: only RGB frames can be published
+  void draw( const BaseRaster& raster ) override;
+
+  std::string path() const { return ring_.path(); }
+  uint64_t dropped_frames() const { return dropped_frames_; }
+};
+
+#endif /* SHARED_FRAME_SINK_HH */
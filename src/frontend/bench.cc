@@ -0,0 +1,438 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Times the keying, compositing, unpacking and decoding kernels on fixed
+   frames, and prints one machine-readable line per kernel, frame and
+   setting: CSV by default, or JSON Lines with -f json.
+
+   Every measurement runs a few untimed warmup iterations and then a number
+   of timed repetitions, each on a fresh copy of its input (the copy isn't
+   timed). Throughput figures use the median repetition. */
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "input/jpeg.hh"
+#include "input/mjpeg_input.hh"
+#include "input/synthetic_input.hh"
+#include "util/chroma_key.hh"
+#include "util/compositor.hh"
+#include "util/corpus.hh"
+#include "util/despill.hh"
+#include "util/dilate_erode.hh"
+#include "util/file.hh"
+#include "util/keying.hh"
+#include "util/keying_clip.hh"
+#include "util/pixel_convert.hh"
+#include "util/raster.hh"
+#include "util/tokenize.hh"
+
+using namespace std;
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0
+       << " [-s, --sizes WxH,...] [-t, --threads N,...] [-w, --warmup N]"
+       << " [-n, --repetitions N] [-f, --format csv|json]"
+       << " [-o, --only OPERATION] [-i, --image FILE.jpg]"
+       << " [-m, --mjpeg FILE.mjpeg -S, --mjpeg-size WxH]" << endl;
+}
+
+struct Options
+{
+  vector<pair<uint16_t, uint16_t>> sizes { { 1280, 720 }, { 1920, 1080 } };
+  vector<uint8_t> thread_counts { 1, 2, 4 };
+  unsigned int warmup { 2 };
+  unsigned int repetitions { 10 };
+  bool json { false };
+  string only {};
+  string image { "../street.jpg" };
+  string mjpeg {};
+  pair<uint16_t, uint16_t> mjpeg_size { 1280, 720 };
+};
+
+/* what was measured, for the report */
+struct Case
+{
+  string operation;
+  string source;
+  string parameters;
+  uint16_t width;
+  uint16_t height;
+  unsigned int threads;
+};
+
+class Bench
+{
+private:
+  const Options& options_;
+  bool header_written_ { false };
+
+  void report( const Case& measured, vector<uint64_t> samples );
+
+public:
+  Bench( const Options& options )
+    : options_( options )
+  {}
+
+  bool wanted( const string& operation ) const
+  {
+    return options_.only.empty()
+           or operation.find( options_.only ) != string::npos;
+  }
+
+  // Runs setup() untimed and then run() timed, warmup + repetitions times
+  void measure( const Case& measured,
+                const function<void()>& setup,
+                const function<void()>& run );
+};
+
+void Bench::measure( const Case& measured,
+                     const function<void()>& setup,
+                     const function<void()>& run )
+{
+  if ( not wanted( measured.operation ) ) {
+    return;
+  }
+
+  vector<uint64_t> samples;
+  for ( unsigned int i = 0; i < options_.warmup + options_.repetitions; i++ ) {
+    setup();
+
+    const auto start = chrono::steady_clock::now();
+    run();
+    const auto end = chrono::steady_clock::now();
+
+    if ( i >= options_.warmup ) {
+      samples.push_back(
+        chrono::duration_cast<chrono::nanoseconds>( end - start ).count() );
+    }
+  }
+
+  report( measured, move( samples ) );
+}
+
+void Bench::report( const Case& measured, vector<uint64_t> samples )
+{
+  sort( samples.begin(), samples.end() );
+
+  const size_t n = samples.size();
+  const double median = n % 2 ? samples[n / 2]
+                              : ( samples[n / 2 - 1] + samples[n / 2] ) / 2.0;
+  const double mean = accumulate( samples.begin(), samples.end(), 0.0 ) / n;
+  double variance = 0;
+  for ( const uint64_t sample : samples ) {
+    variance += ( sample - mean ) * ( sample - mean );
+  }
+  const double stddev = n > 1 ? sqrt( variance / ( n - 1 ) ) : 0;
+
+  const double pixels = double( measured.width ) * measured.height;
+  const double ns_per_pixel = median / pixels;
+  const double mpixel_per_s = pixels / median * 1000;
+
+  cout << fixed << setprecision( 3 );
+
+  if ( options_.json ) {
+    cout << "{\"operation\":\"" << measured.operation << "\",\"source\":\""
+         << measured.source << "\",\"parameters\":\"" << measured.parameters
+         << "\",\"width\":" << measured.width
+         << ",\"height\":" << measured.height
+         << ",\"threads\":" << measured.threads << ",\"repetitions\":" << n
+         << ",\"min_ns\":" << samples.front() << ",\"median_ns\":" << median
+         << ",\"mean_ns\":" << mean << ",\"stddev_ns\":" << stddev
+         << ",\"max_ns\":" << samples.back()
+         << ",\"ns_per_pixel\":" << ns_per_pixel
+         << ",\"mpixel_per_s\":" << mpixel_per_s << "}" << endl;
+    return;
+  }
+
+  if ( not header_written_ ) {
+    cout << "operation,source,parameters,width,height,threads,repetitions,"
+            "min_ns,median_ns,mean_ns,stddev_ns,max_ns,ns_per_pixel,"
+            "mpixel_per_s"
+         << endl;
+    header_written_ = true;
+  }
+
+  cout << measured.operation << "," << measured.source << ","
+       << measured.parameters << "," << measured.width << ","
+       << measured.height << "," << measured.threads << "," << n << ","
+       << samples.front() << "," << median << "," << mean << "," << stddev
+       << "," << samples.back() << "," << ns_per_pixel << "," << mpixel_per_s
+       << endl;
+}
+
+void bench_kernels( Bench& bench,
+                    const Options& options,
+                    const Source& source )
+{
+  const RGBRaster& frame = source.frame;
+  const uint16_t width = frame.width();
+  const uint16_t height = frame.height();
+  RGBRaster work { width, height, width, height };
+
+  /* the later stages start from a keyed frame, as in ChromaKey */
+  KeyingOperation keying { 0.5, source.key_color };
+  RGBRaster keyed { width, height, width, height };
+  copy_frame( frame, keyed );
+  keying.process_rows( keyed, 0, height );
+
+  const auto fresh_frame = [&] { copy_frame( frame, work ); };
+  const auto fresh_keyed = [&] { copy_frame( keyed, work ); };
+
+  bench.measure( { "keying", source.name, "single", width, height, 1 },
+                 fresh_frame,
+                 [&] { keying.process_rows( work, 0, height ); } );
+
+  if ( bench.wanted( "keying" ) ) {
+    KeyingOperation multikey { 0.5, source.key_color };
+    multikey.set_multikey_color( frame );
+    bench.measure( { "keying", source.name, "multikey", width, height, 1 },
+                   fresh_frame,
+                   [&] { multikey.process_rows( work, 0, height ); } );
+  }
+
+  for ( const uint8_t radius : { 0, 2 } ) {
+    KeyingClipOperation clip { width, height };
+    clip.set_kernel_radius( radius );
+    clip.set_clip_black( 0.1 );
+    clip.set_clip_white( 0.9 );
+    const string parameters = "radius=" + to_string( radius );
+    bench.measure( { "keying_clip", source.name, parameters, width, height, 1 },
+                   fresh_keyed,
+                   [&] {
+                     clip.process_rows_intermediate( work.A(), 0, height );
+                     clip.process_rows_final( work.A(), 0, height );
+                   } );
+  }
+
+  for ( const int distance : { -2, 2 } ) {
+    DilateErodeOperation dilate_erode { width, height, distance };
+    const string parameters = "distance=" + to_string( distance );
+    bench.measure(
+      { "dilate_erode", source.name, parameters, width, height, 1 },
+      fresh_keyed,
+      [&] {
+        dilate_erode.process_rows_intermediate( work.A(), 0, height );
+        dilate_erode.process_rows_final( work.A(), 0, height );
+      } );
+  }
+
+  DespillOperation despill { keying };
+  bench.measure( { "despill", source.name, "factor=0.5", width, height, 1 },
+                 fresh_keyed,
+                 [&] { despill.process_rows( work, 0, height ); } );
+
+  for ( const uint8_t threads : options.thread_counts ) {
+    if ( bench.wanted( "chromakey" ) ) {
+      ChromaKey chromakey { width, height, threads };
+      chromakey.set_key_color( source.key_color );
+      bench.measure(
+        { "chromakey", source.name, "distance=0", width, height, threads },
+        fresh_frame,
+        [&] {
+          chromakey.start_create_mask( work );
+          chromakey.wait_for_mask();
+        } );
+    }
+
+    if ( bench.wanted( "composite" ) ) {
+      /* the keyed frame over the original, both full size */
+      Compositor compositor { width, height, threads };
+      compositor.raster_list() = { &keyed, &work };
+      bench.measure(
+        { "composite", source.name, "layers=2", width, height, threads },
+        fresh_frame,
+        [&] { compositor.composite(); } );
+    }
+  }
+}
+
+void bench_unpackers( Bench& bench,
+                      const uint16_t width,
+                      const uint16_t height )
+{
+  /* the unpackers don't branch on pixel values, so noise will do */
+  vector<uint8_t> packed( size_t { width } * height * 2 );
+  minstd_rand generator { 1 };
+  generate( packed.begin(), packed.end(), [&] { return generator() >> 8; } );
+  const uint8_t* const src = packed.data();
+
+  RGBRaster rgb { width, height, width, height };
+  BaseRaster yuv { width, height, width, height };
+
+  const vector<pair<string, function<void()>>> unpackers
+    = { { "yuyv_to_rgb", [&] { pixel_convert::yuyv_to_rgb( src, rgb ); } },
+        { "nv12_to_rgb", [&] { pixel_convert::nv12_to_rgb( src, rgb ); } },
+        { "yuv420_to_rgb", [&] { pixel_convert::yuv420_to_rgb( src, rgb ); } },
+        { "yuyv_to_yuv420",
+          [&] { pixel_convert::yuyv_to_yuv420( src, yuv ); } },
+        { "nv12_to_yuv420",
+          [&] { pixel_convert::nv12_to_yuv420( src, yuv ); } } };
+
+  for ( const auto& [name, unpack] : unpackers ) {
+    bench.measure( { name, "noise", "", width, height, 1 }, [] {}, unpack );
+  }
+}
+
+void bench_jpeg( Bench& bench, const string& name, const Chunk& image )
+{
+  for ( const unsigned int scale : { 1, 2, 4, 8 } ) {
+    for ( const bool rgb : { true, false } ) {
+      JPEGDecompresser decompresser;
+      decompresser.set_scale( scale );
+      if ( rgb ) {
+        decompresser.set_output_rgb();
+      }
+
+      decompresser.begin_decoding( image );
+      const uint16_t width = decompresser.width();
+      const uint16_t height = decompresser.height();
+      const uint8_t ratio = rgb ? 1 : 2;
+      BaseRaster output { width, height, width, height, ratio, ratio };
+      decompresser.decode( output );
+
+      const string parameters = "scale=1/" + to_string( scale )
+                                + ( rgb ? ";output=rgb" : ";output=yuv" );
+      bench.measure( { "jpeg_decode", name, parameters, width, height, 1 },
+                     [&] { decompresser.begin_decoding( image ); },
+                     [&] { decompresser.decode( output ); } );
+    }
+  }
+}
+
+vector<pair<uint16_t, uint16_t>> parse_sizes( const string& argument )
+{
+  vector<pair<uint16_t, uint16_t>> sizes;
+  for ( const string& size : split( argument, "," ) ) {
+    const vector<string> dimensions = split( size, "x" );
+    if ( dimensions.size() != 2 ) {
+      throw runtime_error( "invalid size: " + size );
+    }
+    sizes.emplace_back( stoul( dimensions[0] ), stoul( dimensions[1] ) );
+  }
+  return sizes;
+}
+
+int main( int argc, char* argv[] )
+{
+  /* check the command-line arguments */
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  Options options;
+
+  const option command_line_options[]
+    = { { "sizes", required_argument, nullptr, 's' },
+        { "threads", required_argument, nullptr, 't' },
+        { "warmup", required_argument, nullptr, 'w' },
+        { "repetitions", required_argument, nullptr, 'n' },
+        { "format", required_argument, nullptr, 'f' },
+        { "only", required_argument, nullptr, 'o' },
+        { "image", required_argument, nullptr, 'i' },
+        { "mjpeg", required_argument, nullptr, 'm' },
+        { "mjpeg-size", required_argument, nullptr, 'S' },
+        { 0, 0, 0, 0 } };
+
+  while ( true ) {
+    const int opt = getopt_long(
+      argc, argv, "s:t:w:n:f:o:i:m:S:", command_line_options, nullptr );
+
+    if ( opt == -1 ) {
+      break;
+    }
+
+    switch ( opt ) {
+      case 's':
+        options.sizes = parse_sizes( optarg );
+        break;
+      case 't':
+        options.thread_counts.clear();
+        for ( const string& count : split( optarg, "," ) ) {
+          options.thread_counts.push_back( stoul( count ) );
+        }
+        break;
+      case 'w':
+        options.warmup = stoul( optarg );
+        break;
+      case 'n':
+        options.repetitions = max( 1ul, stoul( optarg ) );
+        break;
+      case 'f':
+        options.json = string( optarg ) == "json";
+        break;
+      case 'o':
+        options.only = optarg;
+        break;
+      case 'i':
+        options.image = optarg;
+        break;
+      case 'm':
+        options.mjpeg = optarg;
+        break;
+      case 'S':
+        options.mjpeg_size = parse_sizes( optarg ).at( 0 );
+        break;
+
+      default:
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+  }
+
+  Bench bench { options };
+
+  /* synthetic green-screen frames at every size */
+  for ( const auto& [width, height] : options.sizes ) {
+    SyntheticInput::Parameters parameters;
+    parameters.width = width;
+    parameters.height = height;
+    SyntheticInput input { parameters };
+
+    Source source { "synthetic",
+                    copy_of( input.get_next_rgb_frame()->get() ),
+                    input.key_color() };
+    bench_kernels( bench, options, source );
+    bench_unpackers( bench, width, height );
+  }
+
+  /* the bundled still, keyed with real-webcam's default key color */
+  const vector<double> default_key_color = { 0.00819513, 0.106535, 0.026461 };
+  if ( not options.image.empty() ) {
+    const File image { options.image };
+    bench_jpeg( bench, "image", image.chunk() );
+
+    JPEGDecompresser decompresser;
+    Source source { "image", decompresser.load_image( image.chunk() ),
+                    default_key_color };
+    bench_kernels( bench, options, source );
+  }
+
+  /* a frame of real video, e.g. extracted from videoplayback.mp4 with
+     ffmpeg -i videoplayback.mp4 -s 1280x720 -c:v mjpeg -q:v 3 video.mjpeg */
+  if ( not options.mjpeg.empty() ) {
+    MJPEGInput input { options.mjpeg,
+                       options.mjpeg_size.first,
+                       options.mjpeg_size.second };
+    input.seek( min( uint64_t { 70 }, input.frame_count() - 1 ) );
+    auto frame = input.get_next_rgb_frame();
+    if ( not frame.has_value() ) {
+      throw runtime_error( "no frames in " + options.mjpeg );
+    }
+
+    Source source { "video", copy_of( frame->get() ), default_key_color };
+    bench_kernels( bench, options, source );
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -30,14 +30,17 @@
 
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 
 #include "display/display.hh"
-#include "input/jpeg.hh"
+#include "display/headless_sinks.hh"
+#include "input/image_cache.hh"
 #include "input/mjpeg_input.hh"
 #include "util/chroma_key.hh"
 #include "util/compositor.hh"
+#include "util/latency.hh"
 #include "util/raster_handle.hh"
 
 using namespace std;
@@ -45,7 +48,7 @@ using namespace chrono;
 
 void usage( const char* argv0 )
 {
-  cerr << "Usage: " << argv0 << " FILE" << endl;
+  cerr << "Usage: " << argv0 << " [-H, --headless] FILE1 FILE2" << endl;
 }
 
 int main( int argc, char* argv[] )
@@ -55,13 +58,50 @@ int main( int argc, char* argv[] )
     abort();
   }
 
+  /* headless runs draw to a checksum instead of a window, as fast as
+     they can, to compare and time runs */
+  bool headless = false;
+
+  const option command_line_options[]
+    = { { "headless", no_argument, nullptr, 'H' }, { 0, 0, 0, 0 } };
+
+  while ( true ) {
+    const int opt
+      = getopt_long( argc, argv, "H", command_line_options, nullptr );
+
+    if ( opt == -1 ) {
+      break;
+    }
+
+    switch ( opt ) {
+      case 'H':
+        headless = true;
+        break;
+
+      default:
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+  }
+
+  if ( argc - optind != 2 ) {
+    usage( argv[0] );
+    return EXIT_FAILURE;
+  }
+
   /* camera settings */
   const uint16_t width = 1280;
   const uint16_t height = 720;
-  MJPEGInput frame_input1 { argv[1], width, height };
-  MJPEGInput frame_input2 { argv[2], width, height };
+  MJPEGInput frame_input1 { argv[optind], width, height };
+  MJPEGInput frame_input2 { argv[optind + 1], width, height };
   RasterHandle r { RasterHandle { width, height } };
-  VideoDisplay display { r, false, true };
+
+  ChecksumSink checksum;
+  unique_ptr<VideoDisplay> window;
+  if ( not headless ) {
+    window = make_unique<VideoDisplay>( r, false, true );
+  }
+  FrameSink& display = headless ? static_cast<FrameSink&>( checksum ) : *window;
 
   const uint8_t thread_count = 2;
   // const int distance = 0;
@@ -76,14 +116,15 @@ int main( int argc, char* argv[] )
   chromakey2.set_key_color( key_color2 );
 
   const string image_name = "../test_background.jpg";
-  JPEGDecompresser jpegdec;
-  RGBRaster background = jpegdec.load_image( image_name );
+  ImageCache image_cache;
+  RGBRaster background = image_cache.load( image_name );
 
   Compositor compositor( width, height, thread_count );
 
-  for ( int i = 0; i < 70; i++ ) {
-    frame_input1.get_next_rgb_frame();
-  }
+  frame_input1.seek( 70 );
+
+  /* per-stage timings go to stderr when the input runs out */
+  latency::dump_at_exit();
 
   while ( true ) {
     auto raster1 = frame_input1.get_next_rgb_frame();
@@ -111,15 +152,19 @@ int main( int argc, char* argv[] )
     compositor.raster_list().push_back( &( *raster2 ).get() );
     compositor.raster_list().push_back( &background );
 
-    auto start = chrono::high_resolution_clock::now();
     RGBRaster& output_raster = compositor.composite();
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>( end - start );
-    cout << "Time taken: " << duration.count() << " ms" << endl;
 
     display.draw( output_raster );
 
-    this_thread::sleep_for( 40ms );
+    if ( not headless ) {
+      GLFWContext::process_events();
+      this_thread::sleep_for( 40ms );
+    }
+  }
+
+  if ( headless ) {
+    cout << checksum.frame_count() << " frames, checksum " << hex
+         << checksum.running_checksum() << dec << endl;
   }
 
   return EXIT_SUCCESS;
@@ -0,0 +1,631 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Regression check for the keying and compositing output.
+
+   For a fixed corpus of frames, runs the reference pipeline (every stage
+   single-threaded, over the whole frame) and compares each optimized
+   variant against it, plane by plane, by SSIM and maximum absolute error.
+   Each variant has its own thresholds: a variant that should be bit-exact
+   must match exactly, while an approximate fast path may be given some
+   slack. The SIMD pixel converters are checked against the scalar
+   reference kernels the same way.
+
+   With -r DIR, the reference outputs are also saved as golden files; with
+   -c DIR, they are compared against golden files saved earlier, to catch
+   changes to the reference pipeline itself. Exits nonzero if any check
+   fails. */
+
+#include <fcntl.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "input/jpeg.hh"
+#include "input/synthetic_input.hh"
+#include "util/chroma_key.hh"
+#include "util/compositor.hh"
+#include "util/corpus.hh"
+#include "util/despill.hh"
+#include "util/dilate_erode.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/file_descriptor.hh"
+#include "util/keying.hh"
+#include "util/keying_clip.hh"
+#include "util/pixel_convert.hh"
+#include "util/raster.hh"
+#include "util/ssim.hh"
+
+using namespace std;
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0
+       << " [-i, --image BACKGROUND.jpg] [-r, --record DIR] [-c, --check DIR]"
+       << endl;
+}
+
+struct Threshold
+{
+  double min_ssim;
+  unsigned int max_error;
+};
+
+const Threshold EXACT { 1.0, 0 };
+
+// For comparing against golden files, which may come from another libjpeg
+const Threshold GOLDEN { 0.995, 8 };
+
+/* the pipeline settings shared by the reference and every variant */
+const double SCREEN_BALANCE = 0.5;
+const uint8_t KERNEL_RADIUS = 3;
+const double CLIP_BLACK = 0.1;
+const double CLIP_WHITE = 0.9;
+const int DILATE_ERODE_DISTANCE = 2;
+
+// The keyed foreground (RGB and alpha) and the composite over a background
+struct Output
+{
+  RGBRaster keyed;
+  RGBRaster composite;
+
+  Output( const uint16_t width, const uint16_t height )
+    : keyed( width, height, width, height )
+    , composite( width, height, width, height )
+  {}
+};
+
+class Checker
+{
+private:
+  unsigned int checks_ { 0 };
+  unsigned int failures_ { 0 };
+
+public:
+  void compare( const string& kernel,
+                const string& source,
+                const string& plane,
+                const TwoD<uint8_t>& reference,
+                const TwoD<uint8_t>& candidate,
+                const Threshold& threshold );
+
+  void compare_rgb( const string& kernel,
+                    const string& source,
+                    const RGBRaster& reference,
+                    const RGBRaster& candidate,
+                    const Threshold& threshold,
+                    const bool with_alpha );
+
+  unsigned int checks() const { return checks_; }
+  unsigned int failures() const { return failures_; }
+};
+
+void Checker::compare( const string& kernel,
+                       const string& source,
+                       const string& plane,
+                       const TwoD<uint8_t>& reference,
+                       const TwoD<uint8_t>& candidate,
+                       const Threshold& threshold )
+{
+  if ( reference.width() != candidate.width()
+       or reference.height() != candidate.height() ) {
+    throw runtime_error( kernel + ": plane size mismatch" );
+  }
+
+  unsigned int max_error = 0;
+  for ( unsigned int y = 0; y < reference.height(); y++ ) {
+    for ( unsigned int x = 0; x < reference.width(); x++ ) {
+      max_error = max(
+        max_error,
+        static_cast<unsigned int>(
+          abs( reference.at( x, y ) - candidate.at( x, y ) ) ) );
+    }
+  }
+
+  /* identical planes are SSIM 1 by definition, whatever the rounding */
+  const double similarity
+    = max_error == 0 ? 1.0 : ssim( reference, candidate );
+  const bool pass
+    = similarity >= threshold.min_ssim and max_error <= threshold.max_error;
+
+  checks_++;
+  if ( not pass ) {
+    failures_++;
+  }
+
+  cout << ( pass ? "PASS " : "FAIL " ) << kernel << " " << source << " "
+       << plane << " ssim=" << fixed << setprecision( 6 ) << similarity
+       << " max_error=" << max_error << endl;
+}
+
+void Checker::compare_rgb( const string& kernel,
+                           const string& source,
+                           const RGBRaster& reference,
+                           const RGBRaster& candidate,
+                           const Threshold& threshold,
+                           const bool with_alpha )
+{
+  compare( kernel, source, "R", reference.R(), candidate.R(), threshold );
+  compare( kernel, source, "G", reference.G(), candidate.G(), threshold );
+  compare( kernel, source, "B", reference.B(), candidate.B(), threshold );
+  if ( with_alpha ) {
+    compare( kernel, source, "A", reference.A(), candidate.A(), threshold );
+  }
+}
+
+/* every stage run directly, single-threaded, over the whole frame */
+void run_reference( const Source& source,
+                    const RGBRaster& background,
+                    Output& output )
+{
+  const uint16_t width = source.frame.width();
+  const uint16_t height = source.frame.height();
+  RGBRaster& keyed = output.keyed;
+  copy_frame( source.frame, keyed );
+
+  KeyingOperation keying { SCREEN_BALANCE, source.key_color };
+  keying.process_rows( keyed, 0, height );
+
+  KeyingClipOperation keying_clip { width, height };
+  keying_clip.set_kernel_radius( KERNEL_RADIUS );
+  keying_clip.set_clip_black( CLIP_BLACK );
+  keying_clip.set_clip_white( CLIP_WHITE );
+  keying_clip.process_rows_intermediate( keyed.A(), 0, height );
+  keying_clip.process_rows_final( keyed.A(), 0, height );
+
+  DilateErodeOperation dilate_erode { width, height, DILATE_ERODE_DISTANCE };
+  dilate_erode.process_rows_intermediate( keyed.A(), 0, height );
+  dilate_erode.process_rows_final( keyed.A(), 0, height );
+
+  DespillOperation despill { keying };
+  despill.process_rows( keyed, 0, height );
+
+  Compositor compositor { width, height, 1 };
+  compositor.raster_list() = { &keyed, const_cast<RGBRaster*>( &background ) };
+  copy_frame( compositor.composite(), output.composite );
+}
+
+/* Changes a patch in the middle of the frame (across the band boundary
+   with an even number of threads), for keying a frame that differs from
+   the source only locally. The patch starts on a tile boundary, so the
+   static tiles above and to the left of it are within the halo. */
+void perturb( RGBRaster& frame )
+{
+  const unsigned int tile_size = TileCache::TILE_SIZE;
+  const unsigned int col_start = frame.width() / 2 / tile_size * tile_size;
+  const unsigned int row_start
+    = ( frame.height() / 2 - 30 ) / tile_size * tile_size;
+  for ( unsigned int row = row_start; row < row_start + 60; row++ ) {
+    for ( unsigned int col = col_start; col < col_start + 70; col++ ) {
+      frame.R().at( col, row ) = 255 - frame.R().at( col, row );
+      frame.G().at( col, row ) = 255 - frame.G().at( col, row );
+    }
+  }
+}
+
+/* the production pipeline: ChromaKey and Compositor on a thread pool. With
+   a tile skip threshold, a locally changed copy of the frame is keyed
+   first, so that keying the frame itself reuses the tiles away from the
+   change and recomputes the ones around it. */
+void run_threaded( const Source& source,
+                   const RGBRaster& background,
+                   const uint8_t threads,
+                   Output& output,
+                   const double tile_skip_threshold = 0 )
+{
+  const uint16_t width = source.frame.width();
+  const uint16_t height = source.frame.height();
+  RGBRaster& keyed = output.keyed;
+
+  ChromaKey chromakey { width, height, threads };
+  chromakey.set_screen_balance( SCREEN_BALANCE );
+  chromakey.set_key_color( source.key_color );
+  chromakey.set_kernel_radius( KERNEL_RADIUS );
+  chromakey.set_clip_black( CLIP_BLACK );
+  chromakey.set_clip_white( CLIP_WHITE );
+  chromakey.set_dilate_erode_distance( DILATE_ERODE_DISTANCE );
+  chromakey.set_tile_skip_threshold( tile_skip_threshold );
+  if ( tile_skip_threshold > 0 ) {
+    copy_frame( source.frame, keyed );
+    perturb( keyed );
+    chromakey.start_create_mask( keyed );
+    chromakey.wait_for_mask();
+  }
+  copy_frame( source.frame, keyed );
+  chromakey.start_create_mask( keyed );
+  chromakey.wait_for_mask();
+
+  Compositor compositor { width, height, threads };
+  compositor.raster_list() = { &keyed, const_cast<RGBRaster*>( &background ) };
+  copy_frame( compositor.composite(), output.composite );
+}
+
+/* golden files: a magic number and the size, then the keyed R, G, B and A
+   planes and the composite's R, G and B */
+
+const char GOLDEN_MAGIC[8] = { 'G', 'O', 'L', 'D', 'E', 'N', '0', '1' };
+
+template<class OutputType>
+auto golden_planes( OutputType& output )
+{
+  return vector { &output.keyed.R(),     &output.keyed.G(),
+                  &output.keyed.B(),     &output.keyed.A(),
+                  &output.composite.R(), &output.composite.G(),
+                  &output.composite.B() };
+}
+
+void save_golden( const string& filename, const Output& output )
+{
+  const uint16_t size[2] = { output.keyed.width(), output.keyed.height() };
+
+  string contents( GOLDEN_MAGIC, sizeof( GOLDEN_MAGIC ) );
+  contents.append( reinterpret_cast<const char*>( size ), sizeof( size ) );
+  for ( const auto plane : golden_planes( output ) ) {
+    contents.append( reinterpret_cast<const char*>( &plane->at( 0, 0 ) ),
+                     size_t { plane->width() } * plane->height() );
+  }
+
+  FileDescriptor golden { SystemCall(
+    filename,
+    open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) };
+  golden.write( contents );
+}
+
+void load_golden( const string& filename, Output& output )
+{
+  const File golden { filename };
+  const uint16_t size[2] = { output.keyed.width(), output.keyed.height() };
+  const size_t header_length = sizeof( GOLDEN_MAGIC ) + sizeof( size );
+
+  const uint8_t* header = golden.chunk().buffer();
+  if ( golden.size() < header_length
+       or memcmp( header, GOLDEN_MAGIC, sizeof( GOLDEN_MAGIC ) )
+       or memcmp( header + sizeof( GOLDEN_MAGIC ), size, sizeof( size ) ) ) {
+    throw runtime_error( filename + ": not a golden file for this frame" );
+  }
+
+  size_t offset = header_length;
+  for ( const auto plane : golden_planes( output ) ) {
+    const size_t length = size_t { plane->width() } * plane->height();
+    const Chunk data = golden( offset, length );
+    memcpy( &plane->at( 0, 0 ), data.buffer(), length );
+    offset += length;
+  }
+}
+
+/* each SIMD converter against its scalar reference, on the same input; the
+   input rows are 2 * width bytes, which is enough for any of the layouts */
+
+using RowConverter = void ( * )( const uint8_t* src,
+                                 uint8_t* r,
+                                 uint8_t* g,
+                                 uint8_t* b,
+                                 const unsigned int width );
+
+struct Converter
+{
+  string name;
+  RowConverter optimized;
+  RowConverter reference;
+};
+
+template<void ( *convert )( const uint8_t*,
+                            const uint8_t*,
+                            const uint8_t*,
+                            uint8_t*,
+                            uint8_t*,
+                            uint8_t*,
+                            const unsigned int,
+                            const bool ),
+         bool full_range>
+void yuv422_row( const uint8_t* src,
+                 uint8_t* r,
+                 uint8_t* g,
+                 uint8_t* b,
+                 const unsigned int width )
+{
+  convert( src, src + width, src + width * 3 / 2, r, g, b, width, full_range );
+}
+
+template<void ( *convert )( const uint8_t*,
+                            const uint8_t*,
+                            const uint8_t*,
+                            uint8_t*,
+                            uint8_t*,
+                            uint8_t*,
+                            const unsigned int )>
+void yuv444_row( const uint8_t* src,
+                 uint8_t* r,
+                 uint8_t* g,
+                 uint8_t* b,
+                 const unsigned int width )
+{
+  convert( src, src + width / 2, src + width, r, g, b, width );
+}
+
+template<void ( *convert )( const uint8_t*,
+                            const uint8_t*,
+                            uint8_t*,
+                            uint8_t*,
+                            uint8_t*,
+                            const unsigned int )>
+void nv12_row( const uint8_t* src,
+               uint8_t* r,
+               uint8_t* g,
+               uint8_t* b,
+               const unsigned int width )
+{
+  convert( src, src + width, r, g, b, width );
+}
+
+// interleaved UV in, U and V out in the first half of r and g
+template<void ( *convert )( const uint8_t*,
+                            uint8_t*,
+                            uint8_t*,
+                            const unsigned int )>
+void uv_row( const uint8_t* src,
+             uint8_t* r,
+             uint8_t* g,
+             uint8_t*,
+             const unsigned int width )
+{
+  convert( src, r, g, width / 2 );
+}
+
+// the RGBA output has four channels, so each instance checks three of them
+template<void ( *convert )( const uint8_t*,
+                            const uint8_t*,
+                            const uint8_t*,
+                            uint8_t*,
+                            const unsigned int ),
+         unsigned int first_channel>
+void rgba_row( const uint8_t* src,
+               uint8_t* r,
+               uint8_t* g,
+               uint8_t* b,
+               const unsigned int width )
+{
+  vector<uint8_t> rgba( size_t { width } * 4 );
+  convert( src, src + width / 2, src + width, rgba.data(), width );
+  uint8_t* const outputs[3] = { r, g, b };
+  for ( unsigned int i = 0; i < width; i++ ) {
+    for ( unsigned int channel = 0; channel < 3; channel++ ) {
+      outputs[channel][i] = rgba[i * 4 + first_channel + channel];
+    }
+  }
+}
+
+void check_pixel_convert( Checker& checker,
+                          const uint16_t width,
+                          const uint16_t height )
+{
+  namespace ref = pixel_convert::reference;
+
+  const vector<Converter> converters = {
+    { "yuyv_row_to_rgb",
+      pixel_convert::yuyv_row_to_rgb,
+      ref::yuyv_row_to_rgb },
+    { "yuyv_row_to_planar",
+      pixel_convert::yuyv_row_to_planar,
+      ref::yuyv_row_to_planar },
+    { "nv12_row_to_rgb",
+      nv12_row<pixel_convert::nv12_row_to_rgb>,
+      nv12_row<ref::nv12_row_to_rgb> },
+    { "yuv422_row_to_rgb",
+      yuv422_row<pixel_convert::yuv422_row_to_rgb, false>,
+      yuv422_row<ref::yuv422_row_to_rgb, false> },
+    { "yuv422_row_to_rgb/full_range",
+      yuv422_row<pixel_convert::yuv422_row_to_rgb, true>,
+      yuv422_row<ref::yuv422_row_to_rgb, true> },
+    { "yuv444_row_to_rgb",
+      yuv444_row<pixel_convert::yuv444_row_to_rgb>,
+      yuv444_row<ref::yuv444_row_to_rgb> },
+    { "uv_row_to_planar",
+      uv_row<pixel_convert::uv_row_to_planar>,
+      uv_row<ref::uv_row_to_planar> },
+    { "rgb_row_to_rgba/rgb",
+      rgba_row<pixel_convert::rgb_row_to_rgba, 0>,
+      rgba_row<ref::rgb_row_to_rgba, 0> },
+    { "rgb_row_to_rgba/gba",
+      rgba_row<pixel_convert::rgb_row_to_rgba, 1>,
+      rgba_row<ref::rgb_row_to_rgba, 1> },
+  };
+
+  vector<uint8_t> input( size_t { width } * height * 2 );
+  minstd_rand generator { 1 };
+  generate( input.begin(), input.end(), [&] { return generator() >> 8; } );
+
+  const string source = to_string( width ) + "x" + to_string( height );
+  RGBRaster reference { width, height, width, height };
+  RGBRaster candidate { width, height, width, height };
+
+  const auto convert = [&]( const RowConverter row_converter,
+                            RGBRaster& output ) {
+    output.R().fill( 0 );
+    output.G().fill( 0 );
+    output.B().fill( 0 );
+    for ( unsigned int row = 0; row < height; row++ ) {
+      row_converter( input.data() + size_t { row } * width * 2,
+                     &output.R().at( 0, row ),
+                     &output.G().at( 0, row ),
+                     &output.B().at( 0, row ),
+                     width );
+    }
+  };
+
+  for ( const Converter& converter : converters ) {
+    convert( converter.reference, reference );
+    convert( converter.optimized, candidate );
+    checker.compare_rgb( "pixel_convert::" + converter.name,
+                         source,
+                         reference,
+                         candidate,
+                         EXACT,
+                         false );
+  }
+}
+
+int main( int argc, char* argv[] )
+{
+  /* check the command-line arguments */
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  string background_image = "../street.jpg";
+  string record_directory;
+  string check_directory;
+
+  const option command_line_options[]
+    = { { "image", required_argument, nullptr, 'i' },
+        { "record", required_argument, nullptr, 'r' },
+        { "check", required_argument, nullptr, 'c' },
+        { 0, 0, 0, 0 } };
+
+  while ( true ) {
+    const int opt
+      = getopt_long( argc, argv, "i:r:c:", command_line_options, nullptr );
+
+    if ( opt == -1 ) {
+      break;
+    }
+
+    switch ( opt ) {
+      case 'i':
+        background_image = optarg;
+        break;
+      case 'r':
+        record_directory = optarg;
+        break;
+      case 'c':
+        check_directory = optarg;
+        break;
+
+      default:
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+  }
+
+  /* the frames are the size of the background */
+  JPEGDecompresser decompresser;
+  const RGBRaster background = decompresser.load_image( background_image );
+  const uint16_t width = background.width();
+  const uint16_t height = background.height();
+
+  /* the corpus: a few frames of a fixed synthetic sequence, and the
+     background itself, keyed with real-webcam's default key color */
+  SyntheticInput::Parameters parameters;
+  parameters.width = width;
+  parameters.height = height;
+  SyntheticInput input { parameters };
+
+  vector<Source> corpus;
+  for ( const uint64_t frame_no : { 0, 37, 90 } ) {
+    input.seek( frame_no );
+    const auto frame = input.get_next_rgb_frame();
+
+    Source source { "synthetic-" + to_string( frame_no ),
+                    RGBRaster { width, height, width, height },
+                    input.key_color() };
+    copy_frame( frame->get(), source.frame );
+    corpus.push_back( move( source ) );
+  }
+
+  Source image { "image",
+                 RGBRaster { width, height, width, height },
+                 { 0.00819513, 0.106535, 0.026461 } };
+  copy_frame( background, image.frame );
+  corpus.push_back( move( image ) );
+
+  /* the variants, each with its thresholds against the reference */
+  struct Variant
+  {
+    string name;
+    Threshold threshold;
+    function<void( const Source&, Output& )> run;
+  };
+
+  vector<Variant> variants;
+  for ( const uint8_t threads : { 1, 2, 4 } ) {
+    variants.push_back( { "threaded/threads=" + to_string( threads ),
+                          EXACT,
+                          [&background, threads]( const Source& source,
+                                                  Output& output ) {
+                            run_threaded( source, background, threads, output );
+                          } } );
+  }
+  /* the unchanged tiles are bit-identical, so a tiny threshold must give
+     exactly the uncached result */
+  for ( const uint8_t threads : { 1, 2, 3 } ) {
+    variants.push_back( { "tile-cache/threads=" + to_string( threads ),
+                          EXACT,
+                          [&background, threads]( const Source& source,
+                                                  Output& output ) {
+                            run_threaded(
+                              source, background, threads, output, 1e-4 );
+                          } } );
+  }
+
+  Checker checker;
+
+  for ( const Source& source : corpus ) {
+    Output reference { width, height };
+    run_reference( source, background, reference );
+
+    for ( const Variant& variant : variants ) {
+      Output candidate { width, height };
+      variant.run( source, candidate );
+      checker.compare_rgb( variant.name + "/keyed",
+                           source.name,
+                           reference.keyed,
+                           candidate.keyed,
+                           variant.threshold,
+                           true );
+      checker.compare_rgb( variant.name + "/composite",
+                           source.name,
+                           reference.composite,
+                           candidate.composite,
+                           variant.threshold,
+                           false );
+    }
+
+    const string golden_name = source.name + ".golden";
+    if ( not record_directory.empty() ) {
+      save_golden( record_directory + "/" + golden_name, reference );
+    }
+
+    if ( not check_directory.empty() ) {
+      Output golden { width, height };
+      load_golden( check_directory + "/" + golden_name, golden );
+      checker.compare_rgb( "golden/keyed",
+                           source.name,
+                           golden.keyed,
+                           reference.keyed,
+                           GOLDEN,
+                           true );
+      checker.compare_rgb( "golden/composite",
+                           source.name,
+                           golden.composite,
+                           reference.composite,
+                           GOLDEN,
+                           false );
+    }
+  }
+
+  /* a width that is not a multiple of the vector width exercises the
+     scalar tails of the SIMD kernels */
+  check_pixel_convert( checker, 1280, 16 );
+  check_pixel_convert( checker, 334, 17 );
+
+  cout << checker.checks() - checker.failures() << " of " << checker.checks()
+       << " checks passed" << endl;
+
+  return checker.failures() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -28,18 +28,26 @@
 
 #include <getopt.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <thread>
 #include <vector>
 
-#include "display/display.hh"
+#include "display/multi_view_render_thread.hh"
+#include "display/render_thread.hh"
 #include "input/camera.hh"
-#include "input/jpeg.hh"
+#include "input/image_cache.hh"
 #include "util/chroma_key.hh"
 #include "util/compositor.hh"
+#include "util/latency.hh"
 #include "util/raster_handle.hh"
+#include "util/telemetry.hh"
 #include "util/tokenize.hh"
+#include "util/trace.hh"
+#include "util/y4m_recorder.hh"
 
 using namespace std;
 
@@ -48,6 +56,8 @@ void usage( const char* argv0 )
   cerr
     << "Usage: " << argv0
     << " [-d, --device CAMERA] [-p, --pixfmt PIXEL_FORMAT] [-f, --fullscreen]"
+    << " [-b, --buffers NUM_BUFFERS] [-r, --record FILE.y4m] [-H, --headless]"
+    << " [-m, --multiview] [-T, --telemetry LOGFILE] [-t, --trace FILE.json]"
     << endl;
 }
 
@@ -62,16 +72,28 @@ int main( int argc, char* argv[] )
   string camera_device = "/dev/video0";
   string pixel_format = "NV12";
   bool fullscreen = false;
+  bool headless = false;
+  bool multiview = false;
+  unsigned int num_buffers = 4;
+  string record_filename;
+  string telemetry_filename;
+  string trace_filename;
 
   const option command_line_options[]
     = { { "device", required_argument, nullptr, 'd' },
         { "pixfmt", required_argument, nullptr, 'p' },
         { "fullscreen", no_argument, nullptr, 'f' },
+        { "buffers", required_argument, nullptr, 'b' },
+        { "headless", no_argument, nullptr, 'H' },
+        { "record", required_argument, nullptr, 'r' },
+        { "multiview", no_argument, nullptr, 'm' },
+        { "telemetry", required_argument, nullptr, 'T' },
+        { "trace", required_argument, nullptr, 't' },
         { 0, 0, 0, 0 } };
 
   while ( true ) {
-    const int opt
-      = getopt_long( argc, argv, "d:p:f", command_line_options, nullptr );
+    const int opt = getopt_long(
+      argc, argv, "d:p:fb:r:HmT:t:", command_line_options, nullptr );
 
     if ( opt == -1 ) {
       break;
@@ -87,6 +109,24 @@ int main( int argc, char* argv[] )
       case 'f':
         fullscreen = true;
         break;
+      case 'b':
+        num_buffers = stoul( optarg );
+        break;
+      case 'H':
+        headless = true;
+        break;
+      case 'r':
+        record_filename = optarg;
+        break;
+      case 'm':
+        multiview = true;
+        break;
+      case 'T':
+        telemetry_filename = optarg;
+        break;
+      case 't':
+        trace_filename = optarg;
+        break;
 
       default:
         usage( argv[0] );
@@ -96,14 +136,29 @@ int main( int argc, char* argv[] )
 
   const uint16_t width = 1280;
   const uint16_t height = 720;
-  Camera camera {
-    width, height, PIXEL_FORMAT_STRS.at( pixel_format ), camera_device
-  };
+  Camera camera { width,
+                  height,
+                  PIXEL_FORMAT_STRS.at( pixel_format ),
+                  camera_device,
+                  num_buffers };
 
   RasterHandle r { RasterHandle { width, height } };
 
-  VideoDisplay original_display { r, fullscreen, true };
-  VideoDisplay output_display { r, fullscreen, true };
+  /* the multiview shows the camera and the program side by side in one
+     window, repainted on its own thread like the other windows */
+  unique_ptr<MultiViewRenderThread> multiview_display;
+  unique_ptr<FrameSink> original_display, output_display;
+  if ( multiview and not headless ) {
+    multiview_display = make_unique<MultiViewRenderThread>(
+      vector<MultiViewDisplay::ViewFormat> { { width, height, true },
+                                             { width, height, true } },
+      width,
+      height / 2,
+      fullscreen );
+  } else {
+    original_display = make_sink( r, fullscreen, headless, true );
+    output_display = make_sink( r, fullscreen, headless, true );
+  }
 
   const uint8_t thread_count = 2;
   const int distance = 0;
@@ -116,17 +171,39 @@ int main( int argc, char* argv[] )
   bool multikey_set = true;
 
   const string image_name = "../street.jpg";
-  JPEGDecompresser jpegdec;
-  RGBRaster background = jpegdec.load_image( image_name );
+  ImageCache image_cache;
+  RGBRaster background = image_cache.load( image_name );
 
   Compositor compositor( width, height, thread_count );
 
+  optional<Y4MRecorder> recorder;
+  if ( not record_filename.empty() ) {
+    recorder.emplace( record_filename, width, height );
+  }
+
+  latency::dump_at_exit();
+
+  /* CPU, scheduling, page fault and raster pool usage, once a second */
+  optional<telemetry::Publisher> telemetry_publisher;
+  if ( not telemetry_filename.empty() ) {
+    telemetry_publisher.emplace( telemetry_filename, chrono::seconds( 1 ) );
+  }
+
+  /* per-worker task timings, written out by the "trace" command */
+  if ( not trace_filename.empty() ) {
+    trace::enable();
+  }
+
   thread display_thread( [&] {
+    telemetry::set_thread_name( "pipeline" );
     while ( true ) {
+      const trace::Span frame_span { "frame", "pipeline" };
       auto raster = camera.get_next_rgb_frame();
 
       if ( raster.has_value() ) {
-        original_display.draw( *raster );
+        if ( original_display ) {
+          original_display->draw( *raster );
+        }
         if ( !multikey_set ) {
           chromakey.set_multikey_color( *raster );
           cout << "multikey set!" << endl;
@@ -142,7 +219,15 @@ int main( int argc, char* argv[] )
       compositor.raster_list().push_back( &( *raster ).get() );
       compositor.raster_list().push_back( &background );
       RGBRaster& output_raster = compositor.composite();
-      output_display.draw( output_raster );
+      if ( multiview_display ) {
+        multiview_display->draw( { &( *raster ).get(), &output_raster } );
+      } else {
+        output_display->draw( output_raster );
+      }
+
+      if ( recorder.has_value() ) {
+        recorder->record( output_raster );
+      }
     }
   } );
 
@@ -198,14 +283,35 @@ int main( int argc, char* argv[] )
       } else if ( tokens[0] == "despill_balance" ) {
         chromakey.set_despill_balance( stof( tokens[1] ) );
         cout << "despill color balance set!" << endl;
+      } else if ( tokens[0] == "tile_threshold" ) {
+        chromakey.set_tile_skip_threshold( stof( tokens[1] ) );
+        cout << "tile skip threshold set!" << endl;
+      } else if ( tokens[0] == "tile_stats" ) {
+        const auto stats = chromakey.tile_statistics();
+        cout << "reused " << stats.reused_tiles << " of " << stats.tiles
+             << " tiles over " << stats.frames << " frames ("
+             << 100.0 * stats.reused_tiles / max<uint64_t>( 1, stats.tiles )
+             << "%)" << endl;
+      } else if ( tokens[0] == "record_stats" and recorder.has_value() ) {
+        const auto stats = recorder->statistics();
+        cout << "recorded " << stats.recorded_frames << ", dropped "
+             << stats.dropped_frames << ", backpressured "
+             << stats.backpressured_frames << endl;
+      } else if ( tokens[0] == "latency" ) {
+        latency::dump( cout );
+      } else if ( tokens[0] == "trace" and trace::enabled() ) {
+        const size_t events = trace::write_json( trace_filename );
+        cout << "wrote " << events << " events to " << trace_filename << endl;
       } else {
         cout << "Invalid command!" << endl;
       }
     }
   } );
 
-  command_thread.join();
-  display_thread.join();
-
-  return EXIT_SUCCESS;
+  /* the windows are drawn from their own threads, but GLFW handles their
+     events (such as resizes) only on the main thread */
+  while ( true ) {
+    GLFWContext::process_events();
+    this_thread::sleep_for( chrono::milliseconds( 20 ) );
+  }
 }
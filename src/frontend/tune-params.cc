@@ -30,14 +30,16 @@
 
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 
-#include "display/display.hh"
+#include "display/render_thread.hh"
 #include "input/camera.hh"
-#include "input/jpeg.hh"
+#include "input/image_cache.hh"
 #include "util/chroma_key.hh"
 #include "util/compositor.hh"
+#include "util/latency.hh"
 #include "util/raster_handle.hh"
 #include "util/tokenize.hh"
 
@@ -48,7 +50,7 @@ void usage( const char* argv0 )
   cerr
     << "Usage: " << argv0
     << " [-d, --device CAMERA] [-p, --pixfmt PIXEL_FORMAT] [-f, --fullscreen]"
-    << endl;
+    << " [-b, --buffers NUM_BUFFERS] [-H, --headless]" << endl;
 }
 
 int main( int argc, char* argv[] )
@@ -62,16 +64,20 @@ int main( int argc, char* argv[] )
   string camera_device = "/dev/video0";
   string pixel_format = "NV12";
   bool fullscreen = false;
+  bool headless = false;
+  unsigned int num_buffers = 4;
 
   const option command_line_options[]
     = { { "device", required_argument, nullptr, 'd' },
         { "pixfmt", required_argument, nullptr, 'p' },
         { "fullscreen", no_argument, nullptr, 'f' },
+        { "buffers", required_argument, nullptr, 'b' },
+        { "headless", no_argument, nullptr, 'H' },
         { 0, 0, 0, 0 } };
 
   while ( true ) {
     const int opt
-      = getopt_long( argc, argv, "d:p:f", command_line_options, nullptr );
+      = getopt_long( argc, argv, "d:p:fb:H", command_line_options, nullptr );
 
     if ( opt == -1 ) {
       break;
@@ -87,6 +93,12 @@ int main( int argc, char* argv[] )
       case 'f':
         fullscreen = true;
         break;
+      case 'b':
+        num_buffers = stoul( optarg );
+        break;
+      case 'H':
+        headless = true;
+        break;
 
       default:
         usage( argv[0] );
@@ -96,14 +108,18 @@ int main( int argc, char* argv[] )
 
   const uint16_t width = 1280;
   const uint16_t height = 720;
-  Camera camera {
-    width, height, PIXEL_FORMAT_STRS.at( pixel_format ), camera_device
-  };
+  Camera camera { width,
+                  height,
+                  PIXEL_FORMAT_STRS.at( pixel_format ),
+                  camera_device,
+                  num_buffers };
 
   RasterHandle r { RasterHandle { width, height } };
 
-  VideoDisplay original_display { r, fullscreen, true };
-  VideoDisplay output_display { r, fullscreen, true };
+  unique_ptr<FrameSink> original_display
+    = make_sink( r, fullscreen, headless, true );
+  unique_ptr<FrameSink> output_display
+    = make_sink( r, fullscreen, headless, true );
 
   const uint8_t thread_count = 2;
   const int distance = 0;
@@ -115,15 +131,17 @@ int main( int argc, char* argv[] )
   chromakey.set_dilate_erode_distance( distance );
 
   const string image_name = "../test_background.jpg";
-  JPEGDecompresser jpegdec;
-  RGBRaster background = jpegdec.load_image( image_name );
+  ImageCache image_cache;
+  RGBRaster background = image_cache.load( image_name );
+
+  latency::dump_at_exit();
 
   thread display_thread( [&] {
     while ( true ) {
       auto raster = camera.get_next_rgb_frame();
 
       if ( raster.has_value() ) {
-        original_display.draw( *raster );
+        original_display->draw( *raster );
       }
 
       chromakey.start_create_mask( *raster );
@@ -131,7 +149,7 @@ int main( int argc, char* argv[] )
 
       chromakey.update_color( *raster );
       if ( raster.has_value() ) {
-        output_display.draw( *raster );
+        output_display->draw( *raster );
       }
     }
   } );
@@ -161,8 +179,10 @@ int main( int argc, char* argv[] )
     }
   } );
 
-  command_thread.join();
-  display_thread.join();
-
-  return EXIT_SUCCESS;
+  /* the windows are drawn from their own threads, but GLFW handles their
+     events (such as resizes) only on the main thread */
+  while ( true ) {
+    GLFWContext::process_events();
+    this_thread::sleep_for( chrono::milliseconds( 20 ) );
+  }
 }
@@ -32,12 +32,16 @@
 #include <fcntl.h>
 #include <iostream>
 #include <memory>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <unordered_set>
 
 #include "jpeg.hh"
 #include "util/exception.hh"
+#include "util/finally.hh"
+#include "util/latency.hh"
+#include "util/pixel_convert.hh"
 
 using namespace std;
 
@@ -48,16 +52,28 @@ unordered_set<uint32_t> SUPPORTED_FORMATS { { V4L2_PIX_FMT_NV12,
 
 const int capture_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
+/* how often the capture thread checks whether it should exit */
+const int capture_poll_timeout_ms = 100;
+
 Camera::Camera( const uint16_t width,
                 const uint16_t height,
                 const uint32_t pixel_format,
-                const string device )
-  : width_( width )
+                const string device,
+                const unsigned int num_buffers )
+  : NUM_BUFFERS( num_buffers )
+  , width_( width )
   , height_( height )
-  , camera_fd_( SystemCall( "open camera", open( device.c_str(), O_RDWR ) ) )
+  , camera_fd_( SystemCall( "open camera",
+                            open( device.c_str(), O_RDWR | O_NONBLOCK ) ) )
   , kernel_v4l2_buffers_()
   , pixel_format_( pixel_format )
 {
+  /* one buffer held by the consumer, one waiting as the latest frame, and at
+     least one for the driver to fill in the meantime */
+  if ( NUM_BUFFERS < 3 ) {
+    throw runtime_error( "at least 3 video4linux2 buffers are required" );
+  }
+
   v4l2_capability cap;
   SystemCall( "ioctl", ioctl( camera_fd_.fd_num(), VIDIOC_QUERYCAP, &cap ) );
 
@@ -100,7 +116,7 @@ Camera::Camera( const uint16_t width,
 
   /* allocate buffers */
   for ( unsigned int i = 0; i < NUM_BUFFERS; i++ ) {
-    v4l2_buffer buffer_info;
+    v4l2_buffer buffer_info {};
     buffer_info.type = capture_type;
     buffer_info.memory = V4L2_MEMORY_MMAP;
     buffer_info.index = i;
@@ -120,76 +136,192 @@ Camera::Camera( const uint16_t width,
 
   SystemCall( "stream on",
               ioctl( camera_fd_.fd_num(), VIDIOC_STREAMON, &capture_type ) );
+
+  capture_thread_ = thread( &Camera::capture_loop, this );
 }
 
 Camera::~Camera()
 {
+  capture_terminate_ = true;
+  capture_thread_.join();
+
   SystemCall( "stream off",
               ioctl( camera_fd_.fd_num(), VIDIOC_STREAMOFF, &capture_type ) );
 }
 
-optional<RasterHandle> Camera::get_next_frame()
+bool Camera::dequeue_buffer( v4l2_buffer& buffer_info )
 {
-  RasterHandle raster_handle { width_, height_ };
-  auto& raster = raster_handle.get();
-
-  v4l2_buffer buffer_info;
+  buffer_info = {};
   buffer_info.type = capture_type;
   buffer_info.memory = V4L2_MEMORY_MMAP;
-  buffer_info.index = next_buffer_index;
 
-  SystemCall( "dequeue buffer",
-              ioctl( camera_fd_.fd_num(), VIDIOC_DQBUF, &buffer_info ) );
+  if ( ioctl( camera_fd_.fd_num(), VIDIOC_DQBUF, &buffer_info ) < 0 ) {
+    if ( errno == EAGAIN ) {
+      return false;
+    }
+    throw unix_error( "dequeue buffer" );
+  }
 
-  const MMap_Region* const mmap_region_
-    = &kernel_v4l2_buffers_.at( next_buffer_index );
+  /* the kernel is free to complete buffers out of order */
+  if ( buffer_info.index >= kernel_v4l2_buffers_.size() ) {
+    throw runtime_error( "driver returned an unknown buffer index" );
+  }
 
-  switch ( pixel_format_ ) {
-    case V4L2_PIX_FMT_YUYV: {
-      uint8_t* src = mmap_region_->addr();
-      uint8_t* dst_y_start = &raster.Y().at( 0, 0 );
-      uint8_t* dst_cb_start = &raster.U().at( 0, 0 );
-      uint8_t* dst_cr_start = &raster.V().at( 0, 0 );
+  return true;
+}
 
-      const size_t y_plane_lenght = width_ * height_;
+void Camera::enqueue_buffer( v4l2_buffer& buffer_info )
+{
+  SystemCall( "enqueue buffer",
+              ioctl( camera_fd_.fd_num(), VIDIOC_QBUF, &buffer_info ) );
+}
+
+void Camera::release_buffer( v4l2_buffer& buffer_info ) noexcept
+{
+  if ( ioctl( camera_fd_.fd_num(), VIDIOC_QBUF, &buffer_info ) == 0 ) {
+    return;
+  }
 
-      for ( size_t i = 0; i < y_plane_lenght; i++ ) {
-        dst_y_start[i] = src[i << 1];
+  /* e.g. the device was unplugged; the next acquire_buffer() throws */
+  const int saved_errno = errno;
+  {
+    lock_guard<mutex> lock( lock_ );
+    if ( not capture_error_ ) {
+      try {
+        capture_error_
+          = make_exception_ptr( unix_error( "enqueue buffer", saved_errno ) );
+      } catch ( ... ) {
+        capture_error_ = current_exception();
       }
+    }
+  } // End of lock scope
+  cv_frame_.notify_all();
+}
 
-      size_t i = 0;
+void Camera::capture_loop()
+{
+  try {
+    pollfd camera_pollfd { camera_fd_.fd_num(), POLLIN, 0 };
 
-      for ( size_t row = 0; row < height_; row++ ) {
-        if ( row % 2 == 1 ) {
+    while ( not capture_terminate_ ) {
+      const int ready = poll( &camera_pollfd, 1, capture_poll_timeout_ms );
+      if ( ready < 0 and errno != EINTR ) {
+        throw unix_error( "poll camera" );
+      }
+      if ( ready <= 0 ) {
+        continue;
+      }
+
+      /* drain every completed buffer, keeping only the newest one */
+      v4l2_buffer buffer_info;
+      while ( dequeue_buffer( buffer_info ) ) {
+        if ( buffer_info.flags & V4L2_BUF_FLAG_ERROR ) {
+          enqueue_buffer( buffer_info );
+          lock_guard<mutex> lock( lock_ );
+          dropped_frames_++;
           continue;
         }
 
-        for ( size_t column = 0; column < width_ / 2; column++ ) {
-          dst_cb_start[i] = src[row * width_ * 2 + column * 4 + 1];
-          dst_cr_start[i] = src[row * width_ * 2 + column * 4 + 3];
-          i++;
+        optional<v4l2_buffer> stale_buffer;
+        {
+          lock_guard<mutex> lock( lock_ );
+          captured_frames_++;
+          if ( latest_buffer_.has_value() ) {
+            stale_buffer = latest_buffer_;
+            dropped_frames_++;
+          }
+          latest_buffer_ = buffer_info;
+          latest_dequeued_ns_ = latency::now_ns();
+        } // End of lock scope
+
+        if ( stale_buffer.has_value() ) {
+          enqueue_buffer( *stale_buffer );
         }
+
+        cv_frame_.notify_one();
       }
     }
+  } catch ( ... ) {
+    {
+      lock_guard<mutex> lock( lock_ );
+      capture_error_ = current_exception();
+    } // End of lock scope
+    cv_frame_.notify_all();
+  }
+}
 
-    break;
+v4l2_buffer Camera::acquire_buffer()
+{
+  unique_lock<mutex> lock( lock_ );
+  cv_frame_.wait(
+    lock, [&] { return latest_buffer_.has_value() or capture_error_; } );
 
-    case V4L2_PIX_FMT_NV12: {
-      memcpy( &raster.Y().at( 0, 0 ), mmap_region_->addr(), width_ * height_ );
+  if ( capture_error_ ) {
+    rethrow_exception( capture_error_ );
+  }
 
-      uint8_t* src_chroma_start = mmap_region_->addr() + width_ * height_;
-      uint8_t* dst_cb_start = &raster.U().at( 0, 0 );
-      uint8_t* dst_cr_start = &raster.V().at( 0, 0 );
+  v4l2_buffer ret = *latest_buffer_;
+  latest_buffer_.reset();
+  latency::record( latency::Stage::Capture,
+                   latency::now_ns() - latest_dequeued_ns_ );
+  return ret;
+}
 
-      size_t chroma_length = width_ * height_ / 4;
+uint64_t Camera::captured_frames()
+{
+  lock_guard<mutex> lock( lock_ );
+  return captured_frames_;
+}
 
-      for ( size_t i = 0; i < chroma_length; i++ ) {
-        dst_cb_start[i] = src_chroma_start[2 * i];
-        dst_cr_start[i] = src_chroma_start[2 * i + 1];
-      }
-    }
+uint64_t Camera::dropped_frames()
+{
+  lock_guard<mutex> lock( lock_ );
+  return dropped_frames_;
+}
 
-    break;
+uint16_t Camera::display_width()
+{
+  return JPEGDecompresser::scaled_size( width_, jpeg_scale_ );
+}
+
+uint16_t Camera::display_height()
+{
+  return JPEGDecompresser::scaled_size( height_, jpeg_scale_ );
+}
+
+void Camera::set_jpeg_scale( const unsigned int denominator )
+{
+  if ( not JPEGDecompresser::valid_scale( denominator ) ) {
+    throw runtime_error( "JPEG scale must be 1/1, 1/2, 1/4 or 1/8" );
+  }
+
+  if ( pixel_format_ != V4L2_PIX_FMT_MJPEG and denominator != 1 ) {
+    throw runtime_error( "decode scaling requires MJPEG capture" );
+  }
+
+  jpeg_scale_ = denominator;
+}
+
+optional<RasterHandle> Camera::get_next_frame()
+{
+  RasterHandle raster_handle { display_width(), display_height() };
+  auto& raster = raster_handle.get();
+
+  v4l2_buffer buffer_info = acquire_buffer();
+  auto requeue = finally( [&] { release_buffer( buffer_info ); } );
+  const latency::ScopedTimer convert_timer { latency::Stage::Convert };
+
+  const MMap_Region* const mmap_region_
+    = &kernel_v4l2_buffers_.at( buffer_info.index );
+
+  switch ( pixel_format_ ) {
+    case V4L2_PIX_FMT_YUYV:
+      pixel_convert::yuyv_to_yuv420( mmap_region_->addr(), raster );
+      break;
+
+    case V4L2_PIX_FMT_NV12:
+      pixel_convert::nv12_to_yuv420( mmap_region_->addr(), raster );
+      break;
 
     case V4L2_PIX_FMT_YUV420: {
       memcpy( &raster.Y().at( 0, 0 ), mmap_region_->addr(), width_ * height_ );
@@ -205,9 +337,11 @@ optional<RasterHandle> Camera::get_next_frame()
 
     case V4L2_PIX_FMT_MJPEG: {
       if ( jpegdec_.has_value() ) {
+        jpegdec_->set_scale( jpeg_scale_ );
         jpegdec_->begin_decoding(
           { mmap_region_->addr(), buffer_info.bytesused } );
-        if ( jpegdec_->width() != width_ or jpegdec_->height() != height_ ) {
+        if ( jpegdec_->width() != display_width()
+             or jpegdec_->height() != display_height() ) {
           throw runtime_error( "size mismatch" );
         }
         jpegdec_->decode( raster );
@@ -218,95 +352,42 @@ optional<RasterHandle> Camera::get_next_frame()
     } break;
   }
 
-  SystemCall( "enqueue buffer",
-              ioctl( camera_fd_.fd_num(), VIDIOC_QBUF, &buffer_info ) );
-
-  next_buffer_index = ( next_buffer_index + 1 ) % NUM_BUFFERS;
-
   return RasterHandle { move( raster_handle ) };
 }
 
 optional<RGBRasterHandle> Camera::get_next_rgb_frame()
 {
-  RGBRasterHandle raster_handle { width_, height_ };
+  RGBRasterHandle raster_handle { display_width(), display_height() };
   auto& raster = raster_handle.get();
 
-  v4l2_buffer buffer_info;
-  buffer_info.type = capture_type;
-  buffer_info.memory = V4L2_MEMORY_MMAP;
-  buffer_info.index = next_buffer_index;
-
-  SystemCall( "dequeue buffer",
-              ioctl( camera_fd_.fd_num(), VIDIOC_DQBUF, &buffer_info ) );
+  v4l2_buffer buffer_info = acquire_buffer();
+  auto requeue = finally( [&] { release_buffer( buffer_info ); } );
+  const latency::ScopedTimer convert_timer { latency::Stage::Convert };
 
   const MMap_Region* const mmap_region_
-    = &kernel_v4l2_buffers_.at( next_buffer_index );
+    = &kernel_v4l2_buffers_.at( buffer_info.index );
 
   switch ( pixel_format_ ) {
-    case V4L2_PIX_FMT_YUYV: {
-      uint8_t* src = mmap_region_->addr();
-      uint8_t* dst_y_start = &raster.Y().at( 0, 0 );
-      uint8_t* dst_cb_start = &raster.U().at( 0, 0 );
-      uint8_t* dst_cr_start = &raster.V().at( 0, 0 );
-
-      const size_t y_plane_lenght = width_ * height_;
-
-      for ( size_t i = 0; i < y_plane_lenght; i++ ) {
-        dst_y_start[i] = src[i << 1];
-      }
-
-      size_t i = 0;
-
-      for ( size_t row = 0; row < height_; row++ ) {
-        if ( row % 2 == 1 ) {
-          continue;
-        }
-
-        for ( size_t column = 0; column < width_ / 2; column++ ) {
-          dst_cb_start[i] = src[row * width_ * 2 + column * 4 + 1];
-          dst_cr_start[i] = src[row * width_ * 2 + column * 4 + 3];
-          i++;
-        }
-      }
-    }
-    yuv_to_rgb( raster );
-    break;
-
-    case V4L2_PIX_FMT_NV12: {
-      memcpy( &raster.Y().at( 0, 0 ), mmap_region_->addr(), width_ * height_ );
-
-      uint8_t* src_chroma_start = mmap_region_->addr() + width_ * height_;
-      uint8_t* dst_cb_start = &raster.U().at( 0, 0 );
-      uint8_t* dst_cr_start = &raster.V().at( 0, 0 );
+    case V4L2_PIX_FMT_YUYV:
+      pixel_convert::yuyv_to_rgb( mmap_region_->addr(), raster );
+      break;
 
-      size_t chroma_length = width_ * height_ / 4;
+    case V4L2_PIX_FMT_NV12:
+      pixel_convert::nv12_to_rgb( mmap_region_->addr(), raster );
+      break;
 
-      for ( size_t i = 0; i < chroma_length; i++ ) {
-        dst_cb_start[i] = src_chroma_start[2 * i];
-        dst_cr_start[i] = src_chroma_start[2 * i + 1];
-      }
-    }
-    yuv_to_rgb( raster );
-    break;
-
-    case V4L2_PIX_FMT_YUV420: {
-      memcpy( &raster.Y().at( 0, 0 ), mmap_region_->addr(), width_ * height_ );
-      memcpy( &raster.U().at( 0, 0 ),
-              mmap_region_->addr() + width_ * height_,
-              width_ * height_ / 4 );
-      memcpy( &raster.V().at( 0, 0 ),
-              mmap_region_->addr() + width_ * height_ * 5 / 4,
-              width_ * height_ / 4 );
-    }
-    yuv_to_rgb( raster );
-    break;
+    case V4L2_PIX_FMT_YUV420:
+      pixel_convert::yuv420_to_rgb( mmap_region_->addr(), raster );
+      break;
 
     case V4L2_PIX_FMT_MJPEG: {
       if ( jpegdec_.has_value() ) {
         jpegdec_->set_output_rgb();
+        jpegdec_->set_scale( jpeg_scale_ );
         jpegdec_->begin_decoding(
           { mmap_region_->addr(), buffer_info.bytesused } );
-        if ( jpegdec_->width() != width_ or jpegdec_->height() != height_ ) {
+        if ( jpegdec_->width() != display_width()
+             or jpegdec_->height() != display_height() ) {
           throw runtime_error( "size mismatch" );
         }
         jpegdec_->decode( raster );
@@ -317,34 +398,5 @@ optional<RGBRasterHandle> Camera::get_next_rgb_frame()
     } break;
   }
 
-  SystemCall( "enqueue buffer",
-              ioctl( camera_fd_.fd_num(), VIDIOC_QBUF, &buffer_info ) );
-
-  next_buffer_index = ( next_buffer_index + 1 ) % NUM_BUFFERS;
-
   return RGBRasterHandle { move( raster_handle ) };
 }
-
-void Camera::yuv_to_rgb_pixel( uint8_t y, uint8_t u, uint8_t v, uint8_t& r, uint8_t& g, uint8_t& b )
-{
-  r = max(0.0, min(255.0, 1.16438356164384 * (y - 16) + 1.59567019581339  * (v - 128)));
-  g = max(0.0, min(255.0, 1.16438356164384 * (y - 16) - 0.391260370716072 * (u - 128) - 0.813004933873461 * (v - 128)));
-  b = max(0.0, min(255.0, 1.16438356164384 * (y - 16) + 2.01741475897078  * (u - 128)));
-}
-
-void Camera::yuv_to_rgb( BaseRaster& raster )
-{
-  // Going backwards to avoid overwriting unprocessed data in YUV
-  for ( int row = height_ - 1; row >= 0; row-- ) {
-    for ( int col = width_ - 1; col >=0; col-- ) {
-      uint8_t y = raster.Y().at( col, row );
-      uint8_t u = raster.U().at( col / 2, row / 4 );
-      uint8_t v = raster.V().at( col / 2, row / 4 );
-      uint8_t r, g, b;
-      yuv_to_rgb_pixel( y, u, v, r, g, b );
-      raster.Y().at( col, row ) = r;
-      raster.U().at( col, row ) = g;
-      raster.V().at( col, row ) = b;
-    }
-  }
-}
@@ -31,7 +31,12 @@
 
 #include <linux/videodev2.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <unordered_map>
 
 #include "frame_input.hh"
@@ -47,45 +52,77 @@ static const std::unordered_map<std::string, uint32_t> PIXEL_FORMAT_STRS {
   { "MJPG", V4L2_PIX_FMT_MJPEG }
 };
 
+/* Frames are dequeued by a dedicated capture thread, which holds on to the
+   freshest one and hands every older buffer straight back to the driver. A
+   consumer that falls behind therefore sees the newest frame (and a count
+   of the ones it missed) instead of a backlog of NUM_BUFFERS stale frames. */
+
 class Camera : public FrameInput
 {
 private:
-  const unsigned int NUM_BUFFERS = 4;
+  const unsigned int NUM_BUFFERS;
 
   uint16_t width_;
   uint16_t height_;
 
   FileDescriptor camera_fd_;
   std::vector<MMap_Region> kernel_v4l2_buffers_;
-  unsigned int next_buffer_index = 0;
 
   uint32_t pixel_format_;
 
   std::optional<JPEGDecompresser> jpegdec_ {};
-
-  void yuv_to_rgb_pixel( uint8_t y,
-                         uint8_t u,
-                         uint8_t v,
-                         uint8_t& r,
-                         uint8_t& g,
-                         uint8_t& b );
-  void yuv_to_rgb( BaseRaster& raster );
+  unsigned int jpeg_scale_ { 1 };
+
+  // For the capture thread
+  std::mutex lock_ {};
+  std::condition_variable cv_frame_ {};
+  std::optional<v4l2_buffer> latest_buffer_ {};
+  uint64_t latest_dequeued_ns_ { 0 };
+  std::exception_ptr capture_error_ {};
+  std::atomic<bool> capture_terminate_ { false };
+  uint64_t captured_frames_ { 0 };
+  uint64_t dropped_frames_ { 0 };
+  std::thread capture_thread_ {};
+
+  void capture_loop();
+  bool dequeue_buffer( v4l2_buffer& buffer_info );
+  void enqueue_buffer( v4l2_buffer& buffer_info );
+
+  // Requeues a buffer handed out by acquire_buffer(); runs from a
+  // destructor, so a failure is reported through capture_error_ instead
+  void release_buffer( v4l2_buffer& buffer_info ) noexcept;
+
+  // Blocks until a frame newer than the last one returned is available
+  v4l2_buffer acquire_buffer();
 
 public:
   Camera( const uint16_t width,
           const uint16_t height,
           const uint32_t pixel_format = V4L2_PIX_FMT_YUV420,
-          const std::string device = "/dev/video0" );
+          const std::string device = "/dev/video0",
+          const unsigned int num_buffers = 4 );
 
   ~Camera();
 
+  /* forbid copying */
+  Camera( const Camera& other ) = delete;
+  Camera& operator=( const Camera& other ) = delete;
+
   std::optional<RasterHandle> get_next_frame() override;
   std::optional<RGBRasterHandle> get_next_rgb_frame() override;
 
-  uint16_t display_width() { return width_; }
-  uint16_t display_height() { return height_; }
+  // Size of the frames returned, after any decode scaling
+  uint16_t display_width();
+  uint16_t display_height();
+
+  // For MJPEG capture, decode at 1/denominator (1, 2, 4 or 8) of the
+  // capture size
+  void set_jpeg_scale( const unsigned int denominator );
 
   FileDescriptor& fd() { return camera_fd_; }
+
+  uint64_t captured_frames();
+  uint64_t dropped_frames();
 };
 
 #endif
@@ -0,0 +1,208 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "image_cache.hh"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jpeg.hh"
+#include "util/bytes.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/file_descriptor.hh"
+#include "util/mmap_region.hh"
+
+using namespace std;
+
+static const string CACHE_MAGIC = "RGBAPLANES1";
+static constexpr size_t ROW_ALIGNMENT = 64;
+static constexpr unsigned int PLANE_COUNT = 4;
+
+/* layout shared by the reader and the writer */
+struct CacheLayout
+{
+  uint32_t width, height;
+  size_t stride { round_up( width, ROW_ALIGNMENT ) };
+  size_t plane_length { round_up( stride * height, page_size() ) };
+
+  size_t plane_offset( const unsigned int plane ) const
+  {
+    return page_size() + plane * plane_length;
+  }
+
+  size_t file_length() const { return plane_offset( PLANE_COUNT ); }
+};
+
+template<class RasterType, class PlaneType>
+static array<PlaneType*, PLANE_COUNT> planes( RasterType& image )
+{
+  return { &image.R(), &image.G(), &image.B(), &image.A() };
+}
+
+/* like mkdir -p; failures surface when the cache file is created */
+static void make_directories( const string& path )
+{
+  for ( size_t slash = path.find( '/', 1 ); slash != string::npos;
+        slash = path.find( '/', slash + 1 ) ) {
+    mkdir( path.substr( 0, slash ).c_str(), 0755 );
+  }
+  mkdir( path.c_str(), 0755 );
+}
+
+ImageCache::ImageCache( const string& directory )
+  : directory_( directory )
+{}
+
+string ImageCache::default_directory()
+{
+  const char* const xdg_cache_home = getenv( "XDG_CACHE_HOME" );
+  if ( xdg_cache_home and *xdg_cache_home ) {
+    return string( xdg_cache_home ) + "/compositor";
+  }
+
+  const char* const home = getenv( "HOME" );
+  return string( home ? home : "/tmp" ) + "/.cache/compositor";
+}
+
+uint64_t ImageCache::hash( const Chunk& data )
+{
+  return fnv1a( data.buffer(), data.size() );
+}
+
+string ImageCache::cache_filename( const uint64_t hash,
+                                   const unsigned int scale_denominator ) const
+{
+  char name[64];
+  snprintf( name,
+            sizeof( name ),
+            "/%016llx-1_%u.rgba",
+            static_cast<unsigned long long>( hash ),
+            scale_denominator );
+  return directory_ + name;
+}
+
+optional<RGBRaster> ImageCache::read_cached( const string& filename,
+                                            const uint64_t hash )
+{
+  struct stat cache_info;
+  if ( stat( filename.c_str(), &cache_info ) < 0 ) {
+    return {};
+  }
+
+  const File cache_file { filename };
+  const Chunk contents = cache_file.chunk();
+
+  if ( contents.size() < page_size()
+       or contents( 0, CACHE_MAGIC.size() ).to_string() != CACHE_MAGIC
+       or contents( CACHE_MAGIC.size() ).le64() != hash ) {
+    return {};
+  }
+
+  const CacheLayout layout {
+    static_cast<uint32_t>( contents( CACHE_MAGIC.size() + 8 ).le32() ),
+    static_cast<uint32_t>( contents( CACHE_MAGIC.size() + 12 ).le32() )
+  };
+
+  if ( layout.width == 0 or layout.width > UINT16_MAX or layout.height == 0
+       or layout.height > UINT16_MAX
+       or contents.size() != layout.file_length() ) {
+    return {};
+  }
+
+  const uint16_t width = layout.width;
+  const uint16_t height = layout.height;
+  RGBRaster image { width, height, width, height };
+
+  const auto image_planes = planes<RGBRaster, TwoD<uint8_t>>( image );
+  for ( unsigned int plane = 0; plane < PLANE_COUNT; plane++ ) {
+    const uint8_t* source = contents.buffer() + layout.plane_offset( plane );
+
+    for ( unsigned int row = 0; row < height; row++ ) {
+      memcpy( &image_planes[plane]->at( 0, row ), source, width );
+      source += layout.stride;
+    }
+  }
+
+  return image;
+}
+
+void ImageCache::write_cached( const string& filename,
+                               const uint64_t hash,
+                               const RGBRaster& image )
+{
+  const CacheLayout layout { image.display_width(), image.display_height() };
+
+  /* write to a temporary name and rename, so readers never see half a file */
+  const string temp_name = filename + ".tmp";
+
+  {
+    FileDescriptor cache_fd { SystemCall(
+      temp_name,
+      open( temp_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) ) };
+    SystemCall( "ftruncate",
+                ftruncate( cache_fd.fd_num(), layout.file_length() ) );
+
+    MMap_Region region { layout.file_length(),
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED,
+                         cache_fd.fd_num() };
+    uint8_t* const contents = region.addr();
+
+    const uint64_t le_hash = htole64( hash );
+    const uint32_t le_width = htole32( layout.width );
+    const uint32_t le_height = htole32( layout.height );
+    memcpy( contents, CACHE_MAGIC.data(), CACHE_MAGIC.size() );
+    memcpy( contents + CACHE_MAGIC.size(), &le_hash, 8 );
+    memcpy( contents + CACHE_MAGIC.size() + 8, &le_width, 4 );
+    memcpy( contents + CACHE_MAGIC.size() + 12, &le_height, 4 );
+
+    const auto image_planes
+      = planes<const RGBRaster, const TwoD<uint8_t>>( image );
+    for ( unsigned int plane = 0; plane < PLANE_COUNT; plane++ ) {
+      uint8_t* target = contents + layout.plane_offset( plane );
+
+      for ( unsigned int row = 0; row < layout.height; row++ ) {
+        memcpy( target, &image_planes[plane]->at( 0, row ), layout.width );
+        target += layout.stride;
+      }
+    }
+  } // End of file scope
+
+  SystemCall( "rename", rename( temp_name.c_str(), filename.c_str() ) );
+}
+
+RGBRaster ImageCache::load( const string& image_name,
+                            const unsigned int scale_denominator )
+{
+  const File image_file { image_name };
+  const uint64_t image_hash = hash( image_file.chunk() );
+  const string filename = cache_filename( image_hash, scale_denominator );
+
+  try {
+    optional<RGBRaster> cached = read_cached( filename, image_hash );
+    if ( cached.has_value() ) {
+      return move( *cached );
+    }
+  } catch ( const exception& ) {
+    /* unreadable cache entry; decode and replace it below */
+  }
+
+  JPEGDecompresser jpegdec;
+  jpegdec.set_scale( scale_denominator );
+  RGBRaster image = jpegdec.load_image( image_file.chunk() );
+
+  try {
+    make_directories( directory_ );
+    write_cached( filename, image_hash, image );
+  } catch ( const exception& ) {
+    /* the cache is only an optimization, e.g. the directory may be
+       read-only */
+  }
+
+  return image;
+}
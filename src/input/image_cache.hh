@@ -0,0 +1,51 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef IMAGE_CACHE_HH
+#define IMAGE_CACHE_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "util/chunk.hh"
+#include "util/raster.hh"
+
+/* On-disk cache of decoded still images (background plates).
+
+   The first load of an image decodes the JPEG and writes its R, G, B and A
+   planes to DIRECTORY/HASH-1_SCALE.rgba, where HASH is a hash of the JPEG
+   file and SCALE the decode scale denominator. Rows are padded to a
+   multiple of 64 bytes and each plane starts on a page boundary. Later
+   loads of the same file at the same scale mmap that file and copy the
+   planes out, which costs a hash of the JPEG and a memcpy instead of a
+   decode (and is served from the page cache when the plate was used
+   recently). */
+
+class ImageCache
+{
+private:
+  std::string directory_;
+
+  std::string cache_filename( const uint64_t hash,
+                              const unsigned int scale_denominator ) const;
+
+  static std::optional<RGBRaster> read_cached( const std::string& filename,
+                                               const uint64_t hash );
+  static void write_cached( const std::string& filename,
+                            const uint64_t hash,
+                            const RGBRaster& image );
+
+public:
+  ImageCache( const std::string& directory = default_directory() );
+
+  // $XDG_CACHE_HOME/compositor, or ~/.cache/compositor
+  static std::string default_directory();
+
+  // 64-bit FNV-1a
+  static uint64_t hash( const Chunk& data );
+
+  RGBRaster load( const std::string& image_name,
+                  const unsigned int scale_denominator = 1 );
+};
+
+#endif /* IMAGE_CACHE_HH */
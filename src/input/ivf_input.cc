@@ -0,0 +1,125 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "ivf_input.hh"
+
+#include <cstring>
+
+#include "util/exception.hh"
+#include "util/pixel_convert.hh"
+
+using namespace std;
+
+IVFInput::IVFInput( const string& filename )
+  : ivf_( filename )
+  , mjpeg_( ivf_.fourcc() == "MJPG" )
+{
+  if ( not mjpeg_ and ivf_.fourcc() != "I420" ) {
+    throw Unsupported( "IVF fourcc " + ivf_.fourcc()
+                       + " (only MJPG and I420 can be decoded)" );
+  }
+
+  rgb_decompresser_.set_output_rgb();
+}
+
+optional<Chunk> IVFInput::next_frame_data()
+{
+  if ( next_frame_ >= ivf_.frame_count() ) {
+    return {};
+  }
+
+  const Chunk frame = ivf_.frame( next_frame_ );
+  next_frame_++;
+
+  ivf_.prefetch( next_frame_, READAHEAD_FRAMES );
+
+  if ( not mjpeg_ ) {
+    const size_t luma = size_t { ivf_.width() } * ivf_.height();
+    const size_t chroma
+      = size_t { ( ivf_.width() + 1u ) / 2 } * ( ( ivf_.height() + 1u ) / 2 );
+    if ( frame.size() < luma + 2 * chroma ) {
+      throw Invalid( "I420 frame too short" );
+    }
+  }
+
+  return frame;
+}
+
+optional<RasterHandle> IVFInput::get_next_frame()
+{
+  const optional<Chunk> frame = next_frame_data();
+  if ( not frame.has_value() ) {
+    return {};
+  }
+
+  RasterHandle raster_handle { display_width(), display_height() };
+  BaseRaster& raster = raster_handle.get();
+
+  if ( mjpeg_ ) {
+    yuv_decompresser_.begin_decoding( *frame );
+    if ( yuv_decompresser_.width() != display_width()
+         or yuv_decompresser_.height() != display_height() ) {
+      throw runtime_error( "size mismatch" );
+    }
+    yuv_decompresser_.decode( raster );
+    return { move( raster_handle ) };
+  }
+
+  const unsigned int chroma_width = ( display_width() + 1u ) / 2;
+  const unsigned int chroma_height = ( display_height() + 1u ) / 2;
+
+  const uint8_t* const y = frame->buffer();
+  const uint8_t* const u = y + display_width() * display_height();
+  const uint8_t* const v = u + chroma_width * chroma_height;
+
+  for ( unsigned int row = 0; row < display_height(); row++ ) {
+    memcpy(
+      &raster.Y().at( 0, row ), y + row * display_width(), display_width() );
+  }
+
+  const unsigned int copy_width
+    = min<unsigned int>( raster.U().width(), chroma_width );
+  const unsigned int copy_height
+    = min<unsigned int>( raster.U().height(), chroma_height );
+
+  for ( unsigned int row = 0; row < copy_height; row++ ) {
+    memcpy( &raster.U().at( 0, row ), u + row * chroma_width, copy_width );
+    memcpy( &raster.V().at( 0, row ), v + row * chroma_width, copy_width );
+  }
+
+  return { move( raster_handle ) };
+}
+
+optional<RGBRasterHandle> IVFInput::get_next_rgb_frame()
+{
+  const optional<Chunk> frame = next_frame_data();
+  if ( not frame.has_value() ) {
+    return {};
+  }
+
+  RGBRasterHandle raster_handle { display_width(), display_height() };
+  RGBRaster& raster = raster_handle.get();
+
+  if ( mjpeg_ ) {
+    rgb_decompresser_.begin_decoding( *frame );
+    if ( rgb_decompresser_.width() != display_width()
+         or rgb_decompresser_.height() != display_height() ) {
+      throw runtime_error( "size mismatch" );
+    }
+    rgb_decompresser_.decode( raster );
+  } else {
+    pixel_convert::yuv420_to_rgb( frame->buffer(), raster );
+  }
+
+  return { move( raster_handle ) };
+}
+
+void IVFInput::seek( const uint32_t frame_no )
+{
+  next_frame_ = frame_no;
+  ivf_.prefetch( next_frame_, READAHEAD_FRAMES );
+}
+
+void IVFInput::seek_to_timestamp( const uint64_t pts )
+{
+  seek( ivf_.frame_for_pts( pts ) );
+}
@@ -0,0 +1,54 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef IVF_INPUT_HH
+#define IVF_INPUT_HH
+
+#include <optional>
+#include <string>
+
+#include "frame_input.hh"
+#include "jpeg.hh"
+#include "util/ivf.hh"
+
+/* Plays back an IVF file whose frames are Motion-JPEG ("MJPG") or raw
+   planar 4:2:0 ("I420"). Opening the file costs one read of its header
+   (see IVF); frames are located and decoded on demand, and the next few are
+   prefetched as each is returned. */
+
+class IVFInput : public FrameInput
+{
+private:
+  IVF ivf_;
+  bool mjpeg_;
+
+  JPEGDecompresser yuv_decompresser_ {};
+  JPEGDecompresser rgb_decompresser_ {};
+
+  // Next frame to be returned
+  uint32_t next_frame_ { 0 };
+
+  static constexpr uint32_t READAHEAD_FRAMES = 4;
+
+  std::optional<Chunk> next_frame_data();
+
+public:
+  IVFInput( const std::string& filename );
+
+  std::optional<RasterHandle> get_next_frame() override;
+  std::optional<RGBRasterHandle> get_next_rgb_frame() override;
+
+  uint16_t display_width() override { return ivf_.width(); }
+  uint16_t display_height() override { return ivf_.height(); }
+
+  // Makes frame_no the next frame returned
+  void seek( const uint32_t frame_no );
+
+  // Seeks to the frame showing at `pts` (in time_scale() units)
+  void seek_to_timestamp( const uint64_t pts );
+
+  uint32_t frame_count() const { return ivf_.frame_count(); }
+  uint32_t frame_rate() const { return ivf_.frame_rate(); }
+  uint32_t time_scale() const { return ivf_.time_scale(); }
+};
+
+#endif /* IVF_INPUT_HH */
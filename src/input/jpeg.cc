@@ -26,13 +26,46 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <iostream>
+#include <tuple>
 
 #include "jpeg.hh"
+#include "util/file.hh"
+#include "util/pixel_convert.hh"
 
 using namespace std;
 
+/* libjpeg 7 and later can scale the IDCT differently in each direction */
+static unsigned int dct_scaled_size( const jpeg_component_info& component )
+{
+#if JPEG_LIB_VERSION >= 70
+  return component.DCT_v_scaled_size;
+#else
+  return component.DCT_scaled_size;
+#endif
+}
+
+static unsigned int dct_h_scaled_size( const jpeg_component_info& component )
+{
+#if JPEG_LIB_VERSION >= 70
+  return component.DCT_h_scaled_size;
+#else
+  return component.DCT_scaled_size;
+#endif
+}
+
+static unsigned int min_dct_scaled_size( const jpeg_decompress_struct& cinfo )
+{
+#if JPEG_LIB_VERSION >= 70
+  return cinfo.min_DCT_v_scaled_size;
+#else
+  return cinfo.min_DCT_scaled_size;
+#endif
+}
+
 JPEGDecompresser::JPEGDecompresser()
 {
   jpeg_std_error( &error_manager_ );
@@ -54,8 +87,61 @@ void JPEGDecompresser::error( const j_common_ptr cinfo )
   throw runtime_error( error_message.data() );
 }
 
-void JPEGDecompresser::begin_decoding( const Chunk& chunk )
+/* Y'CbCr with chroma halved horizontally, and optionally vertically. When
+   the IDCT is scaled, libjpeg may scale chroma less than luma to save
+   upsampling it later, so this compares the sizes the IDCT will produce
+   rather than just the sampling factors. */
+bool JPEGDecompresser::raw_output_supported() const
+{
+  if ( decompresser_.jpeg_color_space != JCS_YCbCr
+       or decompresser_.num_components != 3 ) {
+    return false;
+  }
+
+  const jpeg_component_info* const comp = decompresser_.comp_info;
+
+  const auto h_size = [&]( const unsigned int c ) {
+    return comp[c].h_samp_factor * dct_h_scaled_size( comp[c] );
+  };
+  const auto v_size = [&]( const unsigned int c ) {
+    return comp[c].v_samp_factor * dct_scaled_size( comp[c] );
+  };
+
+  if ( h_size( 1 ) != h_size( 2 ) or v_size( 1 ) != v_size( 2 ) ) {
+    return false;
+  }
+
+  return h_size( 0 ) == 2 * h_size( 1 )
+         and ( v_size( 0 ) == v_size( 1 ) or v_size( 0 ) == 2 * v_size( 1 ) );
+}
+
+bool JPEGDecompresser::valid_scale( const unsigned int denominator )
+{
+  return denominator == 1 or denominator == 2 or denominator == 4
+         or denominator == 8;
+}
+
+void JPEGDecompresser::set_scale( const unsigned int denominator )
 {
+  if ( not valid_scale( denominator ) ) {
+    throw runtime_error( "JPEG scale must be 1/1, 1/2, 1/4 or 1/8" );
+  }
+
+  scale_denom_ = denominator;
+}
+
+unsigned int JPEGDecompresser::scaled_size( const unsigned int size,
+                                            const unsigned int denominator )
+{
+  return ( size + denominator - 1 ) / denominator;
+}
+
+/* reads the header of any three-component JPEG */
+void JPEGDecompresser::begin_reading( const Chunk& chunk )
+{
+  /* discard any image that was started but not decoded */
+  jpeg_abort_decompress( &decompresser_ );
+
   /* older versions of libjpeg did not use a const pointer
      in jpeg_mem_src's buffer argument */
   jpeg_mem_src(
@@ -65,55 +151,38 @@ void JPEGDecompresser::begin_decoding( const Chunk& chunk )
     throw runtime_error( "invalid JPEG" );
   }
 
-  if ( decompresser_.jpeg_color_space != JCS_YCbCr ) {
-    throw runtime_error( "not Y'CbCr" );
-  }
-
-  if ( toRGB_ ) {
-    decompresser_.out_color_space = JCS_RGB;
-  } else {
-    decompresser_.out_color_space = JCS_YCbCr;
-  }
-
   if ( decompresser_.num_components != 3 ) {
     throw runtime_error( "not 3 components" );
   }
+}
 
-  if ( not( decompresser_.comp_info[0].h_samp_factor == 2
-            and decompresser_.comp_info[0].v_samp_factor == 1
-            and decompresser_.comp_info[1].h_samp_factor == 1
-            and decompresser_.comp_info[1].v_samp_factor == 1
-            and decompresser_.comp_info[2].h_samp_factor == 1
-            and decompresser_.comp_info[2].v_samp_factor == 1 )
-       and not( decompresser_.comp_info[0].h_samp_factor == 2
-                and decompresser_.comp_info[0].v_samp_factor == 2
-                and decompresser_.comp_info[1].h_samp_factor == 1
-                and decompresser_.comp_info[1].v_samp_factor == 2
-                and decompresser_.comp_info[2].h_samp_factor == 1
-                and decompresser_.comp_info[2].v_samp_factor == 2 ) ) {
-    throw runtime_error( "not 4:2:2" );
-  }
+void JPEGDecompresser::begin_decoding( const Chunk& chunk )
+{
+  begin_reading( chunk );
 
-  if ( YUV_.has_value() ) {
-    if ( YUV_->height() != height() or YUV_->width() != 3 * width() ) {
-      throw runtime_error( "JPEG size changed" );
-    }
-  } else {
-    YUV_.emplace( 3 * width(), height() );
-    for ( unsigned int i = 0; i < height(); i++ ) {
-      YUV_rows.emplace_back( &YUV_->at( 0, i ) );
-    }
+  if ( decompresser_.jpeg_color_space != JCS_YCbCr ) {
+    throw runtime_error( "not Y'CbCr" );
   }
+
+  prepare_output();
+}
+
+/* sets up the (possibly scaled) output dimensions */
+void JPEGDecompresser::prepare_output()
+{
+  decompresser_.scale_num = 1;
+  decompresser_.scale_denom = scale_denom_;
+  jpeg_calc_output_dimensions( &decompresser_ );
 }
 
 unsigned int JPEGDecompresser::width() const
 {
-  return decompresser_.image_width;
+  return decompresser_.output_width;
 }
 
 unsigned int JPEGDecompresser::height() const
 {
-  return decompresser_.image_height;
+  return decompresser_.output_height;
 }
 
 void JPEGDecompresser::decode( BaseRaster& r )
@@ -122,53 +191,194 @@ void JPEGDecompresser::decode( BaseRaster& r )
     throw runtime_error( "size mismatch" );
   }
 
+  if ( raw_output_supported() ) {
+    decode_raw( r );
+  } else {
+    decode_scanlines( r );
+  }
+}
+
+/* Decodes the downsampled Y'CbCr planes with jpeg_read_raw_data, skipping
+   libjpeg's upsampling and color conversion. Luma rows are written straight
+   into the raster (the R plane for RGB output). Chroma goes straight into
+   the U/V planes, or into chroma_ for RGB output, which is then converted
+   in place by pixel_convert. */
+void JPEGDecompresser::decode_raw( BaseRaster& r )
+{
+  struct PlaneTarget
+  {
+    uint8_t* base;
+    size_t stride;
+    unsigned int width, height;
+    unsigned int row_step; /* keep every row_step-th source row */
+  };
+
+  decompresser_.out_color_space = JCS_YCbCr;
+  decompresser_.raw_data_out = true;
   jpeg_start_decompress( &decompresser_ );
 
-  while ( decompresser_.output_scanline < decompresser_.output_height ) {
-    jpeg_read_scanlines(
-      &decompresser_, &YUV_rows.at( decompresser_.output_scanline ), height() );
+  const jpeg_component_info* const comp = decompresser_.comp_info;
+  const bool chroma_subsampled_vertically
+    = comp[1].v_samp_factor * dct_scaled_size( comp[1] )
+      < comp[0].v_samp_factor * dct_scaled_size( comp[0] );
+  const unsigned int chroma_width = comp[1].downsampled_width;
+  const unsigned int chroma_height = comp[1].downsampled_height;
+
+  array<PlaneTarget, 3> targets;
+  targets[0] = { &r.Y().at( 0, 0 ),
+                 r.Y().width(),
+                 r.display_width(),
+                 r.display_height(),
+                 1 };
+
+  if ( toRGB_ ) {
+    chroma_.resize( 2 * chroma_width * chroma_height );
+    targets[1]
+      = { chroma_.data(), chroma_width, chroma_width, chroma_height, 1 };
+    targets[2] = { chroma_.data() + chroma_width * chroma_height,
+                   chroma_width,
+                   chroma_width,
+                   chroma_height,
+                   1 };
+  } else {
+    /* the raster is 4:2:0, so 4:2:2 chroma keeps only the even rows */
+    const unsigned int row_step = chroma_subsampled_vertically ? 1 : 2;
+    const unsigned int width
+      = min<unsigned int>( r.chroma_display_width(), r.U().width() );
+    const unsigned int height
+      = min<unsigned int>( r.chroma_display_height(), r.U().height() );
+    targets[1]
+      = { &r.U().at( 0, 0 ), r.U().width(), width, height, row_step };
+    targets[2]
+      = { &r.V().at( 0, 0 ), r.V().width(), width, height, row_step };
   }
 
-  jpeg_finish_decompress( &decompresser_ );
+  /* the IDCT writes whole blocks, so rows are padded past the image */
+  const unsigned int lines_per_imcu_row
+    = decompresser_.max_v_samp_factor * min_dct_scaled_size( decompresser_ );
+  const size_t scratch_row_length
+    = comp[0].width_in_blocks * dct_scaled_size( comp[0] );
+  const unsigned int scratch_rows
+    = decompresser_.max_v_samp_factor * dct_scaled_size( comp[0] );
+  raw_scratch_.resize( 3 * scratch_rows * scratch_row_length );
+
+  array<vector<JSAMPROW>, 3> rows;
+  array<JSAMPARRAY, 3> planes;
+
+  /* (scratch row, destination row, length) for planes too narrow to take
+     the padded rows directly */
+  vector<tuple<const uint8_t*, uint8_t*, size_t>> pending_copies;
 
-  for ( size_t row = 0; row < height(); row++ ) {
-    for ( size_t column = 0; column < width(); column++ ) {
-      r.Y().at( column, row ) = YUV_->at( column * 3, row );
-      if ( row < height() / image_ratio_ && column < width() / image_ratio_ ) {
-        r.U().at( column, row )
-          = YUV_->at( column * image_ratio_ * 3 + 1, row * image_ratio_ );
-        r.V().at( column, row )
-          = YUV_->at( column * image_ratio_ * 3 + 2, row * image_ratio_ );
+  while ( decompresser_.output_scanline < decompresser_.output_height ) {
+    const unsigned int imcu_row
+      = decompresser_.output_scanline / lines_per_imcu_row;
+    pending_copies.clear();
+
+    for ( unsigned int c = 0; c < 3; c++ ) {
+      PlaneTarget& target = targets[c];
+      const unsigned int rows_per_imcu
+        = comp[c].v_samp_factor * dct_scaled_size( comp[c] );
+      const size_t padded_width
+        = comp[c].width_in_blocks * dct_scaled_size( comp[c] );
+      const bool fits = padded_width <= target.stride;
+
+      rows[c].resize( rows_per_imcu );
+      for ( unsigned int i = 0; i < rows_per_imcu; i++ ) {
+        const unsigned int src_row = imcu_row * rows_per_imcu + i;
+        const unsigned int dst_row = src_row / target.row_step;
+        const bool wanted
+          = src_row % target.row_step == 0 and dst_row < target.height;
+        uint8_t* const dst = target.base + dst_row * target.stride;
+        uint8_t* const scratch
+          = &raw_scratch_[( c * scratch_rows + i ) * scratch_row_length];
+
+        if ( wanted and fits ) {
+          rows[c][i] = dst;
+        } else {
+          rows[c][i] = scratch;
+          if ( wanted ) {
+            pending_copies.emplace_back( scratch, dst, target.width );
+          }
+        }
       }
+      planes[c] = rows[c].data();
     }
-  }
-}
 
-RGBRaster JPEGDecompresser::load_image( const string& image_name )
-{
-  FILE* file = fopen( image_name.c_str(), "rb" );
-  if ( !file ) {
-    throw runtime_error( "Error reading file: " + image_name );
+    jpeg_read_raw_data( &decompresser_, planes.data(), lines_per_imcu_row );
+
+    for ( const auto& [src, dst, length] : pending_copies ) {
+      memcpy( dst, src, length );
+    }
   }
 
-  jpeg_stdio_src( &decompresser_, file );
+  jpeg_finish_decompress( &decompresser_ );
 
-  if ( JPEG_HEADER_OK != jpeg_read_header( &decompresser_, true ) ) {
-    throw runtime_error( "invalid JPEG" );
+  if ( toRGB_ ) {
+    /* R, G and B live in the Y, U and V planes of an RGBRaster */
+    for ( unsigned int row = 0; row < r.display_height(); row++ ) {
+      const unsigned int chroma_row
+        = chroma_subsampled_vertically ? row / 2 : row;
+      pixel_convert::yuv422_row_to_rgb(
+        &r.Y().at( 0, row ),
+        targets[1].base + chroma_row * chroma_width,
+        targets[2].base + chroma_row * chroma_width,
+        &r.Y().at( 0, row ),
+        &r.U().at( 0, row ),
+        &r.V().at( 0, row ),
+        r.display_width(),
+        true );
+    }
   }
+}
 
-  decompresser_.out_color_space = JCS_RGB;
+/* Decodes one interleaved scanline at a time, for JPEGs that aren't 4:2:x
+   Y'CbCr (e.g. still images in other layouts, or some scaled 4:2:0) */
+void JPEGDecompresser::decode_scanlines( BaseRaster& r )
+{
+  decompresser_.out_color_space = toRGB_ ? JCS_RGB : JCS_YCbCr;
+  decompresser_.raw_data_out = false;
+  jpeg_start_decompress( &decompresser_ );
 
-  if ( decompresser_.num_components != 3 ) {
+  if ( decompresser_.output_components != 3 ) {
     throw runtime_error( "not 3 components" );
   }
 
-  YUV_.emplace( 3 * width(), height() );
-  for ( unsigned int i = 0; i < height(); i++ ) {
-    YUV_rows.emplace_back( &YUV_->at( 0, i ) );
+  scanline_.resize( 3 * decompresser_.output_width );
+  JSAMPROW scanline = scanline_.data();
+
+  while ( decompresser_.output_scanline < decompresser_.output_height ) {
+    const unsigned int row = decompresser_.output_scanline;
+    jpeg_read_scanlines( &decompresser_, &scanline, 1 );
+
+    for ( unsigned int column = 0; column < width(); column++ ) {
+      r.Y().at( column, row ) = scanline_[column * 3];
+      if ( toRGB_ ) {
+        r.U().at( column, row ) = scanline_[column * 3 + 1];
+        r.V().at( column, row ) = scanline_[column * 3 + 2];
+      } else if ( row % 2 == 0 and column % 2 == 0
+                  and column / 2 < r.U().width()
+                  and row / 2 < r.U().height() ) {
+        r.U().at( column / 2, row / 2 ) = scanline_[column * 3 + 1];
+        r.V().at( column / 2, row / 2 ) = scanline_[column * 3 + 2];
+      }
+    }
   }
 
+  jpeg_finish_decompress( &decompresser_ );
+}
+
+RGBRaster JPEGDecompresser::load_image( const string& image_name )
+{
+  const File file { image_name };
+  return load_image( file.chunk() );
+}
+
+RGBRaster JPEGDecompresser::load_image( const Chunk& image_data )
+{
+  begin_reading( image_data );
   set_output_rgb();
+  prepare_output();
+
   const uint16_t image_width = static_cast<uint16_t>( width() );
   const uint16_t image_height = static_cast<uint16_t>( height() );
   RGBRaster image { image_width, image_height, image_width, image_height };
@@ -32,9 +32,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <jpeglib.h>
-#include <optional>
+#include <vector>
 
-#include "util/2d.hh"
 #include "util/chunk.hh"
 #include "util/raster.hh"
 
@@ -45,10 +44,22 @@ class JPEGDecompresser
 
   static void error( const j_common_ptr cinfo );
 
-  std::optional<TwoD<uint8_t>> YUV_ {};
-  std::vector<uint8_t*> YUV_rows {};
   bool toRGB_ { false };
-  uint8_t image_ratio_ { 2 };
+  unsigned int scale_denom_ { 1 };
+
+  // For raw (planar) decoding: rows of an iMCU row that can't be written
+  // straight into the raster, and the chroma planes for RGB output
+  std::vector<uint8_t> raw_scratch_ {};
+  std::vector<uint8_t> chroma_ {};
+
+  // For scanline decoding of everything else
+  std::vector<uint8_t> scanline_ {};
+
+  void begin_reading( const Chunk& chunk );
+  void prepare_output();
+  bool raw_output_supported() const;
+  void decode_raw( BaseRaster& r );
+  void decode_scanlines( BaseRaster& r );
 
 public:
   JPEGDecompresser();
@@ -58,14 +69,22 @@ public:
 
   void decode( BaseRaster& r );
 
+  // Decodes a whole still image (at the current scale) to RGB
   RGBRaster load_image( const std::string& image_name );
+  RGBRaster load_image( const Chunk& image_data );
+
+  void set_output_rgb() { toRGB_ = true; }
+
+  // Scales the IDCT output by 1/denominator (1, 2, 4 or 8); takes effect at
+  // the next begin_decoding()
+  void set_scale( const unsigned int denominator );
+  static bool valid_scale( const unsigned int denominator );
 
-  void set_output_rgb()
-  {
-    toRGB_ = true;
-    image_ratio_ = 2 - toRGB_;
-  }
+  // Size of a dimension of `size` pixels when decoded at 1/denominator
+  static unsigned int scaled_size( const unsigned int size,
+                                   const unsigned int denominator );
 
+  // Output dimensions, after scaling
   unsigned int width() const;
   unsigned int height() const;
 };
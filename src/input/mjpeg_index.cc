@@ -0,0 +1,147 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "mjpeg_index.hh"
+
+#include <cstring>
+
+using namespace std;
+
+static constexpr uint8_t MARKER_PREFIX = 0xff;
+static constexpr uint8_t TEM = 0x01;
+static constexpr uint8_t RST0 = 0xd0;
+static constexpr uint8_t RST7 = 0xd7;
+static constexpr uint8_t SOI = 0xd8;
+static constexpr uint8_t EOI = 0xd9;
+static constexpr uint8_t SOS = 0xda;
+
+static const string SIDECAR_MAGIC = "MJPGIDX1";
+
+uint64_t MJPEGIndex::jpeg_length( const Chunk& data )
+{
+  const uint8_t* buffer = data.buffer();
+  const uint64_t size = data.size();
+
+  if ( size < 2 or buffer[0] != MARKER_PREFIX or buffer[1] != SOI ) {
+    return 0;
+  }
+
+  uint64_t pos = 2;
+
+  while ( true ) {
+    /* a marker, possibly preceded by fill bytes */
+    if ( pos >= size or buffer[pos] != MARKER_PREFIX ) {
+      return 0;
+    }
+
+    while ( pos < size and buffer[pos] == MARKER_PREFIX ) {
+      pos++;
+    }
+
+    if ( pos >= size ) {
+      return 0;
+    }
+
+    const uint8_t marker = buffer[pos++];
+
+    if ( marker == EOI ) {
+      return pos;
+    }
+
+    if ( marker == 0x00 or marker == SOI ) {
+      return 0;
+    }
+
+    if ( marker == TEM or ( marker >= RST0 and marker <= RST7 ) ) {
+      continue;
+    }
+
+    /* marker segment: the length includes its own two bytes */
+    if ( pos + 2 > size ) {
+      return 0;
+    }
+
+    const uint64_t segment_length = ( buffer[pos] << 8 ) | buffer[pos + 1];
+    if ( segment_length < 2 ) {
+      return 0;
+    }
+
+    pos += segment_length;
+
+    if ( marker != SOS ) {
+      continue;
+    }
+
+    /* entropy-coded data runs until the next 0xFF that starts a marker */
+    while ( true ) {
+      if ( pos >= size ) {
+        return 0;
+      }
+
+      const void* next_ff = memchr( buffer + pos, MARKER_PREFIX, size - pos );
+      if ( not next_ff ) {
+        return 0;
+      }
+
+      pos = static_cast<const uint8_t*>( next_ff ) - buffer;
+      if ( pos + 1 >= size ) {
+        return 0;
+      }
+
+      const uint8_t next = buffer[pos + 1];
+      if ( next == 0x00 or ( next >= RST0 and next <= RST7 ) ) {
+        pos += 2;
+      } else if ( next == MARKER_PREFIX ) {
+        pos++;
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+vector<MJPEGIndex::Entry> MJPEGIndex::scan( const Chunk& contents )
+{
+  vector<Entry> entries;
+
+  const uint8_t* buffer = contents.buffer();
+  const uint64_t size = contents.size();
+  uint64_t pos = 0;
+
+  while ( pos + 1 < size ) {
+    /* find the next SOI */
+    const void* next_ff = memchr( buffer + pos, MARKER_PREFIX, size - pos - 1 );
+    if ( not next_ff ) {
+      break;
+    }
+
+    const uint64_t start = static_cast<const uint8_t*>( next_ff ) - buffer;
+    if ( buffer[start + 1] != SOI ) {
+      pos = start + 1;
+      continue;
+    }
+
+    const uint64_t length = jpeg_length( contents( start ) );
+    if ( length == 0 ) {
+      /* truncated or malformed; resynchronize after its SOI */
+      pos = start + 2;
+      continue;
+    }
+
+    entries.push_back( { start, length } );
+    pos = start + length;
+  }
+
+  return entries;
+}
+
+MJPEGIndex::MJPEGIndex( const string& filename, const Chunk& contents )
+{
+  auto cached_entries = index_sidecar::load( filename, SIDECAR_MAGIC );
+  if ( cached_entries.has_value() ) {
+    entries_ = move( *cached_entries );
+    return;
+  }
+
+  entries_ = scan( contents );
+  index_sidecar::save( filename, SIDECAR_MAGIC, entries_ );
+}
@@ -0,0 +1,47 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef MJPEG_INDEX_HH
+#define MJPEG_INDEX_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "util/chunk.hh"
+#include "util/index_sidecar.hh"
+
+/* Byte ranges of the JPEG frames in a concatenated MJPEG file.
+
+   Frames are found by walking each JPEG's marker segments (so that 0xFF
+   bytes inside headers or embedded thumbnails are never mistaken for
+   markers) and using memchr to skip through the entropy-coded data, where
+   0xFF is followed by a stuffed 0x00, a restart marker or a fill byte. A
+   frame that is truncated or malformed is skipped.
+
+   The index is cached in a sidecar file (see index_sidecar), so reopening
+   a recording does not rescan it. */
+
+class MJPEGIndex
+{
+public:
+  using Entry = index_sidecar::Entry;
+
+private:
+  std::vector<Entry> entries_ {};
+
+public:
+  MJPEGIndex( const std::string& filename, const Chunk& contents );
+
+  static std::vector<Entry> scan( const Chunk& contents );
+
+  // Length of the JPEG at the start of `data`, or 0 if it is incomplete
+  static uint64_t jpeg_length( const Chunk& data );
+
+  size_t size() const { return entries_.size(); }
+  const Entry& at( const size_t frame_no ) const
+  {
+    return entries_.at( frame_no );
+  }
+};
+
+#endif /* MJPEG_INDEX_HH */
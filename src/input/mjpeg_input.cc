@@ -2,50 +2,162 @@
 
 using namespace std;
 
-size_t find_jpeg_eof( const Chunk& chunk )
+MJPEGInput::MJPEGInput( const string& filename,
+                        const uint16_t width,
+                        const uint16_t height,
+                        const unsigned int scale_denominator,
+                        const unsigned int decode_threads,
+                        const size_t lookahead )
+  : input_file_( filename )
+  , index_( filename, input_file_.chunk() )
+  , width_( width )
+  , height_( height )
+  , scale_( scale_denominator )
+  , lookahead_( lookahead )
 {
-  const uint16_t* buffer = reinterpret_cast<const uint16_t*>( chunk.buffer() );
-  const size_t size = chunk.size() / 2;
+  if ( not JPEGDecompresser::valid_scale( scale_ ) ) {
+    throw runtime_error( "JPEG scale must be 1/1, 1/2, 1/4 or 1/8" );
+  }
+
+  if ( decode_threads == 0 or lookahead == 0 ) {
+    throw runtime_error( "MJPEGInput needs at least one decode thread and "
+                         "one frame of lookahead" );
+  }
 
-  for ( size_t i = 0; i < size; i++ ) {
-    if ( buffer[i] == 0xd9ff ) {
-      return i * 2;
+  try {
+    for ( unsigned int i = 0; i < decode_threads; i++ ) {
+      workers_.emplace_back( &MJPEGInput::decode_loop, this );
     }
+  } catch ( ... ) {
+    /* the destructor will not run, so stop the workers already started */
+    stop_workers();
+    throw;
   }
+}
 
-  return SIZE_MAX;
+MJPEGInput::~MJPEGInput()
+{
+  stop_workers();
 }
 
-optional<RGBRasterHandle> MJPEGInput::get_next_rgb_frame()
+void MJPEGInput::stop_workers()
 {
-  auto chunk = input_file_.chunk();
-  if ( current_offset >= chunk.size() ) {
-    return {};
+  {
+    lock_guard<mutex> lock( lock_ );
+    terminate_ = true;
+  } // End of lock scope
+  cv_work_.notify_all();
+
+  for ( auto& worker : workers_ ) {
+    worker.join();
   }
+}
 
-  size_t frame_length = find_jpeg_eof( chunk( current_offset ) );
-  if ( frame_length == SIZE_MAX ) {
-    return {};
+void MJPEGInput::decode_loop()
+{
+  optional<JPEGDecompresser> jpegdec;
+
+  while ( true ) {
+    uint64_t frame_no;
+    uint64_t generation;
+
+    {
+      unique_lock<mutex> lock( lock_ );
+      cv_work_.wait( lock, [&] {
+        return terminate_
+               or ( next_claimed_ < index_.size()
+                    and next_claimed_ < next_returned_ + lookahead_ );
+      } );
+
+      if ( terminate_ ) {
+        return;
+      }
+
+      frame_no = next_claimed_++;
+      generation = generation_;
+    } // End of lock scope
+
+    try {
+      RGBRasterHandle raster_handle { display_width(), display_height() };
+
+      /* ignore first frame as can contain invalid JPEG data */
+      if ( frame_no > 0 ) {
+        if ( not jpegdec.has_value() ) {
+          jpegdec.emplace();
+          jpegdec->set_output_rgb();
+          jpegdec->set_scale( scale_ );
+        }
+        const auto& frame = index_.at( frame_no );
+        jpegdec->begin_decoding( input_file_( frame.offset, frame.length ) );
+        if ( jpegdec->width() != display_width()
+             or jpegdec->height() != display_height() ) {
+          throw runtime_error( "size mismatch" );
+        }
+        jpegdec->decode( raster_handle );
+      }
+
+      {
+        lock_guard<mutex> lock( lock_ );
+        if ( generation == generation_ ) {
+          reorder_buffer_.emplace( frame_no, move( raster_handle ) );
+        }
+      } // End of lock scope
+    } catch ( ... ) {
+      /* start the next frame with a fresh decompresser */
+      jpegdec.reset();
+
+      {
+        lock_guard<mutex> lock( lock_ );
+        if ( generation == generation_
+             and ( not decode_error_ or frame_no < error_frame_ ) ) {
+          decode_error_ = current_exception();
+          error_frame_ = frame_no;
+        }
+      } // End of lock scope
+    }
+    cv_frame_.notify_all();
   }
+}
 
-  frame_length += 2;
+optional<RGBRasterHandle> MJPEGInput::get_next_rgb_frame()
+{
+  unique_lock<mutex> lock( lock_ );
+  const auto failed = [&] {
+    return decode_error_ and next_returned_ == error_frame_;
+  };
+  cv_frame_.wait( lock, [&] {
+    return reorder_buffer_.count( next_returned_ ) or failed()
+           or next_returned_ >= index_.size();
+  } );
 
-  RGBRasterHandle raster_handle { width_, height_ };
-  auto& raster = raster_handle.get();
+  /* frames before the one that failed are still returned, in order */
+  auto frame = reorder_buffer_.find( next_returned_ );
 
-  if ( jpegdec_.has_value() ) {
-    jpegdec_->set_output_rgb();
-    jpegdec_->begin_decoding( input_file_( current_offset, frame_length ) );
-    if ( jpegdec_->width() != width_ or jpegdec_->height() != height_ ) {
-      throw runtime_error( "size mismatch" );
+  if ( frame == reorder_buffer_.end() ) {
+    if ( failed() ) {
+      rethrow_exception( decode_error_ );
     }
-    jpegdec_->decode( raster );
-  } else {
-    jpegdec_.emplace();
-    /* ignore first frame as can contain invalid JPEG data */
+    return {};
   }
 
-  current_offset += frame_length;
+  RGBRasterHandle ret { move( frame->second ) };
+  reorder_buffer_.erase( frame );
+  next_returned_++;
+
+  lock.unlock();
+  cv_work_.notify_all();
 
-  return RGBRasterHandle { move( raster_handle ) };
+  return RGBRasterHandle { move( ret ) };
+}
+
+void MJPEGInput::seek( const uint64_t frame_no )
+{
+  {
+    lock_guard<mutex> lock( lock_ );
+    reorder_buffer_.clear();
+    decode_error_ = nullptr;
+    next_claimed_ = next_returned_ = frame_no;
+    generation_++;
+  } // End of lock scope
+  cv_work_.notify_all();
 }
@@ -1,29 +1,80 @@
 #include "frame_input.hh"
 
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "jpeg.hh"
+#include "mjpeg_index.hh"
 #include "util/file.hh"
 
+/* Frames are decoded ahead of the consumer by a set of worker threads, each
+   with its own JPEGDecompresser. Workers claim frames in file order, decode
+   them in parallel, and park the results in a reorder buffer from which
+   get_next_rgb_frame() hands them out in order. At most `lookahead` frames
+   are claimed beyond the next one to be returned, which caps the number of
+   decoded rasters in flight. If a frame fails to decode, its error is
+   rethrown when that frame is next in line, after every frame before it
+   has been returned; seek() clears it.
+
+   The file is indexed up front (see MJPEGIndex), which makes seek() cheap:
+   it discards whatever was decoded ahead and restarts the workers at the
+   requested frame. */
+
 class MJPEGInput : public FrameInput
 {
 private:
   File input_file_;
+  MJPEGIndex index_;
   const uint16_t width_;
   const uint16_t height_;
+  const unsigned int scale_;
+  const size_t lookahead_;
+
+  std::mutex lock_ {};
+  std::condition_variable cv_work_ {};
+  std::condition_variable cv_frame_ {};
+
+  // Next frame to be claimed by a worker
+  uint64_t next_claimed_ { 0 };
+
+  // Next frame to be returned to the consumer
+  uint64_t next_returned_ { 0 };
+
+  // Bumped by seek() so that frames decoded before it are thrown away
+  uint64_t generation_ { 0 };
+
+  std::map<uint64_t, RGBRasterHandle> reorder_buffer_ {};
+
+  // The first frame that failed to decode (since the last seek), which is
+  // rethrown once every frame before it has been returned
+  std::exception_ptr decode_error_ {};
+  uint64_t error_frame_ { 0 };
+  bool terminate_ { false };
+
+  std::vector<std::thread> workers_ {};
 
-  size_t current_offset { 0 };
-  std::optional<JPEGDecompresser> jpegdec_ {};
+  void decode_loop();
+  void stop_workers();
 
 public:
   MJPEGInput( const std::string& filename,
               const uint16_t width,
-              const uint16_t height )
-    : input_file_( filename )
-    , width_( width )
-    , height_( height )
-  {}
+              const uint16_t height,
+              const unsigned int scale_denominator = 1,
+              const unsigned int decode_threads = 2,
+              const size_t lookahead = 8 );
+
+  ~MJPEGInput();
+
+  /* forbid copying */
+  MJPEGInput( const MJPEGInput& other ) = delete;
+  MJPEGInput& operator=( const MJPEGInput& other ) = delete;
 
   std::optional<RasterHandle> get_next_frame() override
   {
@@ -31,7 +82,18 @@ public:
   }
 
   std::optional<RGBRasterHandle> get_next_rgb_frame() override;
-  uint16_t display_width() { return width_; }
-  uint16_t display_height() { return height_; }
-  ~MJPEGInput() {}
+
+  // Makes frame_no the next frame returned by get_next_rgb_frame()
+  void seek( const uint64_t frame_no );
+  uint64_t frame_count() const { return index_.size(); }
+
+  // Size of the frames returned, after decoding at 1/scale_denominator
+  uint16_t display_width()
+  {
+    return JPEGDecompresser::scaled_size( width_, scale_ );
+  }
+  uint16_t display_height()
+  {
+    return JPEGDecompresser::scaled_size( height_, scale_ );
+  }
 };
@@ -0,0 +1,55 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "replay_input.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+ReplayInput::ReplayInput( const ReplayBuffer& buffer )
+  : buffer_( buffer )
+  , next_frame_( buffer.next_frame() )
+{}
+
+optional<RGBRasterHandle> ReplayInput::get_next_rgb_frame()
+{
+  RGBRasterHandle raster_handle { display_width(), display_height() };
+
+  while ( true ) {
+    if ( next_frame_ >= buffer_.next_frame() ) {
+      return {};
+    }
+
+    next_frame_ = max( next_frame_, buffer_.oldest_frame() );
+
+    if ( buffer_.read( next_frame_, raster_handle, last_timestamp_ns_ ) ) {
+      next_frame_++;
+      return { move( raster_handle ) };
+    }
+
+    /* overwritten while we were reading it; try the new oldest frame */
+  }
+}
+
+void ReplayInput::seek_to_timestamp( const uint64_t timestamp_ns )
+{
+  seek( buffer_.frame_at( timestamp_ns ) );
+}
+
+void ReplayInput::seek_back( const double seconds )
+{
+  const uint64_t next = buffer_.next_frame();
+  if ( next == 0 ) {
+    return;
+  }
+
+  const optional<uint64_t> latest_timestamp_ns = buffer_.timestamp( next - 1 );
+  if ( not latest_timestamp_ns.has_value() ) {
+    return;
+  }
+
+  const uint64_t offset_ns = seconds * 1e9;
+  seek_to_timestamp( *latest_timestamp_ns > offset_ns
+                       ? *latest_timestamp_ns - offset_ns
+                       : 0 );
+}
@@ -0,0 +1,47 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef REPLAY_INPUT_HH
+#define REPLAY_INPUT_HH
+
+#include <optional>
+
+#include "frame_input.hh"
+#include "util/replay_buffer.hh"
+
+/* Plays back frames held in a ReplayBuffer, starting from any frame or
+   timestamp still in it. Playback that falls behind the writer (so that the
+   frame it wants has been overwritten) skips ahead to the oldest frame
+   left; once it catches up with the live source, it returns nothing until
+   another frame is recorded. */
+
+class ReplayInput : public FrameInput
+{
+private:
+  const ReplayBuffer& buffer_;
+  uint64_t next_frame_;
+  uint64_t last_timestamp_ns_ { 0 };
+
+public:
+  ReplayInput( const ReplayBuffer& buffer );
+
+  std::optional<RasterHandle> get_next_frame() override
+  {
+    throw std::runtime_error( "NOT IMPLEMENTED" );
+  }
+
+  std::optional<RGBRasterHandle> get_next_rgb_frame() override;
+
+  uint16_t display_width() override { return buffer_.width(); }
+  uint16_t display_height() override { return buffer_.height(); }
+
+  void seek( const uint64_t frame_no ) { next_frame_ = frame_no; }
+  void seek_to_timestamp( const uint64_t timestamp_ns );
+
+  // Seeks to `seconds` before the most recent frame
+  void seek_back( const double seconds );
+
+  // Timestamp of the frame most recently returned
+  uint64_t timestamp_ns() const { return last_timestamp_ns_; }
+};
+
+#endif /* REPLAY_INPUT_HH */
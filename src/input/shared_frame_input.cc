@@ -0,0 +1,37 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "shared_frame_input.hh"
+
+#include <cstring>
+
+using namespace std;
+
+SharedFrameInput::SharedFrameInput( const string& path )
+  : ring_( path )
+{}
+
+optional<RGBRasterHandle> SharedFrameInput::get_next_rgb_frame()
+{
+  optional<FrameRing::Reference> reference;
+
+  while ( not( reference = ring_.acquire_latest( last_sequence_ ) ) ) {
+    if ( ring_.closed() ) {
+      return {};
+    }
+    ring_.wait( last_sequence_, WAIT_TIMEOUT_MS );
+  }
+
+  RGBRasterHandle raster_handle { display_width(), display_height() };
+  RGBRaster& raster = raster_handle.get();
+
+  const size_t length = ring_.plane_length();
+  memcpy( &raster.R().at( 0, 0 ), ring_.plane( reference->slot, 0 ), length );
+  memcpy( &raster.G().at( 0, 0 ), ring_.plane( reference->slot, 1 ), length );
+  memcpy( &raster.B().at( 0, 0 ), ring_.plane( reference->slot, 2 ), length );
+  memcpy( &raster.A().at( 0, 0 ), ring_.plane( reference->slot, 3 ), length );
+
+  ring_.release( *reference );
+  last_sequence_ = reference->sequence;
+
+  return { move( raster_handle ) };
+}
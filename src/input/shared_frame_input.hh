@@ -0,0 +1,40 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SHARED_FRAME_INPUT_HH
+#define SHARED_FRAME_INPUT_HH
+
+#include <optional>
+#include <string>
+
+#include "frame_input.hh"
+#include "util/frame_ring.hh"
+
+/* Receives frames published by a SharedFrameSink in another process. Each
+   call returns the latest frame, skipping any that were published while
+   the consumer was busy, and waits if there is nothing new. It returns
+   nothing once the writer has gone away. */
+
+class SharedFrameInput : public FrameInput
+{
+private:
+  FrameRing ring_;
+  uint64_t last_sequence_ { 0 };
+
+  static constexpr unsigned int WAIT_TIMEOUT_MS = 100;
+
+public:
+  // path is the writer's SharedFrameSink::path()
+  SharedFrameInput( const std::string& path );
+
+  std::optional<RasterHandle> get_next_frame() override
+  {
+    throw std::runtime_error( "NOT IMPLEMENTED" );
+  }
+
+  std::optional<RGBRasterHandle> get_next_rgb_frame() override;
+
+  uint16_t display_width() override { return ring_.width(); }
+  uint16_t display_height() override { return ring_.height(); }
+};
+
+#endif /* SHARED_FRAME_INPUT_HH */
@@ -0,0 +1,253 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "synthetic_input.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "util/pixel_convert.hh"
+
+using namespace std;
+
+/* xorshift32: fast, and the same everywhere for a given seed */
+static uint32_t next_random( uint32_t& state )
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static uint8_t clamp_to_byte( const int value )
+{
+  return static_cast<uint8_t>( min( 255, max( 0, value ) ) );
+}
+
+/* the screen before noise, at (horizontal, vertical) in [0, 1]; unevenly
+   lit, brighter in the middle and darker at the edges */
+static array<int, 3> screen_color( const double horizontal,
+                                   const double vertical )
+{
+  const double falloff
+    = 1.0 - 0.25 * ( fabs( horizontal - 0.5 ) + fabs( vertical - 0.5 ) );
+
+  return { static_cast<int>( 40 + 20 * vertical ),
+           static_cast<int>( 190 * falloff ),
+           static_cast<int>( 60 + 20 * horizontal ) };
+}
+
+SyntheticInput::SyntheticInput( const Parameters& parameters )
+  : parameters_( parameters )
+{
+  if ( parameters_.width < 2 or parameters_.height < 2 ) {
+    throw runtime_error( "SyntheticInput frames must be at least 2x2" );
+  }
+
+  render_screens();
+  render_shapes();
+}
+
+void SyntheticInput::render_screens()
+{
+  const unsigned int width = parameters_.width;
+  const unsigned int height = parameters_.height;
+  uint32_t random_state = parameters_.seed | 1;
+
+  for ( unsigned int i = 0; i < SCREEN_VARIANTS; i++ ) {
+    screens_.emplace_back( width, height, width, height );
+    RGBRaster& screen = screens_.back();
+
+    for ( unsigned int row = 0; row < height; row++ ) {
+      const double vertical = static_cast<double>( row ) / ( height - 1 );
+
+      for ( unsigned int column = 0; column < width; column++ ) {
+        const array<int, 3> color
+          = screen_color( static_cast<double>( column ) / ( width - 1 ),
+                          vertical );
+
+        const int noise
+          = parameters_.noise_amplitude == 0
+              ? 0
+              : static_cast<int>( next_random( random_state )
+                                  % ( 2 * parameters_.noise_amplitude + 1 ) )
+                  - static_cast<int>( parameters_.noise_amplitude );
+
+        screen.R().at( column, row ) = clamp_to_byte( color[0] + noise );
+        screen.G().at( column, row ) = clamp_to_byte( color[1] + noise );
+        screen.B().at( column, row ) = clamp_to_byte( color[2] + noise );
+      }
+    }
+
+    screen.A().fill( 255 );
+  }
+}
+
+void SyntheticInput::render_shapes()
+{
+  static constexpr uint8_t colors[][3] = { { 200, 150, 120 },
+                                           { 40, 40, 160 },
+                                           { 180, 40, 40 },
+                                           { 230, 230, 230 },
+                                           { 30, 30, 30 } };
+  const unsigned int color_count = sizeof( colors ) / sizeof( colors[0] );
+
+  uint32_t random_state = ( parameters_.seed * 2654435761u ) | 1;
+
+  for ( unsigned int i = 0; i < parameters_.shape_count; i++ ) {
+    /* ellipses a quarter to a half of the frame height across */
+    const unsigned int base = max( 4, parameters_.height / 4 );
+    const uint16_t shape_width
+      = min<unsigned int>( parameters_.width,
+                           base + next_random( random_state ) % base );
+    const uint16_t shape_height
+      = min<unsigned int>( parameters_.height,
+                           base + next_random( random_state ) % base );
+    const uint8_t* color = colors[i % color_count];
+
+    Shape shape { shape_width,
+                  shape_height,
+                  color[0],
+                  color[1],
+                  color[2],
+                  vector<uint8_t>( size_t { shape_width } * shape_height ) };
+
+    /* soft edge: coverage ramps from 0 to 1 over a few pixels */
+    const double edge = max( 2.0, shape_height / 40.0 );
+    const double rx = shape_width / 2.0, ry = shape_height / 2.0;
+
+    for ( unsigned int row = 0; row < shape_height; row++ ) {
+      for ( unsigned int column = 0; column < shape_width; column++ ) {
+        const double dx = ( column + 0.5 - rx ) / rx;
+        const double dy = ( row + 0.5 - ry ) / ry;
+
+        /* approximate distance inside the boundary, in pixels */
+        const double inside
+          = ( 1.0 - sqrt( dx * dx + dy * dy ) ) * min( rx, ry );
+        const double coverage = min( 1.0, max( 0.0, inside / edge ) );
+
+        shape.alpha[row * shape_width + column]
+          = static_cast<uint8_t>( coverage * 255 + 0.5 );
+      }
+    }
+
+    shapes_.push_back( move( shape ) );
+  }
+}
+
+void SyntheticInput::render( RGBRaster& raster, const uint64_t frame_no ) const
+{
+  const RGBRaster& screen = screens_[frame_no % SCREEN_VARIANTS];
+  raster.R().copy_from( screen.R() );
+  raster.G().copy_from( screen.G() );
+  raster.B().copy_from( screen.B() );
+  raster.A().copy_from( screen.A() );
+
+  for ( unsigned int i = 0; i < shapes_.size(); i++ ) {
+    const Shape& shape = shapes_[i];
+
+    /* each shape follows its own Lissajous path around the frame */
+    const double t = frame_no / 60.0;
+    const double x = 0.5 + 0.5 * sin( t * ( 0.7 + 0.3 * i ) + i );
+    const double y = 0.5 + 0.5 * sin( t * ( 0.5 + 0.2 * i ) + 2 * i );
+    const unsigned int left = x * ( parameters_.width - shape.width );
+    const unsigned int top = y * ( parameters_.height - shape.height );
+
+    for ( unsigned int row = 0; row < shape.height; row++ ) {
+      const uint8_t* alpha = &shape.alpha[row * shape.width];
+      uint8_t* r = &raster.R().at( left, top + row );
+      uint8_t* g = &raster.G().at( left, top + row );
+      uint8_t* b = &raster.B().at( left, top + row );
+
+      for ( unsigned int column = 0; column < shape.width; column++ ) {
+        const unsigned int a = alpha[column];
+        r[column] = ( shape.r * a + r[column] * ( 255 - a ) + 127 ) / 255;
+        g[column] = ( shape.g * a + g[column] * ( 255 - a ) + 127 ) / 255;
+        b[column] = ( shape.b * a + b[column] * ( 255 - a ) + 127 ) / 255;
+      }
+    }
+  }
+}
+
+void SyntheticInput::pace()
+{
+  if ( parameters_.frame_rate <= 0 ) {
+    return;
+  }
+
+  const auto period
+    = chrono::duration_cast<chrono::steady_clock::duration>(
+      chrono::duration<double>( 1.0 / parameters_.frame_rate ) );
+  const auto now = chrono::steady_clock::now();
+
+  if ( next_deadline_ == chrono::steady_clock::time_point {} ) {
+    next_deadline_ = now;
+  } else if ( next_deadline_ + period < now ) {
+    /* running behind; don't try to catch up in a burst */
+    next_deadline_ = now;
+  } else {
+    next_deadline_ += period;
+  }
+
+  this_thread::sleep_until( next_deadline_ );
+}
+
+optional<RGBRasterHandle> SyntheticInput::get_next_rgb_frame()
+{
+  if ( parameters_.frame_count and frame_no_ >= parameters_.frame_count ) {
+    return {};
+  }
+
+  pace();
+
+  RGBRasterHandle raster_handle { display_width(), display_height() };
+  render( raster_handle.get(), frame_no_++ );
+
+  return { move( raster_handle ) };
+}
+
+optional<RasterHandle> SyntheticInput::get_next_frame()
+{
+  optional<RGBRasterHandle> rgb = get_next_rgb_frame();
+  if ( not rgb.has_value() ) {
+    return {};
+  }
+
+  const unsigned int width = display_width();
+  const unsigned int height = display_height();
+  const unsigned int chroma_width = ( width + 1 ) / 2;
+  const unsigned int chroma_height = ( height + 1 ) / 2;
+
+  yuv_.resize( width * height + 2 * chroma_width * chroma_height );
+  uint8_t* const y = yuv_.data();
+  uint8_t* const u = y + width * height;
+  uint8_t* const v = u + chroma_width * chroma_height;
+  pixel_convert::rgb_to_yuv420( rgb->get(), y, u, v );
+
+  RasterHandle raster_handle { display_width(), display_height() };
+  BaseRaster& raster = raster_handle.get();
+
+  for ( unsigned int row = 0; row < height; row++ ) {
+    memcpy( &raster.Y().at( 0, row ), y + row * width, width );
+  }
+
+  const unsigned int copy_width
+    = min<unsigned int>( raster.U().width(), chroma_width );
+  const unsigned int copy_height
+    = min<unsigned int>( raster.U().height(), chroma_height );
+
+  for ( unsigned int row = 0; row < copy_height; row++ ) {
+    memcpy( &raster.U().at( 0, row ), u + row * chroma_width, copy_width );
+    memcpy( &raster.V().at( 0, row ), v + row * chroma_width, copy_width );
+  }
+
+  return { move( raster_handle ) };
+}
+
+vector<double> SyntheticInput::key_color() const
+{
+  const array<int, 3> color = screen_color( 0.5, 0.5 );
+  return { color[0] / 255.0, color[1] / 255.0, color[2] / 255.0 };
+}
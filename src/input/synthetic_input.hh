@@ -0,0 +1,83 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef SYNTHETIC_INPUT_HH
+#define SYNTHETIC_INPUT_HH
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "frame_input.hh"
+
+/* Generates green-screen test frames, for load-testing the keyer and the
+   compositor without a camera or any I/O.
+
+   Everything is rendered up front: a few copies of the screen (a gradient
+   with different noise in each) and a set of soft-edged foreground shapes,
+   each with a coverage mask. A frame is one of the screens with the shapes
+   blended over it at positions that depend only on the frame number, so
+   the same parameters always produce the same sequence.
+
+   With a nonzero frame rate, frames are paced to it; otherwise they are
+   produced as fast as they can be. */
+
+class SyntheticInput : public FrameInput
+{
+public:
+  struct Parameters
+  {
+    uint16_t width { 1280 };
+    uint16_t height { 720 };
+    double frame_rate { 0 };      // 0: unpaced
+    uint64_t frame_count { 0 };   // 0: endless
+    unsigned int shape_count { 4 };
+    unsigned int noise_amplitude { 6 };
+    uint32_t seed { 1 };
+  };
+
+private:
+  struct Shape
+  {
+    uint16_t width, height;
+    uint8_t r, g, b;
+
+    // coverage, 0 to 255
+    std::vector<uint8_t> alpha;
+  };
+
+  static constexpr unsigned int SCREEN_VARIANTS = 4;
+
+  const Parameters parameters_;
+
+  std::vector<RGBRaster> screens_ {};
+  std::vector<Shape> shapes_ {};
+
+  uint64_t frame_no_ { 0 };
+
+  std::chrono::steady_clock::time_point next_deadline_ {};
+
+  // Used by get_next_frame()
+  std::vector<uint8_t> yuv_ {};
+
+  void render_screens();
+  void render_shapes();
+  void render( RGBRaster& raster, const uint64_t frame_no ) const;
+  void pace();
+
+public:
+  SyntheticInput( const Parameters& parameters );
+
+  std::optional<RasterHandle> get_next_frame() override;
+  std::optional<RGBRasterHandle> get_next_rgb_frame() override;
+
+  uint16_t display_width() override { return parameters_.width; }
+  uint16_t display_height() override { return parameters_.height; }
+
+  void seek( const uint64_t frame_no ) { frame_no_ = frame_no; }
+
+  // The colour of the screen (without noise) at the centre of the frame
+  std::vector<double> key_color() const;
+};
+
+#endif /* SYNTHETIC_INPUT_HH */
@@ -29,10 +29,14 @@
 #include "yuv4mpeg.hh"
 
 #include <algorithm>
+#include <cstring>
 #include <fcntl.h>
 #include <sstream>
+#include <sys/mman.h>
 #include <utility>
 
+#include "util/pixel_convert.hh"
+
 using namespace std;
 
 YUV4MPEGHeader::YUV4MPEGHeader()
@@ -57,40 +61,49 @@ YUV4MPEGHeader::YUV4MPEGHeader( const BaseRaster& rh )
   , color_space( C420 )
 {}
 
-size_t YUV4MPEGHeader::frame_length()
+uint16_t YUV4MPEGHeader::chroma_width() const
 {
   switch ( color_space ) {
     case C420:
     case C420jpeg:
     case C420paldv:
-      return ( width * height * 3 ) / 2;
+    case C422:
+      return ( width + 1 ) / 2;
+    case C444:
+      return width;
     default:
       throw LogicError();
   }
 }
 
-size_t YUV4MPEGHeader::y_plane_length()
+uint16_t YUV4MPEGHeader::chroma_height() const
 {
   switch ( color_space ) {
     case C420:
     case C420jpeg:
     case C420paldv:
-      return ( width * height );
+      return ( height + 1 ) / 2;
+    case C422:
+    case C444:
+      return height;
     default:
       throw LogicError();
   }
 }
 
-size_t YUV4MPEGHeader::uv_plane_length()
+size_t YUV4MPEGHeader::frame_length() const
 {
-  switch ( color_space ) {
-    case C420:
-    case C420jpeg:
-    case C420paldv:
-      return ( width * height / 4 );
-    default:
-      throw LogicError();
-  }
+  return y_plane_length() + 2 * uv_plane_length();
+}
+
+size_t YUV4MPEGHeader::y_plane_length() const
+{
+  return width * height;
+}
+
+size_t YUV4MPEGHeader::uv_plane_length() const
+{
+  return chroma_width() * chroma_height();
 }
 
 string YUV4MPEGHeader::to_string()
@@ -165,9 +178,22 @@ YUV4MPEGReader::YUV4MPEGReader( const string& filename )
 
 YUV4MPEGReader::YUV4MPEGReader( FileDescriptor&& fd )
   : header_()
-  , fd_( move( fd ) )
+  , file_( move( fd ) )
+{
+  const Chunk contents = file_.chunk();
+  const void* newline = memchr( contents.buffer(), '\n', contents.size() );
+  if ( not newline ) {
+    throw runtime_error( "invalid yuv4mpeg2 header" );
+  }
+
+  offset_ = static_cast<const uint8_t*>( newline ) - contents.buffer() + 1;
+  parse_header( contents( 0, offset_ - 1 ).to_string() );
+
+  file_.advise( 0, file_.size(), MADV_SEQUENTIAL );
+}
+
+void YUV4MPEGReader::parse_header( const string& header_str )
 {
-  string header_str = fd_.getline();
   istringstream ssin( header_str );
 
   string token;
@@ -237,10 +263,19 @@ YUV4MPEGReader::YUV4MPEGReader( FileDescriptor&& fd )
       }
 
       case 'C': // color space
-        if ( token.substr( 0, 4 ) != "C420" ) {
-          throw runtime_error( "only yuv420 color space is supported" );
+        if ( token == "C420jpeg" ) {
+          header_.color_space = YUV4MPEGHeader::ColorSpace::C420jpeg;
+        } else if ( token == "C420paldv" ) {
+          header_.color_space = YUV4MPEGHeader::ColorSpace::C420paldv;
+        } else if ( token == "C420" or token == "C420mpeg2" ) {
+          header_.color_space = YUV4MPEGHeader::ColorSpace::C420;
+        } else if ( token == "C422" ) {
+          header_.color_space = YUV4MPEGHeader::ColorSpace::C422;
+        } else if ( token == "C444" ) {
+          header_.color_space = YUV4MPEGHeader::ColorSpace::C444;
+        } else {
+          throw runtime_error( "unsupported color space: " + token );
         }
-        header_.color_space = YUV4MPEGHeader::ColorSpace::C420;
         break;
 
       case 'X': // comment
@@ -304,46 +339,124 @@ void edge_extend( BaseRaster& raster )
     raster.V(), raster.chroma_display_width(), raster.chroma_display_height() );
 }
 
-optional<RasterHandle> YUV4MPEGReader::get_next_frame()
+optional<Chunk> YUV4MPEGReader::next_frame_data()
 {
-  RasterHandle raster { header_.width, header_.height };
+  if ( offset_ >= file_.size() ) {
+    return {};
+  }
 
-  string frame_header = fd_.getline();
-  if ( fd_.eof() ) {
+  const Chunk rest = file_.chunk()( offset_ );
+  const void* newline = memchr( rest.buffer(), '\n', rest.size() );
+  if ( not newline ) {
     return {};
   }
 
-  if ( frame_header != "FRAME" ) {
+  const size_t frame_header_length
+    = static_cast<const uint8_t*>( newline ) - rest.buffer() + 1;
+
+  if ( rest( 0, min<size_t>( 5, rest.size() ) ).to_string() != "FRAME" ) {
     throw runtime_error( "invalid yuv4mpeg2 input format" );
   }
 
-  string read_data;
+  if ( rest.size() < frame_header_length + frame_length() ) {
+    throw runtime_error( "yuv4mpeg2 input ends in the middle of a frame" );
+  }
 
-  for ( size_t row = 0; row < display_height(); row++ ) {
-    read_data = fd_.read_exactly( display_width() );
-    memcpy( &raster.get().Y().storage()->at( 0, row ),
-            &read_data[0],
-            read_data.length() );
+  offset_ += frame_header_length + frame_length();
+  file_.advise( offset_,
+                READAHEAD_FRAMES * ( frame_header_length + frame_length() ),
+                MADV_WILLNEED );
+
+  return rest( frame_header_length, frame_length() );
+}
+
+optional<RasterHandle> YUV4MPEGReader::get_next_frame()
+{
+  const optional<Chunk> frame = next_frame_data();
+  if ( not frame.has_value() ) {
+    return {};
   }
 
-  for ( size_t row = 0; row < display_height() / 2; row++ ) {
-    read_data = fd_.read_exactly( display_width() / 2 );
-    memcpy( &raster.get().U().storage()->at( 0, row ),
-            &read_data[0],
-            read_data.length() );
+  RasterHandle raster_handle { header_.width, header_.height };
+  BaseRaster& raster = raster_handle.get();
+
+  const uint8_t* const y = frame->buffer();
+  const uint8_t* const u = y + y_plane_length();
+  const uint8_t* const v = u + uv_plane_length();
+
+  for ( size_t row = 0; row < display_height(); row++ ) {
+    memcpy( &raster.Y().at( 0, row ),
+            y + row * display_width(),
+            display_width() );
   }
 
-  for ( size_t row = 0; row < display_height() / 2; row++ ) {
-    read_data = fd_.read_exactly( display_width() / 2 );
-    memcpy( &raster.get().V().storage()->at( 0, row ),
-            &read_data[0],
-            read_data.length() );
+  /* the raster is 4:2:0, so 4:2:2 and 4:4:4 chroma is decimated */
+  const unsigned int row_step
+    = header_.chroma_height() == header_.height ? 2 : 1;
+  const unsigned int column_step
+    = header_.chroma_width() == header_.width ? 2 : 1;
+  const unsigned int chroma_width
+    = min<unsigned int>( raster.U().width(), raster.chroma_display_width() );
+  const unsigned int chroma_height
+    = min<unsigned int>( raster.U().height(), raster.chroma_display_height() );
+
+  for ( unsigned int row = 0; row < chroma_height; row++ ) {
+    const size_t source_offset = row * row_step * header_.chroma_width();
+
+    if ( column_step == 1 ) {
+      memcpy( &raster.U().at( 0, row ), u + source_offset, chroma_width );
+      memcpy( &raster.V().at( 0, row ), v + source_offset, chroma_width );
+    } else {
+      for ( unsigned int column = 0; column < chroma_width; column++ ) {
+        raster.U().at( column, row ) = u[source_offset + column * 2];
+        raster.V().at( column, row ) = v[source_offset + column * 2];
+      }
+    }
   }
 
   /* edge-extend the raster */
-  edge_extend( raster.get() );
+  edge_extend( raster );
+
+  return { move( raster_handle ) };
+}
+
+optional<RGBRasterHandle> YUV4MPEGReader::get_next_rgb_frame()
+{
+  const optional<Chunk> frame = next_frame_data();
+  if ( not frame.has_value() ) {
+    return {};
+  }
+
+  RGBRasterHandle raster_handle { header_.width, header_.height };
+  RGBRaster& raster = raster_handle.get();
+
+  const uint8_t* const y = frame->buffer();
+  const uint8_t* const u = y + y_plane_length();
+  const uint8_t* const v = u + uv_plane_length();
+
+  if ( header_.color_space == YUV4MPEGHeader::ColorSpace::C444 ) {
+    for ( unsigned int row = 0; row < display_height(); row++ ) {
+      const size_t offset = row * display_width();
+      pixel_convert::yuv444_row_to_rgb( y + offset,
+                                        u + offset,
+                                        v + offset,
+                                        &raster.R().at( 0, row ),
+                                        &raster.G().at( 0, row ),
+                                        &raster.B().at( 0, row ),
+                                        display_width() );
+    }
+  } else {
+    pixel_convert::planar_to_rgb(
+      y,
+      display_width(),
+      u,
+      v,
+      header_.chroma_width(),
+      header_.color_space != YUV4MPEGHeader::ColorSpace::C422,
+      raster );
+  }
 
-  return { move( raster ) };
+  return { move( raster_handle ) };
 }
 
 void YUV4MPEGFrameWriter::write( const BaseRaster& rh, FileDescriptor& fd )
@@ -29,10 +29,12 @@
 #ifndef YUV4MPEG_HH
 #define YUV4MPEG_HH
 
+#include <optional>
 #include <string>
 
 #include "frame_input.hh"
 #include "util/exception.hh"
+#include "util/file.hh"
 #include "util/file_descriptor.hh"
 
 class YUV4MPEGHeader
@@ -67,26 +69,45 @@ public:
   InterlacingMode interlacing_mode;
   ColorSpace color_space;
 
-  size_t frame_length();
-  size_t y_plane_length();
-  size_t uv_plane_length();
+  uint16_t chroma_width() const;
+  uint16_t chroma_height() const;
+
+  size_t frame_length() const;
+  size_t y_plane_length() const;
+  size_t uv_plane_length() const;
 
   std::string to_string();
 };
 
+/* Reads a Y4M file through a read-only mapping. The kernel is told that
+   access is sequential, and each frame returned costs one madvise() call
+   (MADV_WILLNEED on the next few frames), so the pages are usually in
+   memory before they are read rather than faulted in one at a time. */
+
 class YUV4MPEGReader : public FrameInput
 {
 private:
   YUV4MPEGHeader header_;
-  FileDescriptor fd_;
+  File file_;
+
+  // Offset of the next frame header
+  size_t offset_ { 0 };
+
+  static constexpr unsigned int READAHEAD_FRAMES = 4;
 
   static std::pair<size_t, size_t> parse_fraction(
     const std::string& fraction_str );
 
+  void parse_header( const std::string& header_str );
+
+  // The Y, U and V planes of the next frame, or nothing at the end
+  std::optional<Chunk> next_frame_data();
+
 public:
   YUV4MPEGReader( FileDescriptor&& fd );
   YUV4MPEGReader( const std::string& filename );
   std::optional<RasterHandle> get_next_frame() override;
+  std::optional<RGBRasterHandle> get_next_rgb_frame() override;
 
   uint16_t display_width() override { return header_.width; }
   uint16_t display_height() override { return header_.height; }
@@ -96,8 +117,6 @@ public:
   size_t uv_plane_length() { return header_.uv_plane_length(); }
 
   YUV4MPEGHeader header() const { return header_; }
-
-  FileDescriptor& fd() { return fd_; }
 };
 
 class YUV4MPEGFrameWriter
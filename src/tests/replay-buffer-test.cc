@@ -0,0 +1,121 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Checks which frames a ReplayBuffer offers for replay around the point
+   where it first wraps: after exactly slot_count frames, and after one
+   more. Exits nonzero if any check fails. */
+
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "util/replay_buffer.hh"
+
+using namespace std;
+
+namespace {
+
+unsigned int failures = 0;
+
+void check( const bool condition, const string& what )
+{
+  if ( not condition ) {
+    cerr << "FAIL " << what << endl;
+    failures++;
+  }
+}
+
+uint64_t timestamp_of( const uint64_t frame_no )
+{
+  return 1000 * ( frame_no + 1 );
+}
+
+// Records frames until next_frame() == next
+void record_until( ReplayBuffer& buffer, const uint64_t next )
+{
+  RGBRaster frame { buffer.width(),
+                    buffer.height(),
+                    buffer.width(),
+                    buffer.height() };
+  for ( uint64_t frame_no = buffer.next_frame(); frame_no < next;
+        frame_no++ ) {
+    memset( &frame.R().at( 0, 0 ),
+            frame_no,
+            size_t { buffer.width() } * buffer.height() );
+    buffer.record( frame, timestamp_of( frame_no ) );
+  }
+}
+
+// Checks that exactly [oldest, next) is replayable, and can be found
+void check_range( const ReplayBuffer& buffer,
+                  const uint64_t oldest,
+                  const uint64_t next )
+{
+  const string name = "slot_count=" + to_string( buffer.slot_count() )
+                      + ", next=" + to_string( next ) + ": ";
+
+  check( buffer.next_frame() == next, name + "next_frame()" );
+  check( buffer.oldest_frame() == oldest,
+         name + "oldest_frame() is " + to_string( buffer.oldest_frame() )
+           + ", not " + to_string( oldest ) );
+
+  /* a timestamp before the oldest frame finds the oldest frame */
+  check( buffer.frame_at( 0 ) == oldest, name + "frame_at( 0 )" );
+  check( buffer.frame_at( timestamp_of( next ) ) == next,
+         name + "frame_at() past the newest frame" );
+
+  RGBRaster frame { buffer.width(),
+                    buffer.height(),
+                    buffer.width(),
+                    buffer.height() };
+  for ( uint64_t frame_no = oldest; frame_no < next; frame_no++ ) {
+    check( buffer.frame_at( timestamp_of( frame_no ) ) == frame_no,
+           name + "frame_at() of frame " + to_string( frame_no ) );
+
+    uint64_t timestamp_ns = 0;
+    check( buffer.read( frame_no, frame, timestamp_ns )
+             and timestamp_ns == timestamp_of( frame_no )
+             and frame.R().at( 0, 0 ) == frame_no,
+           name + "read() of frame " + to_string( frame_no ) );
+  }
+}
+
+}
+
+int main()
+{
+  const string filename = "/tmp/replay-buffer-test." + to_string( getpid() );
+
+  for ( const uint32_t slot_count : { 2, 4 } ) {
+    ReplayBuffer buffer { filename, 16, 8, slot_count };
+
+    record_until( buffer, slot_count - 1 );
+    check_range( buffer, 0, slot_count - 1 );
+
+    /* frame 0's slot is now the next to be overwritten */
+    record_until( buffer, slot_count );
+    check_range( buffer, 1, slot_count );
+
+    record_until( buffer, slot_count + 1 );
+    check_range( buffer, 2, slot_count + 1 );
+  }
+
+  bool rejected = false;
+  try {
+    ReplayBuffer buffer { filename, 16, 8, 1 };
+  } catch ( const runtime_error& ) {
+    rejected = true;
+  }
+  check( rejected, "slot_count=1 is rejected" );
+
+  unlink( filename.c_str() );
+
+  if ( failures ) {
+    return EXIT_FAILURE;
+  }
+
+  cout << "all checks passed" << endl;
+  return EXIT_SUCCESS;
+}
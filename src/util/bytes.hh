@@ -0,0 +1,43 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef BYTES_HH
+#define BYTES_HH
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/* Helpers for laying out and fingerprinting raw bytes, shared by the
+   on-disk and shared-memory formats */
+
+// The virtual memory page size, which mmap() offsets must be multiples of
+inline size_t page_size()
+{
+  static const size_t size = sysconf( _SC_PAGESIZE );
+  return size;
+}
+
+// The smallest multiple of `alignment` that is at least `value`
+inline size_t round_up( const size_t value, const size_t alignment )
+{
+  return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+/* 64-bit FNV-1a. To hash data in pieces, pass each result on as the `hash`
+   for the next piece. */
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+inline uint64_t fnv1a( const uint8_t* data,
+                       const size_t length,
+                       uint64_t hash = FNV_OFFSET_BASIS )
+{
+  for ( size_t i = 0; i < length; i++ ) {
+    hash = ( hash ^ data[i] ) * FNV_PRIME;
+  }
+  return hash;
+}
+
+#endif /* BYTES_HH */
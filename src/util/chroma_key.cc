@@ -1,11 +1,13 @@
 /* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
 
+#include <algorithm>
 #include <iostream>
 #include <mutex>
 #include <numeric>
 #include <thread>
 
 #include "chroma_key.hh"
+#include "latency.hh"
 
 using namespace std;
 
@@ -15,35 +17,88 @@ ChromaKey::ChromaKey( const uint16_t width,
   : width_( width )
   , height_( height )
   , thread_count_( thread_count )
-  , pool_( thread_count, width, height, this )
+  , pool_( "chromakey", thread_count, width, height, this )
 {
-  pool_.append_task( &ChromaKey::keying_task );
-  pool_.append_task( &ChromaKey::keying_clip_task );
-  pool_.append_task( &ChromaKey::DE_intermediate_task );
-  pool_.append_task( &ChromaKey::DE_final_task );
-  pool_.append_task( &ChromaKey::despill_task );
+  update_tile_halo();
+  pool_.append_task( &ChromaKey::compare_tiles_task, "compare tiles" );
+  pool_.append_task( &ChromaKey::keying_task, "keying" );
+  pool_.append_task( &ChromaKey::keying_clip_intermediate_task,
+                     "keying clip 1" );
+  pool_.append_task( &ChromaKey::keying_clip_final_task, "keying clip 2" );
+  pool_.append_task( &ChromaKey::DE_intermediate_task, "dilate/erode 1" );
+  pool_.append_task( &ChromaKey::DE_final_task, "dilate/erode 2" );
+  pool_.append_task( &ChromaKey::despill_task, "despill" );
 }
 
 ChromaKey::ChromaKey( const ChromaKey& other )
   : ChromaKey( other.width_, other.height_, other.thread_count_ )
 {}
 
+void ChromaKey::update_tile_halo()
+{
+  /* the clip kernel reaches radius - 1 pixels; dilate/erode reaches its
+     distance, horizontally then vertically */
+  tile_cache_.set_halo(
+    max( 0, keying_clip_operation_.kernel_radius() - 1 )
+    + dilate_erode_operation_.distance() );
+}
+
+void ChromaKey::compare_tiles_task( const uint16_t row_start_idx,
+                                    const uint16_t row_end_idx )
+{
+  tile_cache_.compare_tiles( raster(), row_start_idx, row_end_idx );
+}
+
 void ChromaKey::keying_task( const uint16_t row_start_idx,
                              const uint16_t row_end_idx )
 {
-  keying_operation_.process_rows( raster(), row_start_idx, row_end_idx );
+  const latency::ScopedTimer timer { latency::Stage::Keying };
+  tile_cache_.process(
+    row_start_idx,
+    row_end_idx,
+    [&]( const uint16_t row_start,
+         const uint16_t row_end,
+         const uint16_t col_start,
+         const uint16_t col_end ) {
+      /* despill changes the colors, so keep them as they came in */
+      tile_cache_.save_reference(
+        raster(), row_start, row_end, col_start, col_end );
+      keying_operation_.process_region(
+        raster(), row_start, row_end, col_start, col_end );
+    },
+    { { raster().A(), TileCache::Plane::RawAlpha } } );
 }
 
-void ChromaKey::keying_clip_task( const uint16_t row_start_idx,
-                                  const uint16_t row_end_idx )
+void ChromaKey::keying_clip_intermediate_task( const uint16_t row_start_idx,
+                                               const uint16_t row_end_idx )
 {
-  keying_clip_operation_.process_rows(
+  const latency::ScopedTimer timer { latency::Stage::KeyingClip };
+  tile_cache_.process(
+    row_start_idx,
+    row_end_idx,
+    [&]( const uint16_t row_start,
+         const uint16_t row_end,
+         const uint16_t col_start,
+         const uint16_t col_end ) {
+      keying_clip_operation_.process_region_intermediate(
+        raster().A(), row_start, row_end, col_start, col_end );
+    },
+    { { keying_clip_operation_.clipped_mask(),
+        TileCache::Plane::ClippedAlpha } } );
+}
+
+void ChromaKey::keying_clip_final_task( const uint16_t row_start_idx,
+                                        const uint16_t row_end_idx )
+{
+  const latency::ScopedTimer timer { latency::Stage::KeyingClip };
+  keying_clip_operation_.process_rows_final(
     raster().A(), row_start_idx, row_end_idx );
 }
 
 void ChromaKey::DE_intermediate_task( const uint16_t row_start_idx,
                                       const uint16_t row_end_idx )
 {
+  const latency::ScopedTimer timer { latency::Stage::DilateErode };
   dilate_erode_operation_.process_rows_intermediate(
     raster().A(), row_start_idx, row_end_idx );
 }
@@ -51,25 +106,53 @@ void ChromaKey::DE_intermediate_task( const uint16_t row_start_idx,
 void ChromaKey::DE_final_task( const uint16_t row_start_idx,
                                const uint16_t row_end_idx )
 {
-  dilate_erode_operation_.process_rows_final(
-    raster().A(), row_start_idx, row_end_idx );
+  const latency::ScopedTimer timer { latency::Stage::DilateErode };
+  tile_cache_.process(
+    row_start_idx,
+    row_end_idx,
+    [&]( const uint16_t row_start,
+         const uint16_t row_end,
+         const uint16_t col_start,
+         const uint16_t col_end ) {
+      dilate_erode_operation_.process_region_final(
+        raster().A(), row_start, row_end, col_start, col_end );
+    },
+    { { raster().A(), TileCache::Plane::FinalAlpha } } );
 }
 
 void ChromaKey::despill_task( const uint16_t row_start_idx,
                               const uint16_t row_end_idx )
 {
-  despill_operation_.process_rows( raster(), row_start_idx, row_end_idx );
+  const latency::ScopedTimer timer { latency::Stage::Despill };
+  tile_cache_.process(
+    row_start_idx,
+    row_end_idx,
+    [&]( const uint16_t row_start,
+         const uint16_t row_end,
+         const uint16_t col_start,
+         const uint16_t col_end ) {
+      despill_operation_.process_region(
+        raster(), row_start, row_end, col_start, col_end );
+    },
+    { { raster().R(), TileCache::Plane::DespilledR },
+      { raster().G(), TileCache::Plane::DespilledG },
+      { raster().B(), TileCache::Plane::DespilledB } } );
 }
 
 void ChromaKey::start_create_mask( RGBRaster& raster )
 {
   raster_ = &raster;
+  mask_start_ns_ = latency::now_ns();
+  tile_cache_.begin_frame();
   pool_.input_complete();
 }
 
 void ChromaKey::wait_for_mask()
 {
   pool_.wait_for_result();
+  tile_cache_.end_frame();
+  latency::record( latency::Stage::ChromaKey,
+                   latency::now_ns() - mask_start_ns_ );
 }
 
 void ChromaKey::update_color( RGBRaster& raster )
@@ -82,4 +165,4 @@ void ChromaKey::update_color( RGBRaster& raster )
       raster.B().at( col, row ) = alpha * raster.B().at( col, row );
     }
   }
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include "util/keying_clip.hh"
 #include "util/raster.hh"
 #include "util/thread_pool.hh"
+#include "util/tile_cache.hh"
 
 class ChromaKey
 {
@@ -25,20 +26,27 @@ private:
   const std::vector<double> default_key_color_ { 0, 0, 0 };
   KeyingOperation keying_operation_ { default_screen_balance_,
                                       default_key_color_ };
-  KeyingClipOperation keying_clip_operation_ {};
+  KeyingClipOperation keying_clip_operation_ { width_, height_ };
   DilateErodeOperation dilate_erode_operation_ { width_,
                                                  height_,
                                                  default_distance_ };
   DespillOperation despill_operation_ { keying_operation_ };
+  TileCache tile_cache_ { width_, height_ };
 
   int thread_count_;
   ThreadPool<ChromaKey> pool_;
   RGBRaster* raster_ { nullptr };
+  uint64_t mask_start_ns_ { 0 };
 
   RGBRaster& raster() { return *raster_; }
+  void update_tile_halo();
+  void compare_tiles_task( const uint16_t row_start_idx,
+                           const uint16_t row_end_idx );
   void keying_task( const uint16_t row_start_idx, const uint16_t row_end_idx );
-  void keying_clip_task( const uint16_t row_start_idx,
-                         const uint16_t row_end_idx );
+  void keying_clip_intermediate_task( const uint16_t row_start_idx,
+                                      const uint16_t row_end_idx );
+  void keying_clip_final_task( const uint16_t row_start_idx,
+                               const uint16_t row_end_idx );
   void DE_intermediate_task( const uint16_t row_start_idx,
                              const uint16_t row_end_idx );
   void DE_final_task( const uint16_t row_start_idx,
@@ -54,46 +62,67 @@ public:
   void set_dilate_erode_distance( const int distance )
   {
     dilate_erode_operation_.set_distance( distance );
+    update_tile_halo();
   }
   void set_key_color( const std::vector<double>& key_color )
   {
     keying_operation_.set_key_color( key_color );
+    tile_cache_.invalidate();
   }
   void set_screen_balance( const double screen_balance )
   {
     keying_operation_.set_screen_balance( screen_balance );
+    tile_cache_.invalidate();
   }
   void set_marker_config( const int num_horizontal, const int num_vertical )
   {
     keying_operation_.set_marker_config( num_horizontal, num_vertical );
+    tile_cache_.invalidate();
   }
   void set_multikey_color( const RGBRaster& background )
   {
     keying_operation_.set_multikey_color( background );
+    tile_cache_.invalidate();
   }
   void set_kernel_radius( const uint8_t radius )
   {
     keying_clip_operation_.set_kernel_radius( radius );
+    update_tile_halo();
   }
   void set_kernel_tolerance( const double tolerance )
   {
     keying_clip_operation_.set_kernel_tolerance( tolerance );
+    tile_cache_.invalidate();
   }
   void set_clip_black( const double clip_black )
   {
     keying_clip_operation_.set_clip_black( clip_black );
+    tile_cache_.invalidate();
   }
   void set_clip_white( const double clip_white )
   {
     keying_clip_operation_.set_clip_white( clip_white );
+    tile_cache_.invalidate();
   }
   void set_despill_factor( const double despill_factor )
   {
     despill_operation_.set_despill_factor( despill_factor );
+    tile_cache_.invalidate();
   }
   void set_despill_balance( const double color_balance )
   {
     despill_operation_.set_despill_balance( color_balance );
+    tile_cache_.invalidate();
+  }
+  // Reuse last frame's results for tiles whose mean absolute difference
+  // from it is at most `threshold` (0-255); 0 (the default) turns this off
+  void set_tile_skip_threshold( const double threshold )
+  {
+    tile_cache_.set_threshold( threshold );
+  }
+  TileCache::Statistics tile_statistics() const
+  {
+    return tile_cache_.statistics();
   }
   void start_create_mask( RGBRaster& raster );
   void wait_for_mask();
@@ -4,6 +4,7 @@
 #include <numeric>
 
 #include "compositor.hh"
+#include "latency.hh"
 
 using namespace std;
 
@@ -13,9 +14,9 @@ Compositor::Compositor( const uint16_t width,
   : width_( width )
   , height_( height )
   , thread_count_( thread_count )
-  , pool_( thread_count, width, height, this )
+  , pool_( "compositor", thread_count, width, height, this )
 {
-  pool_.append_task( &Compositor::composite_task );
+  pool_.append_task( &Compositor::composite_task, "composite" );
 }
 
 void Compositor::composite_pixel( const uint16_t row, const uint16_t col )
@@ -57,6 +58,7 @@ void Compositor::composite_task( const uint16_t row_start_idx,
 
 RGBRaster& Compositor::composite()
 {
+  const latency::ScopedTimer timer { latency::Stage::Composite };
   pool_.input_complete();
   pool_.wait_for_result();
   return output_raster_;
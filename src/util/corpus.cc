@@ -0,0 +1,20 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "corpus.hh"
+
+using namespace std;
+
+void copy_frame( const RGBRaster& from, RGBRaster& to )
+{
+  to.copy_from( from );
+  to.A().copy_from( from.A() );
+}
+
+RGBRaster copy_of( const RGBRaster& frame )
+{
+  RGBRaster copy {
+    frame.width(), frame.height(), frame.width(), frame.height()
+  };
+  copy_frame( frame, copy );
+  return copy;
+}
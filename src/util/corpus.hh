@@ -0,0 +1,25 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef CORPUS_HH
+#define CORPUS_HH
+
+#include <string>
+#include <vector>
+
+#include "raster.hh"
+
+/* A frame to run the keying pipeline on, with the key color that goes with
+   it, as used by the bench and golden-check tools */
+struct Source
+{
+  std::string name;
+  RGBRaster frame;
+  std::vector<double> key_color;
+};
+
+// Copies the R, G, B and alpha planes of a frame the same size
+void copy_frame( const RGBRaster& from, RGBRaster& to );
+
+RGBRaster copy_of( const RGBRaster& frame );
+
+#endif /* CORPUS_HH */
@@ -43,12 +43,21 @@ void DespillOperation::process_pixel( RGBRaster& raster, int x, int y )
 void DespillOperation::process_rows( RGBRaster& raster,
                                      const uint16_t row_start_idx,
                                      const uint16_t row_end_idx )
+{
+  process_region( raster, row_start_idx, row_end_idx, 0, raster.width() );
+}
+
+void DespillOperation::process_region( RGBRaster& raster,
+                                       const uint16_t row_start_idx,
+                                       const uint16_t row_end_idx,
+                                       const uint16_t col_start_idx,
+                                       const uint16_t col_end_idx )
 {
   if ( despill_factor_ == 0 ) {
     return;
   }
   for ( int row = row_start_idx; row < row_end_idx; row++ ) {
-    for ( int col = 0; col < raster.width(); col++ ) {
+    for ( int col = col_start_idx; col < col_end_idx; col++ ) {
       process_pixel( raster, col, row );
     }
   }
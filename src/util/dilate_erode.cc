@@ -82,12 +82,22 @@ void DilateErodeOperation::process_rows_intermediate(
 void DilateErodeOperation::process_rows_final( TwoD<uint8_t>& mask,
                                                const uint16_t row_start_idx,
                                                const uint16_t row_end_idx )
+{
+  process_region_final(
+    mask, row_start_idx, row_end_idx, 0, intermediate_mask_.width() );
+}
+
+void DilateErodeOperation::process_region_final( TwoD<uint8_t>& mask,
+                                                 const uint16_t row_start_idx,
+                                                 const uint16_t row_end_idx,
+                                                 const uint16_t col_start_idx,
+                                                 const uint16_t col_end_idx )
 {
   if ( distance_ == 0 ) {
     return;
   }
   for ( uint16_t row = row_start_idx; row < row_end_idx; row++ ) {
-    for ( uint16_t col = 0; col < intermediate_mask_.width(); col++ ) {
+    for ( uint16_t col = col_start_idx; col < col_end_idx; col++ ) {
       mask.at( col, row ) = process_pixel_final( col, row );
     }
   }
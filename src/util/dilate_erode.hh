@@ -21,6 +21,8 @@ public:
                         const uint16_t height,
                         const int distance );
   void set_distance( const int distance );
+  // The farthest (in pixels) that the output depends on the input
+  int distance() const { return distance_; }
   // The kernel is separable, so the convolution is done in two steps for speed
   void process_rows_intermediate( TwoD<uint8_t>& mask,
                                   const uint16_t row_start_idx,
@@ -28,6 +30,11 @@ public:
   void process_rows_final( TwoD<uint8_t>& mask,
                            const uint16_t row_start_idx,
                            const uint16_t row_end_idx );
+  void process_region_final( TwoD<uint8_t>& mask,
+                             const uint16_t row_start_idx,
+                             const uint16_t row_end_idx,
+                             const uint16_t col_start_idx,
+                             const uint16_t col_end_idx );
 };
 
 #endif /* DILATE_ERODE_HH */
@@ -26,8 +26,10 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <algorithm>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include "exception.hh"
 #include "file.hh"
@@ -51,3 +53,20 @@ File::File( File&& other )
   , mmap_region_( move( other.mmap_region_ ) )
   , chunk_( move( other.chunk_ ) )
 {}
+
+void File::advise( const uint64_t offset,
+                   const uint64_t length,
+                   const int advice ) const
+{
+  static const uint64_t page_size = sysconf( _SC_PAGESIZE );
+
+  if ( offset >= size_ ) {
+    return;
+  }
+
+  const uint64_t start = offset - offset % page_size;
+  const uint64_t end = min<uint64_t>( size_, offset + length );
+
+  SystemCall( "madvise",
+              madvise( mmap_region_.addr() + start, end - start, advice ) );
+}
@@ -63,6 +63,11 @@ public:
   File( File&& other );
 
   size_t size() const { return size_; }
+
+  /* madvise() the pages covering [offset, offset + length) */
+  void advise( const uint64_t offset,
+               const uint64_t length,
+               const int advice ) const;
 };
 
 #endif /* FILE_HH */
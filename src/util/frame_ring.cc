@@ -0,0 +1,279 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "frame_ring.hh"
+
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bytes.hh"
+#include "exception.hh"
+
+using namespace std;
+
+static const char MAGIC[8] = { 'F', 'R', 'M', 'R', 'I', 'N', 'G', '1' };
+
+static size_t slots_offset( const uint32_t slot_count )
+{
+  return round_up( sizeof( FrameRing::Header )
+                     + slot_count * sizeof( FrameRing::Slot ),
+                   page_size() );
+}
+
+static size_t slot_length( const uint16_t width, const uint16_t height )
+{
+  return round_up( FrameRing::PLANE_COUNT * size_t { width } * height,
+                   page_size() );
+}
+
+static long futex( atomic<uint32_t>& word,
+                   const int operation,
+                   const uint32_t value,
+                   const timespec* timeout )
+{
+  /* the ring is shared between processes, so no FUTEX_PRIVATE_FLAG */
+  return syscall( SYS_futex,
+                  reinterpret_cast<uint32_t*>( &word ),
+                  operation,
+                  value,
+                  timeout );
+}
+
+FileDescriptor FrameRing::create_memfd( const size_t length )
+{
+  FileDescriptor fd { SystemCall(
+    "memfd_create",
+    memfd_create( "frame-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING ) ) };
+
+  SystemCall( "ftruncate", ftruncate( fd.fd_num(), length ) );
+
+  /* readers map the whole file, so it must never shrink under them */
+  SystemCall( "fcntl",
+              fcntl( fd.fd_num(),
+                     F_ADD_SEALS,
+                     F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) );
+
+  return fd;
+}
+
+FrameRing::FrameRing( const uint16_t width,
+                      const uint16_t height,
+                      const uint32_t slot_count )
+  : fd_( create_memfd( slots_offset( slot_count )
+                       + slot_count * slot_length( width, height ) ) )
+  , region_( fd_.size(),
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE,
+             fd_.fd_num() )
+{
+  static_assert( atomic<uint64_t>::is_always_lock_free );
+  static_assert( atomic<uint32_t>::is_always_lock_free );
+
+  if ( width == 0 or height == 0 or slot_count < 2
+       or slot_count > MAX_SLOTS ) {
+    throw runtime_error( "FrameRing needs a nonzero size and 2 to "
+                         + to_string( MAX_SLOTS ) + " slots" );
+  }
+
+  Header* const ring_header = new ( region_.addr() ) Header;
+  memcpy( ring_header->magic, MAGIC, sizeof( MAGIC ) );
+  ring_header->width = width;
+  ring_header->height = height;
+  ring_header->slot_count = slot_count;
+  ring_header->plane_count = PLANE_COUNT;
+  ring_header->slot_length = slot_length( width, height );
+  ring_header->slots_offset = slots_offset( slot_count );
+  ring_header->latest.store( 0 );
+  ring_header->generation.store( 0 );
+  ring_header->waiters.store( 0 );
+  ring_header->closed.store( 0 );
+
+  Slot* const slots
+    = new ( region_.addr() + sizeof( Header ) ) Slot[slot_count];
+  for ( uint32_t i = 0; i < slot_count; i++ ) {
+    slots[i].state.store( 0 );
+    slots[i].sequence.store( 0 );
+    slots[i].timestamp_ns.store( 0 );
+  }
+}
+
+FrameRing::FrameRing( FileDescriptor&& fd )
+  : fd_( move( fd ) )
+  , region_( fd_.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd_.fd_num() )
+{
+  if ( region_.length() < sizeof( Header )
+       or memcmp( header().magic, MAGIC, sizeof( MAGIC ) ) ) {
+    throw runtime_error( "not a frame ring" );
+  }
+
+  const Header& ring_header = header();
+  if ( ring_header.plane_count != PLANE_COUNT or ring_header.slot_count < 2
+       or ring_header.slot_count > MAX_SLOTS
+       or ring_header.slots_offset != slots_offset( ring_header.slot_count )
+       or ring_header.slot_length
+            != slot_length( ring_header.width, ring_header.height )
+       or region_.length() < ring_header.slots_offset
+                               + ring_header.slot_count
+                                   * ring_header.slot_length ) {
+    throw runtime_error( "frame ring header is inconsistent" );
+  }
+}
+
+FrameRing::FrameRing( const string& path )
+  : FrameRing(
+    FileDescriptor { SystemCall( path, open( path.c_str(), O_RDWR ) ) } )
+{}
+
+FrameRing::Header& FrameRing::header() const
+{
+  return *reinterpret_cast<Header*>( region_.addr() );
+}
+
+FrameRing::Slot& FrameRing::slot( const uint32_t index ) const
+{
+  return reinterpret_cast<Slot*>( region_.addr() + sizeof( Header ) )[index];
+}
+
+string FrameRing::path() const
+{
+  return "/proc/" + to_string( getpid() ) + "/fd/"
+         + to_string( fd_.fd_num() );
+}
+
+uint8_t* FrameRing::plane( const uint32_t slot,
+                           const unsigned int plane ) const
+{
+  return region_.addr() + header().slots_offset
+         + slot * header().slot_length + plane * plane_length();
+}
+
+optional<uint32_t> FrameRing::claim()
+{
+  const uint32_t slot_count = header().slot_count;
+  const uint64_t latest = header().latest.load();
+
+  for ( uint32_t i = 0; i < slot_count; i++ ) {
+    const uint32_t index = ( next_slot_ + i ) % slot_count;
+
+    /* leave the latest frame for readers that haven't picked it up yet */
+    if ( latest != 0 and index == latest % MAX_SLOTS ) {
+      continue;
+    }
+
+    uint32_t expected = 0;
+    if ( slot( index ).state.compare_exchange_strong(
+           expected, WRITING, memory_order_acquire ) ) {
+      next_slot_ = ( index + 1 ) % slot_count;
+      return index;
+    }
+  }
+
+  return {};
+}
+
+void FrameRing::publish( const uint32_t index, const uint64_t timestamp_ns )
+{
+  const uint64_t sequence = next_sequence_++;
+
+  Slot& claimed = slot( index );
+  claimed.timestamp_ns.store( timestamp_ns, memory_order_relaxed );
+  claimed.sequence.store( sequence, memory_order_relaxed );
+  claimed.state.store( 0, memory_order_release );
+
+  header().latest.store( sequence * MAX_SLOTS + index,
+                         memory_order_release );
+
+  header().generation.fetch_add( 1 );
+  if ( header().waiters.load() > 0 ) {
+    futex( header().generation, FUTEX_WAKE, INT32_MAX, nullptr );
+  }
+}
+
+void FrameRing::close()
+{
+  header().closed.store( 1 );
+  header().generation.fetch_add( 1 );
+  futex( header().generation, FUTEX_WAKE, INT32_MAX, nullptr );
+}
+
+bool FrameRing::closed() const
+{
+  return header().closed.load();
+}
+
+optional<FrameRing::Reference> FrameRing::acquire_latest(
+  const uint64_t after_sequence )
+{
+  while ( true ) {
+    const uint64_t latest = header().latest.load( memory_order_acquire );
+    const Reference reference { static_cast<uint32_t>( latest % MAX_SLOTS ),
+                                latest / MAX_SLOTS };
+
+    if ( latest == 0 or reference.sequence <= after_sequence ) {
+      return {};
+    }
+
+    Slot& candidate = slot( reference.slot );
+    uint32_t state = candidate.state.load( memory_order_relaxed );
+    bool acquired = false;
+
+    while ( state != WRITING ) {
+      if ( candidate.state.compare_exchange_weak(
+             state, state + 1, memory_order_acquire ) ) {
+        acquired = true;
+        break;
+      }
+    }
+
+    if ( acquired ) {
+      /* the writer may have reused the slot before we got a hold of it */
+      if ( candidate.sequence.load( memory_order_acquire )
+           == reference.sequence ) {
+        return reference;
+      }
+
+      release( reference );
+    }
+  }
+}
+
+void FrameRing::release( const Reference& reference )
+{
+  slot( reference.slot ).state.fetch_sub( 1, memory_order_release );
+}
+
+uint64_t FrameRing::timestamp( const Reference& reference ) const
+{
+  return slot( reference.slot ).timestamp_ns.load( memory_order_relaxed );
+}
+
+bool FrameRing::wait( const uint64_t after_sequence,
+                      const unsigned int timeout_ms )
+{
+  const timespec timeout { timeout_ms / 1000,
+                           ( timeout_ms % 1000 ) * 1000000L };
+
+  header().waiters.fetch_add( 1 );
+
+  while ( true ) {
+    const uint32_t generation = header().generation.load();
+
+    if ( closed()
+         or header().latest.load() / MAX_SLOTS > after_sequence ) {
+      break;
+    }
+
+    if ( futex( header().generation, FUTEX_WAIT, generation, &timeout ) < 0
+         and errno == ETIMEDOUT ) {
+      header().waiters.fetch_sub( 1 );
+      return false;
+    }
+  }
+
+  header().waiters.fetch_sub( 1 );
+  return true;
+}
@@ -0,0 +1,129 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef FRAME_RING_HH
+#define FRAME_RING_HH
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "file_descriptor.hh"
+#include "mmap_region.hh"
+
+/* A set of frame slots in shared memory (a sealed memfd), for passing RGBA
+   frames from one writer process to any number of reader processes.
+
+   Everything readers and the writer share lives in the mapping and is
+   updated with atomic operations only; nobody takes a lock. Each slot has a
+   state word that is either WRITING or a count of readers holding it. The
+   writer claims a free slot other than the latest one, fills it in place,
+   and publishes it as the latest frame. A reader takes a reference on the
+   latest slot and reads it in place until it releases it. If every slot is
+   held, the writer drops the frame instead of waiting. (A reader that
+   dies holding a slot leaves it held, so give each reader a spare slot.)
+
+   Readers that want to wait for the next frame sleep on a futex in the
+   header, which the writer wakes only when someone is waiting.
+
+   Other processes open the ring through path() (/proc/PID/fd/N), or
+   inherit the descriptor. */
+
+class FrameRing
+{
+public:
+  static constexpr uint32_t PLANE_COUNT = 4; /* R, G, B, A */
+  static constexpr uint32_t MAX_SLOTS = 256;
+
+  struct Header
+  {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t slot_count;
+    uint32_t plane_count;
+    uint64_t slot_length;
+    uint64_t slots_offset;
+
+    // sequence number * MAX_SLOTS + slot of the latest frame (0: none yet)
+    std::atomic<uint64_t> latest;
+
+    // futex word, bumped on every publish and on close
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> waiters;
+    std::atomic<uint32_t> closed;
+  };
+
+  struct Slot
+  {
+    std::atomic<uint32_t> state;
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> timestamp_ns;
+  };
+
+  static constexpr uint32_t WRITING = UINT32_MAX;
+
+  // A slot held by a reader, with the frame it was holding
+  struct Reference
+  {
+    uint32_t slot;
+    uint64_t sequence;
+  };
+
+private:
+  FileDescriptor fd_;
+  MMap_Region region_;
+
+  // writer only
+  uint64_t next_sequence_ { 1 };
+  uint32_t next_slot_ { 0 };
+
+  Header& header() const;
+  Slot& slot( const uint32_t index ) const;
+
+  static FileDescriptor create_memfd( const size_t length );
+
+public:
+  // Creates a new ring, as its writer
+  FrameRing( const uint16_t width,
+             const uint16_t height,
+             const uint32_t slot_count );
+
+  // Attaches to an existing ring, as a reader
+  FrameRing( FileDescriptor&& fd );
+  FrameRing( const std::string& path );
+
+  /* forbid copying */
+  FrameRing( const FrameRing& other ) = delete;
+  FrameRing& operator=( const FrameRing& other ) = delete;
+
+  uint16_t width() const { return header().width; }
+  uint16_t height() const { return header().height; }
+  size_t plane_length() const { return size_t { width() } * height(); }
+
+  // Where other processes (of the same user) can open the ring
+  std::string path() const;
+
+  // Start of one plane of a slot
+  uint8_t* plane( const uint32_t slot, const unsigned int plane ) const;
+
+  /* writer */
+  std::optional<uint32_t> claim();
+  void publish( const uint32_t slot, const uint64_t timestamp_ns );
+  void close();
+
+  /* readers */
+
+  // A reference to the latest frame, if it is newer than after_sequence
+  std::optional<Reference> acquire_latest( const uint64_t after_sequence );
+  void release( const Reference& reference );
+  uint64_t timestamp( const Reference& reference ) const;
+
+  // Sleeps until a frame newer than after_sequence is published or the
+  // writer closes the ring; false on timeout
+  bool wait( const uint64_t after_sequence, const unsigned int timeout_ms );
+
+  bool closed() const;
+};
+
+#endif /* FRAME_RING_HH */
@@ -0,0 +1,124 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "index_sidecar.hh"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "exception.hh"
+#include "file.hh"
+#include "file_descriptor.hh"
+
+using namespace std;
+
+static constexpr size_t MAGIC_LENGTH = 8;
+static constexpr size_t HEADER_LENGTH = MAGIC_LENGTH + 3 * sizeof( uint64_t );
+
+index_sidecar::Source index_sidecar::identify( const string& filename )
+{
+  struct stat file_info;
+  SystemCall( "stat " + filename, stat( filename.c_str(), &file_info ) );
+
+  return { static_cast<uint64_t>( file_info.st_size ),
+           file_info.st_mtim.tv_sec * 1000000000ULL
+             + file_info.st_mtim.tv_nsec };
+}
+
+string index_sidecar::sidecar_name( const string& filename )
+{
+  return filename + ".idx";
+}
+
+optional<vector<index_sidecar::Entry>> index_sidecar::load(
+  const string& filename,
+  const string& magic )
+{
+  if ( magic.size() != MAGIC_LENGTH ) {
+    throw runtime_error( "index sidecar magic must be 8 bytes" );
+  }
+
+  const string name = sidecar_name( filename );
+
+  struct stat sidecar_info;
+  if ( stat( name.c_str(), &sidecar_info ) < 0
+       or static_cast<size_t>( sidecar_info.st_size ) < HEADER_LENGTH ) {
+    return {};
+  }
+
+  try {
+    const Source source = identify( filename );
+    const File sidecar { name };
+    const Chunk header = sidecar.chunk();
+
+    if ( header( 0, MAGIC_LENGTH ).to_string() != magic
+         or header( MAGIC_LENGTH ).le64() != source.size
+         or header( MAGIC_LENGTH + 8 ).le64() != source.mtime_ns ) {
+      return {};
+    }
+
+    const uint64_t count = header( MAGIC_LENGTH + 16 ).le64();
+    if ( sidecar.size() != HEADER_LENGTH + count * 2 * sizeof( uint64_t ) ) {
+      return {};
+    }
+
+    vector<Entry> entries( count );
+    Chunk contents = sidecar.chunk()( HEADER_LENGTH );
+
+    for ( auto& entry : entries ) {
+      entry.offset = contents.le64();
+      entry.length = contents( 8 ).le64();
+      contents = contents( 16 );
+
+      if ( entry.offset + entry.length > source.size ) {
+        return {};
+      }
+    }
+
+    return entries;
+  } catch ( const exception& ) {
+    /* unreadable sidecar; the caller rebuilds the index */
+    return {};
+  }
+}
+
+static void append_le64( string& out, const uint64_t value )
+{
+  const uint64_t le_value = htole64( value );
+  out.append( reinterpret_cast<const char*>( &le_value ), sizeof( le_value ) );
+}
+
+void index_sidecar::save( const string& filename,
+                          const string& magic,
+                          const vector<Entry>& entries )
+{
+  try {
+    const Source source = identify( filename );
+
+    string contents = magic;
+    append_le64( contents, source.size );
+    append_le64( contents, source.mtime_ns );
+    append_le64( contents, entries.size() );
+
+    for ( const auto& entry : entries ) {
+      append_le64( contents, entry.offset );
+      append_le64( contents, entry.length );
+    }
+
+    /* write to a temporary name and rename, so readers never see half a
+       file */
+    const string name = sidecar_name( filename );
+    const string temp_name = name + ".tmp";
+
+    {
+      FileDescriptor sidecar { SystemCall(
+        temp_name,
+        open( temp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) };
+      sidecar.write( Chunk { contents } );
+    } // End of file scope
+
+    SystemCall( "rename", rename( temp_name.c_str(), name.c_str() ) );
+  } catch ( const exception& ) {
+    /* e.g. the directory may be read-only */
+  }
+}
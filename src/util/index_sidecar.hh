@@ -0,0 +1,44 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef INDEX_SIDECAR_HH
+#define INDEX_SIDECAR_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/* Frame indices of container files, persisted next to them (FILENAME.idx)
+   so that large recordings can be reopened without rescanning. A sidecar
+   records the size and modification time of the file it describes and is
+   ignored once they change. */
+
+namespace index_sidecar {
+
+struct Entry
+{
+  uint64_t offset;
+  uint64_t length;
+};
+
+struct Source
+{
+  uint64_t size;
+  uint64_t mtime_ns;
+};
+
+Source identify( const std::string& filename );
+
+std::string sidecar_name( const std::string& filename );
+
+// `magic` (8 bytes) distinguishes the kinds of index
+std::optional<std::vector<Entry>> load( const std::string& filename,
+                                        const std::string& magic );
+
+// Failures are ignored: the sidecar is only a cache
+void save( const std::string& filename,
+           const std::string& magic,
+           const std::vector<Entry>& entries );
+}
+
+#endif /* INDEX_SIDECAR_HH */
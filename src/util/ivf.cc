@@ -26,16 +26,21 @@
    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <algorithm>
 #include <stdexcept>
+#include <sys/mman.h>
 
 #include "file.hh"
 #include "ivf.hh"
 
 using namespace std;
 
+static const string SIDECAR_MAGIC = "IVFIDX01";
+
 IVF::IVF( const string& filename )
 try
-  : file_( filename )
+  : filename_( filename )
+  , file_( filename )
   , header_( file_( 0, supported_header_len ) )
   , fourcc_( header_( 8, 4 ).to_string() )
   , width_( header_( 12, 2 ).le16() )
@@ -44,7 +49,8 @@ try
   , time_scale_( header_( 20, 4 ).le32() )
   , frame_count_( header_( 24, 4 ).le32() )
   , expected_decoder_minihash_( header_( 28, 4 ).le32() )
-  , frame_index_() {
+  , frame_index_()
+  , next_frame_position_( supported_header_len ) {
   if ( header_( 0, 4 ).to_string() != "DKIF" ) {
     throw Invalid( "missing IVF file header" );
   }
@@ -57,23 +63,117 @@ try
     throw Unsupported( "unsupported IVF header length" );
   }
 
-  /* build the index */
-  frame_index_.reserve( frame_count_ );
-
-  uint64_t position = supported_header_len;
-  for ( uint32_t i = 0; i < frame_count_; i++ ) {
-    Chunk frame_header = file_( position, frame_header_len );
-    const uint32_t frame_len = frame_header.le32();
-
-    frame_index_.emplace_back( position + frame_header_len, frame_len );
-    position += frame_header_len + frame_len;
+  auto cached_index = index_sidecar::load( filename_, SIDECAR_MAGIC );
+  if ( cached_index.has_value() and cached_index->size() == frame_count_ ) {
+    frame_index_ = move( *cached_index );
+  } else {
+    frame_index_.reserve( frame_count_ );
   }
 } catch ( const out_of_range& e ) {
   throw Invalid( "IVF file truncated" );
 }
 
+void IVF::index_through( const uint32_t index ) const
+{
+  if ( index >= frame_count_ ) {
+    throw out_of_range( "IVF frame index out of range" );
+  }
+
+  if ( index < frame_index_.size() ) {
+    return;
+  }
+
+  try {
+    while ( frame_index_.size() <= index ) {
+      Chunk frame_header
+        = file_( next_frame_position_, frame_header_len );
+      const uint32_t frame_len = frame_header.le32();
+
+      /* make sure the payload is there too */
+      file_( next_frame_position_ + frame_header_len, frame_len );
+
+      frame_index_.push_back(
+        { next_frame_position_ + frame_header_len, frame_len } );
+      next_frame_position_ += frame_header_len + frame_len;
+    }
+  } catch ( const out_of_range& e ) {
+    throw Invalid( "IVF file truncated" );
+  }
+
+  if ( frame_index_.size() == frame_count_ ) {
+    index_sidecar::save( filename_, SIDECAR_MAGIC, frame_index_ );
+  }
+}
+
 Chunk IVF::frame( const uint32_t& index ) const
 {
-  const auto& entry = frame_index_.at( index );
-  return file_( entry.first, entry.second );
+  index_through( index );
+  const auto& entry = frame_index_[index];
+  return file_( entry.offset, entry.length );
+}
+
+uint64_t IVF::pts( const uint32_t index ) const
+{
+  index_through( index );
+  return file_( frame_index_[index].offset - frame_header_len + 4, 8 ).le64();
+}
+
+uint32_t IVF::frame_for_pts( const uint64_t timestamp ) const
+{
+  if ( frame_count_ == 0 ) {
+    throw out_of_range( "IVF file has no frames" );
+  }
+
+  /* the answer is in [low, high): pts( low ) <= timestamp (unless low is
+     0), and pts( high ) > timestamp (unless high is frame_count_) */
+  uint32_t low = 0, high = frame_index_.size();
+
+  /* past the frames indexed so far, gallop forward, doubling the distance
+     each time, so a seek indexes at most about twice as far as the frame
+     it lands on */
+  if ( high == 0 or pts( high - 1 ) <= timestamp ) {
+    low = high == 0 ? 0 : high - 1;
+    uint64_t step = max<uint64_t>( 1, high );
+    while ( true ) {
+      if ( low == frame_count_ - 1 ) {
+        high = frame_count_;
+        break;
+      }
+
+      const uint32_t probe = min<uint64_t>( frame_count_ - 1, low + step );
+      if ( pts( probe ) > timestamp ) {
+        high = probe;
+        break;
+      }
+
+      low = probe;
+      step *= 2;
+    }
+  }
+
+  /* every frame in [low, high) is indexed by now */
+  while ( high - low > 1 ) {
+    const uint32_t middle = low + ( high - low ) / 2;
+    if ( pts( middle ) <= timestamp ) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+void IVF::prefetch( const uint32_t first, const uint32_t count ) const
+{
+  if ( first >= frame_count_ or count == 0 ) {
+    return;
+  }
+
+  const uint32_t last = min( frame_count_ - 1, first + count - 1 );
+  index_through( last );
+
+  const uint64_t begin = frame_index_[first].offset - frame_header_len;
+  const uint64_t end = frame_index_[last].offset + frame_index_[last].length;
+  file_.advise( begin, end - begin, MADV_WILLNEED );
 }
@@ -34,10 +34,17 @@
 #include <vector>
 
 #include "file.hh"
+#include "index_sidecar.hh"
+
+/* The frame index is built lazily: opening a file reads only its header,
+   and frames are located on first access by walking the frame headers up to
+   the one requested. Once the whole file has been walked, the index is saved
+   to a sidecar (see index_sidecar) so the next open can skip the walk. */
 
 class IVF
 {
 private:
+  std::string filename_;
   File file_;
   Chunk header_;
 
@@ -46,7 +53,13 @@ private:
   uint32_t frame_rate_, time_scale_, frame_count_;
   uint32_t expected_decoder_minihash_;
 
-  std::vector<std::pair<uint64_t, uint32_t>> frame_index_;
+  // offset and length of each frame's payload
+  mutable std::vector<index_sidecar::Entry> frame_index_;
+
+  // where the next frame header would be, when frame_index_ is incomplete
+  mutable uint64_t next_frame_position_;
+
+  void index_through( const uint32_t index ) const;
 
 public:
   static constexpr int supported_header_len = 32;
@@ -63,6 +76,15 @@ public:
 
   Chunk frame( const uint32_t& index ) const;
 
+  // presentation timestamp of a frame, in time_scale units
+  uint64_t pts( const uint32_t index ) const;
+
+  // the last frame with pts <= timestamp (or the first frame)
+  uint32_t frame_for_pts( const uint64_t timestamp ) const;
+
+  // madvise(WILLNEED) the frames in [first, first + count)
+  void prefetch( const uint32_t first, const uint32_t count ) const;
+
   size_t size() const { return file_.size(); }
 
   uint32_t expected_decoder_minihash() const
@@ -28,9 +28,11 @@
 
 #include <cstring>
 #include <fcntl.h>
+#include <iostream>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "ivf_writer.hh"
 #include "mmap_region.hh"
@@ -56,6 +58,34 @@ static void memcpy_le32( uint8_t* dest, const uint32_t val )
   memcpy( dest, &swizzled, sizeof( swizzled ) );
 }
 
+static void memcpy_le64( uint8_t* dest, const uint64_t val )
+{
+  uint64_t swizzled = htole64( val );
+  memcpy( dest, &swizzled, sizeof( swizzled ) );
+}
+
+/* writev() that retries until everything has been written */
+static void writev_all( const int fd, iovec* iov, int iov_count )
+{
+  while ( iov_count > 0 ) {
+    size_t bytes_written = SystemCall( "writev", writev( fd, iov, iov_count ) );
+    if ( bytes_written == 0 ) {
+      throw internal_error( "writev", "returned 0" );
+    }
+
+    while ( iov_count > 0 and bytes_written >= iov->iov_len ) {
+      bytes_written -= iov->iov_len;
+      iov++;
+      iov_count--;
+    }
+
+    if ( iov_count > 0 ) {
+      iov->iov_base = static_cast<uint8_t*>( iov->iov_base ) + bytes_written;
+      iov->iov_len -= bytes_written;
+    }
+  }
+}
+
 IVFWriter::IVFWriter( FileDescriptor&& fd,
                       const string& fourcc,
                       const uint16_t width,
@@ -91,63 +121,110 @@ IVFWriter::IVFWriter( FileDescriptor&& fd,
 
   /* verify the new file size */
   assert( fd_.size() == file_size_ );
+
+  /* map the header into memory, to update the frame count in place */
+  header_in_mem_.emplace( IVF::supported_header_len,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED,
+                          fd_.fd_num() );
+}
+
+IVFWriter::~IVFWriter()
+{
+  try {
+    flush();
+  } catch ( const exception& e ) {
+    cerr << "IVFWriter: " << e.what() << endl;
+  }
 }
 
 void IVFWriter::set_expected_decoder_entry_hash(
   const uint32_t minihash ) /* ExCamera invention */
 {
-  /* map the header into memory */
-  MMap_Region header_in_mem( IVF::supported_header_len,
-                             PROT_READ | PROT_WRITE,
-                             MAP_SHARED,
-                             fd_.fd_num() );
-  uint8_t* mutable_header_ptr = header_in_mem.addr();
-
-  memcpy_le32( mutable_header_ptr + 28, minihash ); /* ExCamera invention */
+  memcpy_le32( header_in_mem_->addr() + 28, minihash );
+}
+
+void IVFWriter::set_buffering( const size_t max_buffered_bytes,
+                               const uint32_t header_update_interval )
+{
+  if ( header_update_interval == 0 ) {
+    throw runtime_error( "header update interval must be positive" );
+  }
+
+  flush();
+  max_buffered_bytes_ = max_buffered_bytes;
+  header_update_interval_ = header_update_interval;
+}
+
+/* writes the buffered frames, then the given frame (if any), in one call */
+void IVFWriter::write_out( const Chunk& frame_header, const Chunk& frame )
+{
+  iovec iov[3];
+  int iov_count = 0;
+
+  for ( const Chunk& chunk :
+        { Chunk( buffered_frames_ ), frame_header, frame } ) {
+    if ( chunk.size() > 0 ) {
+      iov[iov_count++]
+        = { const_cast<uint8_t*>( chunk.buffer() ), chunk.size() };
+    }
+  }
+
+  writev_all( fd_.fd_num(), iov, iov_count );
+
+  buffered_frames_.clear();
+  written_frame_count_ = frame_count_;
 }
 
-size_t IVFWriter::append_frame( const Chunk& chunk )
+void IVFWriter::update_frame_count( const bool force )
 {
-  /* map the header into memory */
-  MMap_Region header_in_mem( IVF::supported_header_len,
-                             PROT_READ | PROT_WRITE,
-                             MAP_SHARED,
-                             fd_.fd_num() );
-  uint8_t* mutable_header_ptr = header_in_mem.addr();
+  if ( written_frame_count_ == header_frame_count_
+       or ( not force
+            and written_frame_count_ - header_frame_count_
+                  < header_update_interval_ ) ) {
+    return;
+  }
 
-  Chunk header( mutable_header_ptr, IVF::supported_header_len );
+  memcpy_le32( header_in_mem_->addr() + 24, written_frame_count_ );
+  header_frame_count_ = written_frame_count_;
+}
 
-  /* verify the existing frame count */
-  assert( frame_count_ == header( 24, 4 ).le32() );
+void IVFWriter::flush()
+{
+  if ( not buffered_frames_.empty() ) {
+    write_out( Chunk( nullptr, 0 ), Chunk( nullptr, 0 ) );
+  }
 
-  /* verify the existing file size */
-  assert( file_size_ == fd_.size() );
+  update_frame_count( true );
+}
 
+size_t IVFWriter::append_frame( const Chunk& chunk,
+                                const optional<uint64_t> pts )
+{
   /* build the frame header */
   SafeArray<uint8_t, IVF::frame_header_len> new_header;
   zero( new_header );
   memcpy_le32( &new_header.at( 0 ), chunk.size() );
+  memcpy_le64( &new_header.at( 4 ), pts.value_or( frame_count_ ) );
 
-  /* XXX does not include presentation timestamp */
-
-  /* append the frame header to the file */
-  fd_.write( Chunk( &new_header.at( 0 ), new_header.size() ) );
-  file_size_ += new_header.size();
-  size_t written_offset = file_size_;
-
-  /* append the frame to the file */
-  fd_.write( chunk );
-  file_size_ += chunk.size();
+  const Chunk frame_header( &new_header.at( 0 ), new_header.size() );
+  const size_t written_offset = file_size_ + frame_header.size();
 
-  /* verify the new file size */
-  assert( fd_.size() == file_size_ );
-
-  /* increment the frame count in the file's header */
+  file_size_ += frame_header.size() + chunk.size();
   frame_count_++;
-  memcpy_le32( mutable_header_ptr + 24, frame_count_ );
 
-  /* verify the new frame count */
-  assert( frame_count_ == header( 24, 4 ).le32() );
+  if ( buffered_frames_.size() + frame_header.size() + chunk.size()
+       <= max_buffered_bytes_ ) {
+    /* keep it for later */
+    buffered_frames_.append(
+      reinterpret_cast<const char*>( frame_header.buffer() ),
+      frame_header.size() );
+    buffered_frames_.append( reinterpret_cast<const char*>( chunk.buffer() ),
+                             chunk.size() );
+  } else {
+    write_out( frame_header, chunk );
+    update_frame_count( false );
+  }
 
   return written_offset;
 }
@@ -29,18 +29,40 @@
 #ifndef IVF_WRITER_HH
 #define IVF_WRITER_HH
 
+#include <optional>
+#include <string>
+
 #include "ivf.hh"
+#include "mmap_region.hh"
+
+/* By default every frame is written as soon as it is appended (frame header
+   and payload in one writev), and the header's frame count is kept exact.
+   set_buffering() instead accumulates small frames in memory and writes
+   them out together, and refreshes the frame count in the header only
+   every few frames; flush() (or destruction) brings the file fully up to
+   date. */
 
 class IVFWriter
 {
 private:
   FileDescriptor fd_;
-  uint64_t file_size_;
-  uint32_t frame_count_;
+  std::optional<MMap_Region> header_in_mem_ {};
+
+  uint64_t file_size_;   /* including buffered frames */
+  uint32_t frame_count_; /* including buffered frames */
+  uint32_t written_frame_count_ { 0 };
+  uint32_t header_frame_count_ { 0 };
 
   uint16_t width_;
   uint16_t height_;
 
+  size_t max_buffered_bytes_ { 0 };
+  uint32_t header_update_interval_ { 1 };
+  std::string buffered_frames_ {};
+
+  void write_out( const Chunk& frame_header, const Chunk& frame );
+  void update_frame_count( const bool force );
+
 public:
   IVFWriter( const std::string& filename,
              const std::string& fourcc,
@@ -56,7 +78,20 @@ public:
              const uint32_t frame_rate,
              const uint32_t time_scale );
 
-  size_t append_frame( const Chunk& chunk );
+  ~IVFWriter();
+
+  /* forbid copying */
+  IVFWriter( const IVFWriter& other ) = delete;
+  IVFWriter& operator=( const IVFWriter& other ) = delete;
+
+  /* returns the offset of the frame in the file; the presentation
+     timestamp defaults to the frame number */
+  size_t append_frame( const Chunk& chunk,
+                       const std::optional<uint64_t> pts = {} );
+
+  void set_buffering( const size_t max_buffered_bytes,
+                      const uint32_t header_update_interval );
+  void flush();
 
   void set_expected_decoder_entry_hash(
     const uint32_t minihash ); /* ExCamera invention */
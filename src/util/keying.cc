@@ -127,9 +127,18 @@ const vector<double>& KeyingOperation::get_key_color( const RGBRaster& raster,
 void KeyingOperation::process_rows( RGBRaster& raster,
                                     const uint16_t row_start_idx,
                                     const uint16_t row_end_idx )
+{
+  process_region( raster, row_start_idx, row_end_idx, 0, raster.width() );
+}
+
+void KeyingOperation::process_region( RGBRaster& raster,
+                                      const uint16_t row_start_idx,
+                                      const uint16_t row_end_idx,
+                                      const uint16_t col_start_idx,
+                                      const uint16_t col_end_idx )
 {
   for ( int row = row_start_idx; row < row_end_idx; row++ ) {
-    for ( int col = 0; col < raster.width(); col++ ) {
+    for ( int col = col_start_idx; col < col_end_idx; col++ ) {
       double r = raster.R().at( col, row );
       double g = raster.G().at( col, row );
       double b = raster.B().at( col, row );
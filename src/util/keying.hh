@@ -51,6 +51,11 @@ public:
   void process_rows( RGBRaster& raster,
                      const uint16_t row_start_idx,
                      const uint16_t row_end_idx );
+  void process_region( RGBRaster& raster,
+                       const uint16_t row_start_idx,
+                       const uint16_t row_end_idx,
+                       const uint16_t col_start_idx,
+                       const uint16_t col_end_idx );
 };
 
 #endif /* KEYING_HH */
@@ -1,13 +1,22 @@
 /* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
 
 #include <cmath>
+#include <cstring>
 #include <iostream>
 
 #include "keying_clip.hh"
 
 using namespace std;
 
-double KeyingClipOperation::process_pixel( TwoD<uint8_t>& mask, int x, int y )
+KeyingClipOperation::KeyingClipOperation( const uint16_t width,
+                                          const uint16_t height )
+  : width_( width )
+  , height_( height )
+{}
+
+double KeyingClipOperation::process_pixel( const TwoD<uint8_t>& mask,
+                                           int x,
+                                           int y )
 {
   const double alpha = mask.at( x, y ) / 255.;
   bool within_tolerance = false;
@@ -54,17 +63,41 @@ double KeyingClipOperation::process_pixel( TwoD<uint8_t>& mask, int x, int y )
   return output;
 }
 
-void KeyingClipOperation::process_rows( TwoD<uint8_t>& mask,
-                                        const uint16_t row_start_idx,
-                                        const uint16_t row_end_idx )
+void KeyingClipOperation::process_rows_intermediate(
+  const TwoD<uint8_t>& mask,
+  const uint16_t row_start_idx,
+  const uint16_t row_end_idx )
+{
+  process_region_intermediate(
+    mask, row_start_idx, row_end_idx, 0, mask.width() );
+}
+
+void KeyingClipOperation::process_region_intermediate(
+  const TwoD<uint8_t>& mask,
+  const uint16_t row_start_idx,
+  const uint16_t row_end_idx,
+  const uint16_t col_start_idx,
+  const uint16_t col_end_idx )
 {
   if ( clip_black_ == 0 && clip_white_ == 1 ) {
     return;
   }
   for ( size_t row = row_start_idx; row < row_end_idx; row++ ) {
-    for ( size_t col = 0; col < mask.width(); col++ ) {
+    for ( size_t col = col_start_idx; col < col_end_idx; col++ ) {
       const double alpha = process_pixel( mask, col, row );
-      mask.at( col, row ) = alpha * 255;
+      clipped_mask_.at( col, row ) = alpha * 255;
     }
   }
 }
+
+void KeyingClipOperation::process_rows_final( TwoD<uint8_t>& mask,
+                                              const uint16_t row_start_idx,
+                                              const uint16_t row_end_idx )
+{
+  if ( clip_black_ == 0 && clip_white_ == 1 ) {
+    return;
+  }
+  for ( size_t row = row_start_idx; row < row_end_idx; row++ ) {
+    memcpy( &mask.at( 0, row ), &clipped_mask_.at( 0, row ), mask.width() );
+  }
+}
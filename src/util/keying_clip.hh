@@ -8,24 +8,39 @@
 class KeyingClipOperation
 {
 private:
+  uint16_t width_, height_;
   uint8_t kernel_radius_ { 0 };
   double kernel_tolerance_ { 0.1 };
   double clip_black_ { 0. };
   double clip_white_ { 1. };
+  TwoD<uint8_t> clipped_mask_ { width_, height_ };
 
-  double process_pixel( TwoD<uint8_t>& mask, int x, int y );
+  double process_pixel( const TwoD<uint8_t>& mask, int x, int y );
 
 public:
+  KeyingClipOperation( const uint16_t width, const uint16_t height );
   void set_kernel_radius( const uint8_t radius ) { kernel_radius_ = radius; }
+  uint8_t kernel_radius() const { return kernel_radius_; }
   void set_kernel_tolerance( const double tolerance )
   {
     kernel_tolerance_ = tolerance;
   }
   void set_clip_black( const double clip_black ) { clip_black_ = clip_black; }
   void set_clip_white( const double clip_white ) { clip_white_ = clip_white; }
-  void process_rows( TwoD<uint8_t>& mask,
-                     const uint16_t row_start_idx,
-                     const uint16_t row_end_idx );
+  TwoD<uint8_t>& clipped_mask() { return clipped_mask_; }
+  // The kernel reads neighbouring pixels, so the clipped values are written
+  // to a separate mask, then copied back once every row has been clipped
+  void process_rows_intermediate( const TwoD<uint8_t>& mask,
+                                  const uint16_t row_start_idx,
+                                  const uint16_t row_end_idx );
+  void process_region_intermediate( const TwoD<uint8_t>& mask,
+                                    const uint16_t row_start_idx,
+                                    const uint16_t row_end_idx,
+                                    const uint16_t col_start_idx,
+                                    const uint16_t col_end_idx );
+  void process_rows_final( TwoD<uint8_t>& mask,
+                           const uint16_t row_start_idx,
+                           const uint16_t row_end_idx );
 };
 
 #endif /* KEYING_CLIP_HH */
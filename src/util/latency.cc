@@ -0,0 +1,220 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "latency.hh"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+class Histogram
+{
+public:
+  static constexpr unsigned int SUB_BUCKET_BITS = 5;
+  static constexpr unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static constexpr unsigned int MAX_EXPONENT = 40;
+  static constexpr unsigned int BUCKET_COUNT
+    = SUB_BUCKETS * ( MAX_EXPONENT - SUB_BUCKET_BITS + 2 );
+
+private:
+  /* written only by the owning thread; atomic so other threads can read
+     them while it records */
+  array<atomic<uint64_t>, BUCKET_COUNT> counts_ {};
+  atomic<uint64_t> count_ { 0 };
+  atomic<uint64_t> sum_ { 0 };
+  atomic<uint64_t> max_ { 0 };
+
+  static void increment( atomic<uint64_t>& value, const uint64_t amount )
+  {
+    value.store( value.load( memory_order_relaxed ) + amount,
+                 memory_order_relaxed );
+  }
+
+public:
+  static unsigned int bucket( uint64_t value )
+  {
+    if ( value < SUB_BUCKETS ) {
+      return value;
+    }
+
+    value = min( value, ( uint64_t { 2 } << MAX_EXPONENT ) - 1 );
+    const unsigned int exponent = 63 - __builtin_clzll( value );
+    const unsigned int shift = exponent - SUB_BUCKET_BITS;
+    return SUB_BUCKETS * ( shift + 1 ) + ( value >> shift ) - SUB_BUCKETS;
+  }
+
+  // The highest value that falls into `index`
+  static uint64_t bucket_ceiling( const unsigned int index )
+  {
+    if ( index < SUB_BUCKETS ) {
+      return index;
+    }
+
+    const unsigned int shift = index / SUB_BUCKETS - 1;
+    const uint64_t lowest = uint64_t { SUB_BUCKETS + index % SUB_BUCKETS }
+                            << shift;
+    return lowest + ( uint64_t { 1 } << shift ) - 1;
+  }
+
+  void record( const uint64_t value )
+  {
+    increment( counts_[bucket( value )], 1 );
+    increment( count_, 1 );
+    increment( sum_, value );
+    if ( value > max_.load( memory_order_relaxed ) ) {
+      max_.store( value, memory_order_relaxed );
+    }
+  }
+
+  void add_to( vector<uint64_t>& counts,
+               uint64_t& count,
+               uint64_t& sum,
+               uint64_t& max_value ) const
+  {
+    for ( unsigned int i = 0; i < BUCKET_COUNT; i++ ) {
+      counts[i] += counts_[i].load( memory_order_relaxed );
+    }
+    count += count_.load( memory_order_relaxed );
+    sum += sum_.load( memory_order_relaxed );
+    max_value = max( max_value, max_.load( memory_order_relaxed ) );
+  }
+};
+
+struct ThreadHistograms
+{
+  array<Histogram, latency::STAGE_COUNT> stages {};
+};
+
+/* histograms outlive their threads, so samples from finished threads still
+   count; the registry is never destroyed so it is usable at exit */
+struct Registry
+{
+  mutex lock {};
+  vector<unique_ptr<ThreadHistograms>> threads {};
+};
+
+Registry& registry()
+{
+  static Registry* const instance = new Registry;
+  return *instance;
+}
+
+ThreadHistograms& thread_histograms()
+{
+  thread_local ThreadHistograms* histograms = nullptr;
+
+  if ( not histograms ) {
+    Registry& all = registry();
+    lock_guard<mutex> lock( all.lock );
+    all.threads.push_back( make_unique<ThreadHistograms>() );
+    histograms = all.threads.back().get();
+  }
+
+  return *histograms;
+}
+
+}
+
+namespace latency {
+
+const char* stage_name( const Stage stage )
+{
+  static const char* const names[STAGE_COUNT]
+    = { "capture",   "convert",   "keying", "keying_clip", "dilate_erode",
+        "despill",   "chromakey", "composite", "upload",   "swap" };
+  return names[static_cast<unsigned int>( stage )];
+}
+
+uint64_t now_ns()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(
+           chrono::steady_clock::now().time_since_epoch() )
+    .count();
+}
+
+void record( const Stage stage, const uint64_t duration_ns )
+{
+  thread_histograms()
+    .stages[static_cast<unsigned int>( stage )]
+    .record( duration_ns );
+}
+
+Summary summarize( const Stage stage )
+{
+  vector<uint64_t> counts( Histogram::BUCKET_COUNT );
+  uint64_t count = 0, sum = 0, max_value = 0;
+
+  {
+    Registry& all = registry();
+    lock_guard<mutex> lock( all.lock );
+    for ( const auto& thread : all.threads ) {
+      thread->stages[static_cast<unsigned int>( stage )].add_to(
+        counts, count, sum, max_value );
+    }
+  } // End of lock scope
+
+  Summary summary { count, count ? sum / count : 0, 0, 0, max_value };
+
+  /* the buckets may be a little ahead of `count` if a thread is recording */
+  const uint64_t p50_rank = ( count + 1 ) / 2;
+  const uint64_t p99_rank = count - count / 100;
+  uint64_t seen = 0;
+  bool p50_found = false;
+  for ( unsigned int i = 0; i < Histogram::BUCKET_COUNT; i++ ) {
+    if ( counts[i] == 0 ) {
+      continue;
+    }
+    seen += counts[i];
+    const uint64_t ceiling = min( Histogram::bucket_ceiling( i ), max_value );
+    if ( not p50_found and seen >= p50_rank ) {
+      summary.p50_ns = ceiling;
+      p50_found = true;
+    }
+    if ( seen >= p99_rank ) {
+      summary.p99_ns = ceiling;
+      break;
+    }
+  }
+
+  return summary;
+}
+
+void dump( ostream& out )
+{
+  const ios::fmtflags flags = out.flags();
+  out << fixed << setprecision( 1 );
+
+  for ( unsigned int i = 0; i < STAGE_COUNT; i++ ) {
+    const Stage stage = static_cast<Stage>( i );
+    const Summary summary = summarize( stage );
+    if ( summary.count == 0 ) {
+      continue;
+    }
+
+    out << left << setw( 13 ) << stage_name( stage ) << right
+        << " n=" << summary.count << " mean=" << summary.mean_ns / 1000.0
+        << "us p50=" << summary.p50_ns / 1000.0
+        << "us p99=" << summary.p99_ns / 1000.0
+        << "us max=" << summary.max_ns / 1000.0 << "us\n";
+  }
+
+  out.flags( flags );
+  out.flush();
+}
+
+void dump_at_exit()
+{
+  static once_flag registered;
+  call_once( registered, [] { atexit( [] { dump( cerr ); } ); } );
+}
+
+}
@@ -0,0 +1,85 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef LATENCY_HH
+#define LATENCY_HH
+
+#include <cstdint>
+#include <ostream>
+
+/* Per-stage latency histograms for the frame pipeline.
+
+   Each thread records into its own set of histograms, so recording is a
+   few relaxed stores with no locking or shared cache lines. The buckets are
+   log-linear (HDR-style): 32 linear sub-buckets per power of two, so any
+   value is reported within about 3%, from 1 ns up to 2^41 ns (about 36
+   minutes); longer values are counted in the top bucket.
+   summarize() merges every thread's histograms and can run at any time
+   while other threads are recording. */
+
+namespace latency {
+
+enum class Stage : uint8_t
+{
+  Capture,     // camera buffer dequeued -> picked up by the pipeline
+  Convert,     // camera buffer -> RGB raster
+  Keying,      // ChromaKey stages, per worker and pass
+  KeyingClip,
+  DilateErode,
+  Despill,
+  ChromaKey,   // start_create_mask() -> wait_for_mask() returns
+  Composite,
+  Upload,      // raster -> GL textures
+  Swap,
+
+  Count
+};
+
+constexpr unsigned int STAGE_COUNT = static_cast<unsigned int>( Stage::Count );
+
+const char* stage_name( const Stage stage );
+
+// steady_clock, in nanoseconds
+uint64_t now_ns();
+
+void record( const Stage stage, const uint64_t duration_ns );
+
+// Records the time from construction to destruction
+class ScopedTimer
+{
+private:
+  Stage stage_;
+  uint64_t start_ns_;
+
+public:
+  explicit ScopedTimer( const Stage stage )
+    : stage_( stage )
+    , start_ns_( now_ns() )
+  {}
+
+  ~ScopedTimer() { record( stage_, now_ns() - start_ns_ ); }
+
+  /* forbid copying */
+  ScopedTimer( const ScopedTimer& other ) = delete;
+  ScopedTimer& operator=( const ScopedTimer& other ) = delete;
+};
+
+struct Summary
+{
+  uint64_t count;
+  uint64_t mean_ns;
+  uint64_t p50_ns;
+  uint64_t p99_ns;
+  uint64_t max_ns;
+};
+
+Summary summarize( const Stage stage );
+
+// One line per stage that has samples, in microseconds
+void dump( std::ostream& out );
+
+// Dumps to stderr when the process exits normally
+void dump_at_exit();
+
+}
+
+#endif /* LATENCY_HH */
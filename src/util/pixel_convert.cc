@@ -0,0 +1,695 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "pixel_convert.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+static constexpr int FRAC_BITS = 13;
+static constexpr int ROUND = 1 << ( FRAC_BITS - 1 );
+
+struct Coefficients
+{
+  int luma_offset;
+  int y, rv, gu, gv, bu;
+};
+
+/* 255 * inv([219*[.587 .114 .299]' 224*[-.331 .500 -.169]'
+              224*[-.419 -.081 .5]']'), scaled by 2^13 */
+static constexpr Coefficients LIMITED_RANGE {
+  16,
+  9539,  /* 1.16438356164384 */
+  13072, /* 1.59567019581339 */
+  3205,  /* 0.391260370716072 */
+  6660,  /* 0.813004933873461 */
+  16527  /* 2.01741475897078 */
+};
+
+/* JFIF (full-range) Y'CbCr, as stored in JPEG files */
+static constexpr Coefficients FULL_RANGE {
+  0,
+  8192,  /* 1.0 */
+  11485, /* 1.402 */
+  2819,  /* 0.344136 */
+  5850,  /* 0.714136 */
+  14516  /* 1.772 */
+};
+
+static inline uint8_t clamp_pixel( const int value )
+{
+  return value < 0 ? 0 : ( value > 255 ? 255 : value );
+}
+
+static inline void yuv_to_rgb_pixel( const uint8_t y,
+                                     const uint8_t u,
+                                     const uint8_t v,
+                                     uint8_t& r,
+                                     uint8_t& g,
+                                     uint8_t& b,
+                                     const Coefficients& k = LIMITED_RANGE )
+{
+  const int luma = k.y * ( y - k.luma_offset ) + ROUND;
+  const int cb = u - 128;
+  const int cr = v - 128;
+
+  r = clamp_pixel( ( luma + k.rv * cr ) >> FRAC_BITS );
+  g = clamp_pixel( ( luma - k.gu * cb - k.gv * cr ) >> FRAC_BITS );
+  b = clamp_pixel( ( luma + k.bu * cb ) >> FRAC_BITS );
+}
+
+/* scalar kernels, also used for the tail of each row */
+
+void pixel_convert::reference::yuyv_row_to_planar( const uint8_t* src,
+                                                   uint8_t* y,
+                                                   uint8_t* u,
+                                                   uint8_t* v,
+                                                   const unsigned int width )
+{
+  for ( unsigned int col = 0; col < width; col++ ) {
+    y[col] = src[2 * col];
+  }
+
+  if ( u and v ) {
+    for ( unsigned int col = 0; col < width / 2; col++ ) {
+      u[col] = src[4 * col + 1];
+      v[col] = src[4 * col + 3];
+    }
+  }
+}
+
+void pixel_convert::reference::uv_row_to_planar(
+  const uint8_t* src,
+  uint8_t* u,
+  uint8_t* v,
+  const unsigned int chroma_width )
+{
+  for ( unsigned int col = 0; col < chroma_width; col++ ) {
+    u[col] = src[2 * col];
+    v[col] = src[2 * col + 1];
+  }
+}
+
+void pixel_convert::reference::yuv422_row_to_rgb( const uint8_t* y,
+                                                  const uint8_t* u,
+                                                  const uint8_t* v,
+                                                  uint8_t* r,
+                                                  uint8_t* g,
+                                                  uint8_t* b,
+                                                  const unsigned int width,
+                                                  const bool full_range )
+{
+  const Coefficients& k = full_range ? FULL_RANGE : LIMITED_RANGE;
+
+  for ( unsigned int col = 0; col < width; col++ ) {
+    yuv_to_rgb_pixel(
+      y[col], u[col / 2], v[col / 2], r[col], g[col], b[col], k );
+  }
+}
+
+void pixel_convert::reference::yuv444_row_to_rgb( const uint8_t* y,
+                                                  const uint8_t* u,
+                                                  const uint8_t* v,
+                                                  uint8_t* r,
+                                                  uint8_t* g,
+                                                  uint8_t* b,
+                                                  const unsigned int width )
+{
+  for ( unsigned int col = 0; col < width; col++ ) {
+    yuv_to_rgb_pixel( y[col], u[col], v[col], r[col], g[col], b[col] );
+  }
+}
+
+void pixel_convert::reference::nv12_row_to_rgb( const uint8_t* y,
+                                                const uint8_t* uv,
+                                                uint8_t* r,
+                                                uint8_t* g,
+                                                uint8_t* b,
+                                                const unsigned int width )
+{
+  for ( unsigned int col = 0; col < width; col++ ) {
+    yuv_to_rgb_pixel( y[col],
+                      uv[( col / 2 ) * 2],
+                      uv[( col / 2 ) * 2 + 1],
+                      r[col],
+                      g[col],
+                      b[col] );
+  }
+}
+
+void pixel_convert::reference::yuyv_row_to_rgb( const uint8_t* src,
+                                                uint8_t* r,
+                                                uint8_t* g,
+                                                uint8_t* b,
+                                                const unsigned int width )
+{
+  for ( unsigned int col = 0; col < width; col++ ) {
+    yuv_to_rgb_pixel( src[2 * col],
+                      src[( col / 2 ) * 4 + 1],
+                      src[( col / 2 ) * 4 + 3],
+                      r[col],
+                      g[col],
+                      b[col] );
+  }
+}
+
+void pixel_convert::reference::rgb_row_to_rgba( const uint8_t* r,
+                                                const uint8_t* g,
+                                                const uint8_t* b,
+                                                uint8_t* rgba,
+                                                const unsigned int width )
+{
+  for ( unsigned int col = 0; col < width; col++ ) {
+    rgba[4 * col] = r[col];
+    rgba[4 * col + 1] = g[col];
+    rgba[4 * col + 2] = b[col];
+    rgba[4 * col + 3] = 255;
+  }
+}
+
+#ifdef __SSE2__
+
+static constexpr unsigned int VECTOR_WIDTH = 16;
+
+static inline __m128i load( const uint8_t* src )
+{
+  return _mm_loadu_si128( reinterpret_cast<const __m128i*>( src ) );
+}
+
+static inline void store( uint8_t* dst, const __m128i value )
+{
+  _mm_storeu_si128( reinterpret_cast<__m128i*>( dst ), value );
+}
+
+static inline void store_low( uint8_t* dst, const __m128i value )
+{
+  _mm_storel_epi64( reinterpret_cast<__m128i*>( dst ), value );
+}
+
+/* two int16 coefficients per 32-bit lane, for use with _mm_madd_epi16 */
+static inline __m128i coefficient_pair( const int low, const int high )
+{
+  return _mm_set1_epi32( static_cast<int>(
+    static_cast<uint16_t>( low )
+    | ( static_cast<uint32_t>( static_cast<uint16_t>( high ) ) << 16 ) ) );
+}
+
+/* splits 32 bytes of interleaved pairs into 16 even and 16 odd bytes */
+static inline void deinterleave( const __m128i a,
+                                 const __m128i b,
+                                 __m128i& even,
+                                 __m128i& odd )
+{
+  const __m128i low_bytes = _mm_set1_epi16( 0x00ff );
+  even = _mm_packus_epi16( _mm_and_si128( a, low_bytes ),
+                           _mm_and_si128( b, low_bytes ) );
+  odd = _mm_packus_epi16( _mm_srli_epi16( a, 8 ), _mm_srli_epi16( b, 8 ) );
+}
+
+/* converts 8 pixels held as int16 (Y' - offset, Cb - 128, Cr - 128) */
+static inline void convert8( const __m128i y,
+                             const __m128i u,
+                             const __m128i v,
+                             __m128i& r,
+                             __m128i& g,
+                             __m128i& b,
+                             const Coefficients& k )
+{
+  const __m128i one = _mm_set1_epi16( 1 );
+  const __m128i luma_coefficients = coefficient_pair( k.y, ROUND );
+  const __m128i r_coefficients = coefficient_pair( 0, k.rv );
+  const __m128i g_coefficients = coefficient_pair( -k.gu, -k.gv );
+  const __m128i b_coefficients = coefficient_pair( k.bu, 0 );
+
+  const __m128i luma_lo
+    = _mm_madd_epi16( _mm_unpacklo_epi16( y, one ), luma_coefficients );
+  const __m128i luma_hi
+    = _mm_madd_epi16( _mm_unpackhi_epi16( y, one ), luma_coefficients );
+  const __m128i chroma_lo = _mm_unpacklo_epi16( u, v );
+  const __m128i chroma_hi = _mm_unpackhi_epi16( u, v );
+
+  auto channel = [&]( const __m128i coefficients ) {
+    const __m128i lo = _mm_srai_epi32(
+      _mm_add_epi32( luma_lo, _mm_madd_epi16( chroma_lo, coefficients ) ),
+      FRAC_BITS );
+    const __m128i hi = _mm_srai_epi32(
+      _mm_add_epi32( luma_hi, _mm_madd_epi16( chroma_hi, coefficients ) ),
+      FRAC_BITS );
+    return _mm_packs_epi32( lo, hi );
+  };
+
+  r = channel( r_coefficients );
+  g = channel( g_coefficients );
+  b = channel( b_coefficients );
+}
+
+/* converts 16 pixels of 8-bit Y', Cb and Cr (chroma already upsampled) */
+static inline void convert16( const __m128i y,
+                              const __m128i u,
+                              const __m128i v,
+                              uint8_t* r,
+                              uint8_t* g,
+                              uint8_t* b,
+                              const Coefficients& k = LIMITED_RANGE )
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i luma_offset = _mm_set1_epi16( k.luma_offset );
+  const __m128i chroma_offset = _mm_set1_epi16( 128 );
+
+  __m128i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+
+  convert8(
+    _mm_sub_epi16( _mm_unpacklo_epi8( y, zero ), luma_offset ),
+    _mm_sub_epi16( _mm_unpacklo_epi8( u, zero ), chroma_offset ),
+    _mm_sub_epi16( _mm_unpacklo_epi8( v, zero ), chroma_offset ),
+    r_lo,
+    g_lo,
+    b_lo,
+    k );
+
+  convert8(
+    _mm_sub_epi16( _mm_unpackhi_epi8( y, zero ), luma_offset ),
+    _mm_sub_epi16( _mm_unpackhi_epi8( u, zero ), chroma_offset ),
+    _mm_sub_epi16( _mm_unpackhi_epi8( v, zero ), chroma_offset ),
+    r_hi,
+    g_hi,
+    b_hi,
+    k );
+
+  store( r, _mm_packus_epi16( r_lo, r_hi ) );
+  store( g, _mm_packus_epi16( g_lo, g_hi ) );
+  store( b, _mm_packus_epi16( b_lo, b_hi ) );
+}
+
+void pixel_convert::yuyv_row_to_planar( const uint8_t* src,
+                                        uint8_t* y,
+                                        uint8_t* u,
+                                        uint8_t* v,
+                                        const unsigned int width )
+{
+  const __m128i zero = _mm_setzero_si128();
+  unsigned int col = 0;
+
+  for ( ; col + VECTOR_WIDTH <= width; col += VECTOR_WIDTH ) {
+    __m128i luma, chroma;
+    deinterleave( load( src + 2 * col ),
+                  load( src + 2 * col + VECTOR_WIDTH ),
+                  luma,
+                  chroma );
+    store( y + col, luma );
+
+    if ( u and v ) {
+      __m128i cb, cr;
+      deinterleave( chroma, zero, cb, cr );
+      store_low( u + col / 2, cb );
+      store_low( v + col / 2, cr );
+    }
+  }
+
+  reference::yuyv_row_to_planar( src + 2 * col,
+                                 y + col,
+                                 u ? u + col / 2 : nullptr,
+                                 v ? v + col / 2 : nullptr,
+                                 width - col );
+}
+
+void pixel_convert::uv_row_to_planar( const uint8_t* src,
+                                      uint8_t* u,
+                                      uint8_t* v,
+                                      const unsigned int chroma_width )
+{
+  unsigned int col = 0;
+
+  for ( ; col + VECTOR_WIDTH <= chroma_width; col += VECTOR_WIDTH ) {
+    __m128i cb, cr;
+    deinterleave(
+      load( src + 2 * col ), load( src + 2 * col + VECTOR_WIDTH ), cb, cr );
+    store( u + col, cb );
+    store( v + col, cr );
+  }
+
+  reference::uv_row_to_planar(
+    src + 2 * col, u + col, v + col, chroma_width - col );
+}
+
+void pixel_convert::yuv422_row_to_rgb( const uint8_t* y,
+                                       const uint8_t* u,
+                                       const uint8_t* v,
+                                       uint8_t* r,
+                                       uint8_t* g,
+                                       uint8_t* b,
+                                       const unsigned int width,
+                                       const bool full_range )
+{
+  const Coefficients& k = full_range ? FULL_RANGE : LIMITED_RANGE;
+  unsigned int col = 0;
+
+  for ( ; col + VECTOR_WIDTH <= width; col += VECTOR_WIDTH ) {
+    const __m128i cb = _mm_loadl_epi64(
+      reinterpret_cast<const __m128i*>( u + col / 2 ) );
+    const __m128i cr = _mm_loadl_epi64(
+      reinterpret_cast<const __m128i*>( v + col / 2 ) );
+    convert16( load( y + col ),
+               _mm_unpacklo_epi8( cb, cb ),
+               _mm_unpacklo_epi8( cr, cr ),
+               r + col,
+               g + col,
+               b + col,
+               k );
+  }
+
+  reference::yuv422_row_to_rgb( y + col,
+                                u + col / 2,
+                                v + col / 2,
+                                r + col,
+                                g + col,
+                                b + col,
+                                width - col,
+                                full_range );
+}
+
+void pixel_convert::yuv444_row_to_rgb( const uint8_t* y,
+                                       const uint8_t* u,
+                                       const uint8_t* v,
+                                       uint8_t* r,
+                                       uint8_t* g,
+                                       uint8_t* b,
+                                       const unsigned int width )
+{
+  unsigned int col = 0;
+
+  for ( ; col + VECTOR_WIDTH <= width; col += VECTOR_WIDTH ) {
+    convert16( load( y + col ),
+               load( u + col ),
+               load( v + col ),
+               r + col,
+               g + col,
+               b + col );
+  }
+
+  reference::yuv444_row_to_rgb(
+    y + col, u + col, v + col, r + col, g + col, b + col, width - col );
+}
+
+void pixel_convert::nv12_row_to_rgb( const uint8_t* y,
+                                     const uint8_t* uv,
+                                     uint8_t* r,
+                                     uint8_t* g,
+                                     uint8_t* b,
+                                     const unsigned int width )
+{
+  const __m128i zero = _mm_setzero_si128();
+  unsigned int col = 0;
+
+  for ( ; col + VECTOR_WIDTH <= width; col += VECTOR_WIDTH ) {
+    __m128i cb, cr;
+    deinterleave( load( uv + col ), zero, cb, cr );
+    convert16( load( y + col ),
+               _mm_unpacklo_epi8( cb, cb ),
+               _mm_unpacklo_epi8( cr, cr ),
+               r + col,
+               g + col,
+               b + col );
+  }
+
+  reference::nv12_row_to_rgb(
+    y + col, uv + col, r + col, g + col, b + col, width - col );
+}
+
+void pixel_convert::yuyv_row_to_rgb( const uint8_t* src,
+                                     uint8_t* r,
+                                     uint8_t* g,
+                                     uint8_t* b,
+                                     const unsigned int width )
+{
+  const __m128i zero = _mm_setzero_si128();
+  unsigned int col = 0;
+
+  for ( ; col + VECTOR_WIDTH <= width; col += VECTOR_WIDTH ) {
+    __m128i luma, chroma, cb, cr;
+    deinterleave( load( src + 2 * col ),
+                  load( src + 2 * col + VECTOR_WIDTH ),
+                  luma,
+                  chroma );
+    deinterleave( chroma, zero, cb, cr );
+    convert16( luma,
+               _mm_unpacklo_epi8( cb, cb ),
+               _mm_unpacklo_epi8( cr, cr ),
+               r + col,
+               g + col,
+               b + col );
+  }
+
+  reference::yuyv_row_to_rgb(
+    src + 2 * col, r + col, g + col, b + col, width - col );
+}
+
+void pixel_convert::rgb_row_to_rgba( const uint8_t* r,
+                                     const uint8_t* g,
+                                     const uint8_t* b,
+                                     uint8_t* rgba,
+                                     const unsigned int width )
+{
+  const __m128i opaque = _mm_set1_epi8( -1 );
+  unsigned int col = 0;
+
+  for ( ; col + VECTOR_WIDTH <= width; col += VECTOR_WIDTH ) {
+    const __m128i red = load( r + col );
+    const __m128i green = load( g + col );
+    const __m128i blue = load( b + col );
+
+    const __m128i rg_low = _mm_unpacklo_epi8( red, green );
+    const __m128i rg_high = _mm_unpackhi_epi8( red, green );
+    const __m128i ba_low = _mm_unpacklo_epi8( blue, opaque );
+    const __m128i ba_high = _mm_unpackhi_epi8( blue, opaque );
+
+    uint8_t* dst = rgba + 4 * col;
+    store( dst, _mm_unpacklo_epi16( rg_low, ba_low ) );
+    store( dst + VECTOR_WIDTH, _mm_unpackhi_epi16( rg_low, ba_low ) );
+    store( dst + 2 * VECTOR_WIDTH, _mm_unpacklo_epi16( rg_high, ba_high ) );
+    store( dst + 3 * VECTOR_WIDTH, _mm_unpackhi_epi16( rg_high, ba_high ) );
+  }
+
+  reference::rgb_row_to_rgba(
+    r + col, g + col, b + col, rgba + 4 * col, width - col );
+}
+
+#else /* no SSE2: the scalar kernels are the only implementation */
+
+void pixel_convert::yuyv_row_to_planar( const uint8_t* src,
+                                        uint8_t* y,
+                                        uint8_t* u,
+                                        uint8_t* v,
+                                        const unsigned int width )
+{
+  reference::yuyv_row_to_planar( src, y, u, v, width );
+}
+
+void pixel_convert::uv_row_to_planar( const uint8_t* src,
+                                      uint8_t* u,
+                                      uint8_t* v,
+                                      const unsigned int chroma_width )
+{
+  reference::uv_row_to_planar( src, u, v, chroma_width );
+}
+
+void pixel_convert::yuv422_row_to_rgb( const uint8_t* y,
+                                       const uint8_t* u,
+                                       const uint8_t* v,
+                                       uint8_t* r,
+                                       uint8_t* g,
+                                       uint8_t* b,
+                                       const unsigned int width,
+                                       const bool full_range )
+{
+  reference::yuv422_row_to_rgb( y, u, v, r, g, b, width, full_range );
+}
+
+void pixel_convert::yuv444_row_to_rgb( const uint8_t* y,
+                                       const uint8_t* u,
+                                       const uint8_t* v,
+                                       uint8_t* r,
+                                       uint8_t* g,
+                                       uint8_t* b,
+                                       const unsigned int width )
+{
+  reference::yuv444_row_to_rgb( y, u, v, r, g, b, width );
+}
+
+void pixel_convert::nv12_row_to_rgb( const uint8_t* y,
+                                     const uint8_t* uv,
+                                     uint8_t* r,
+                                     uint8_t* g,
+                                     uint8_t* b,
+                                     const unsigned int width )
+{
+  reference::nv12_row_to_rgb( y, uv, r, g, b, width );
+}
+
+void pixel_convert::yuyv_row_to_rgb( const uint8_t* src,
+                                     uint8_t* r,
+                                     uint8_t* g,
+                                     uint8_t* b,
+                                     const unsigned int width )
+{
+  reference::yuyv_row_to_rgb( src, r, g, b, width );
+}
+
+void pixel_convert::rgb_row_to_rgba( const uint8_t* r,
+                                     const uint8_t* g,
+                                     const uint8_t* b,
+                                     uint8_t* rgba,
+                                     const unsigned int width )
+{
+  reference::rgb_row_to_rgba( r, g, b, rgba, width );
+}
+
+#endif /* __SSE2__ */
+
+void pixel_convert::yuyv_to_yuv420( const uint8_t* src, BaseRaster& raster )
+{
+  const unsigned int width = raster.display_width();
+  const size_t src_stride = 2 * width;
+
+  for ( unsigned int row = 0; row < raster.display_height(); row++ ) {
+    /* 4:2:2 -> 4:2:0 by keeping the chroma of the even rows */
+    const bool chroma_row = ( row % 2 == 0 );
+    yuyv_row_to_planar( src + row * src_stride,
+                        &raster.Y().at( 0, row ),
+                        chroma_row ? &raster.U().at( 0, row / 2 ) : nullptr,
+                        chroma_row ? &raster.V().at( 0, row / 2 ) : nullptr,
+                        width );
+  }
+}
+
+void pixel_convert::nv12_to_yuv420( const uint8_t* src, BaseRaster& raster )
+{
+  const unsigned int width = raster.display_width();
+  const unsigned int height = raster.display_height();
+
+  for ( unsigned int row = 0; row < height; row++ ) {
+    memcpy( &raster.Y().at( 0, row ), src + row * width, width );
+  }
+
+  const uint8_t* src_chroma = src + width * height;
+  for ( unsigned int row = 0; row < raster.chroma_display_height(); row++ ) {
+    uv_row_to_planar( src_chroma + row * 2 * raster.chroma_display_width(),
+                      &raster.U().at( 0, row ),
+                      &raster.V().at( 0, row ),
+                      raster.chroma_display_width() );
+  }
+}
+
+void pixel_convert::yuyv_to_rgb( const uint8_t* src, RGBRaster& raster )
+{
+  const unsigned int width = raster.display_width();
+
+  for ( unsigned int row = 0; row < raster.display_height(); row++ ) {
+    yuyv_row_to_rgb( src + row * 2 * width,
+                     &raster.R().at( 0, row ),
+                     &raster.G().at( 0, row ),
+                     &raster.B().at( 0, row ),
+                     width );
+  }
+}
+
+void pixel_convert::nv12_to_rgb( const uint8_t* src, RGBRaster& raster )
+{
+  const unsigned int width = raster.display_width();
+  const unsigned int height = raster.display_height();
+  const uint8_t* src_chroma = src + width * height;
+  const size_t chroma_stride = 2 * raster.chroma_display_width();
+
+  for ( unsigned int row = 0; row < height; row++ ) {
+    nv12_row_to_rgb( src + row * width,
+                     src_chroma + ( row / 2 ) * chroma_stride,
+                     &raster.R().at( 0, row ),
+                     &raster.G().at( 0, row ),
+                     &raster.B().at( 0, row ),
+                     width );
+  }
+}
+
+void pixel_convert::yuv420_to_rgb( const uint8_t* src, RGBRaster& raster )
+{
+  const size_t y_plane_length
+    = raster.display_width() * raster.display_height();
+  const size_t chroma_plane_length
+    = raster.chroma_display_width() * raster.chroma_display_height();
+
+  planar_to_rgb( src,
+                 raster.display_width(),
+                 src + y_plane_length,
+                 src + y_plane_length + chroma_plane_length,
+                 raster.chroma_display_width(),
+                 true,
+                 raster );
+}
+
+void pixel_convert::planar_to_rgb( const uint8_t* y,
+                                   const size_t y_stride,
+                                   const uint8_t* u,
+                                   const uint8_t* v,
+                                   const size_t chroma_stride,
+                                   const bool chroma_subsampled_vertically,
+                                   RGBRaster& raster,
+                                   const bool full_range )
+{
+  for ( unsigned int row = 0; row < raster.display_height(); row++ ) {
+    const size_t chroma_row = chroma_subsampled_vertically ? row / 2 : row;
+    yuv422_row_to_rgb( y + row * y_stride,
+                       u + chroma_row * chroma_stride,
+                       v + chroma_row * chroma_stride,
+                       &raster.R().at( 0, row ),
+                       &raster.G().at( 0, row ),
+                       &raster.B().at( 0, row ),
+                       raster.display_width(),
+                       full_range );
+  }
+}
+
+void pixel_convert::rgb_to_yuv420( const RGBRaster& raster,
+                                   uint8_t* y,
+                                   uint8_t* u,
+                                   uint8_t* v )
+{
+  const unsigned int width = raster.display_width();
+  const unsigned int height = raster.display_height();
+
+  for ( unsigned int row = 0; row < height; row++ ) {
+    const uint8_t* r = &raster.R().at( 0, row );
+    const uint8_t* g = &raster.G().at( 0, row );
+    const uint8_t* b = &raster.B().at( 0, row );
+
+    for ( unsigned int col = 0; col < width; col++ ) {
+      *y++ = 16 + ( ( 66 * r[col] + 129 * g[col] + 25 * b[col] + 128 ) >> 8 );
+    }
+  }
+
+  /* odd-sized frames reuse the last row or column */
+  for ( unsigned int row = 0; row < height; row += 2 ) {
+    const unsigned int next_row = min( row + 1, height - 1 );
+
+    for ( unsigned int col = 0; col < width; col += 2 ) {
+      const unsigned int next_col = min( col + 1, width - 1 );
+
+      const auto sum = [&]( const TwoD<uint8_t>& plane ) {
+        return plane.at( col, row ) + plane.at( next_col, row )
+               + plane.at( col, next_row ) + plane.at( next_col, next_row );
+      };
+
+      /* the sums are 4x the average, hence the extra 2 bits of shift */
+      const int r = sum( raster.R() );
+      const int g = sum( raster.G() );
+      const int b = sum( raster.B() );
+
+      *u++ = 128 + ( ( -38 * r - 74 * g + 112 * b + 512 ) >> 10 );
+      *v++ = 128 + ( ( 112 * r - 94 * g - 18 * b + 512 ) >> 10 );
+    }
+  }
+}
@@ -0,0 +1,160 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+/* Pixel-format unpackers and Y'CbCr -> RGB converters.
+
+   Every row kernel has a scalar version (in pixel_convert::reference) and a
+   vectorized version that processes 16 pixels per iteration with SSE2 and
+   falls back to the scalar code for the remainder of the row. Both produce
+   bit-identical output.
+
+   Y'CbCr -> RGB uses the limited-range BT.601 (SMPTE 170M) matrix, the same
+   one the display shader uses, in 13-bit fixed point. Converters that can be
+   fed JPEG data also take full_range to use the JFIF matrix instead. Chroma
+   is upsampled by sample replication: horizontally for 4:2:2 and 4:2:0, and
+   vertically (row / 2) for 4:2:0; 4:4:4 needs no upsampling. */
+
+#ifndef PIXEL_CONVERT_HH
+#define PIXEL_CONVERT_HH
+
+#include <cstddef>
+#include <cstdint>
+
+#include "util/raster.hh"
+
+namespace pixel_convert {
+
+/* row kernels */
+
+// YUYV (Y0 U Y1 V) -> Y plane, and U/V planes at half width if non-null
+void yuyv_row_to_planar( const uint8_t* src,
+                         uint8_t* y,
+                         uint8_t* u,
+                         uint8_t* v,
+                         const unsigned int width );
+
+// interleaved UVUV (NV12 chroma plane) -> separate U/V planes
+void uv_row_to_planar( const uint8_t* src,
+                       uint8_t* u,
+                       uint8_t* v,
+                       const unsigned int chroma_width );
+
+// Y' plus half-width Cb/Cr -> RGB (one row of 4:2:2 or 4:2:0); y may be r
+void yuv422_row_to_rgb( const uint8_t* y,
+                        const uint8_t* u,
+                        const uint8_t* v,
+                        uint8_t* r,
+                        uint8_t* g,
+                        uint8_t* b,
+                        const unsigned int width,
+                        const bool full_range = false );
+
+// Y' plus full-width Cb/Cr -> RGB (one row of 4:4:4)
+void yuv444_row_to_rgb( const uint8_t* y,
+                        const uint8_t* u,
+                        const uint8_t* v,
+                        uint8_t* r,
+                        uint8_t* g,
+                        uint8_t* b,
+                        const unsigned int width );
+
+// Y' plus interleaved half-width CbCr -> RGB (one row of NV12)
+void nv12_row_to_rgb( const uint8_t* y,
+                      const uint8_t* uv,
+                      uint8_t* r,
+                      uint8_t* g,
+                      uint8_t* b,
+                      const unsigned int width );
+
+// YUYV -> RGB in a single pass
+void yuyv_row_to_rgb( const uint8_t* src,
+                      uint8_t* r,
+                      uint8_t* g,
+                      uint8_t* b,
+                      const unsigned int width );
+
+// separate R/G/B planes -> packed RGBA (alpha 255), e.g. for a GL upload
+void rgb_row_to_rgba( const uint8_t* r,
+                      const uint8_t* g,
+                      const uint8_t* b,
+                      uint8_t* rgba,
+                      const unsigned int width );
+
+/* whole-frame conversions from tightly packed camera buffers */
+
+void yuyv_to_yuv420( const uint8_t* src, BaseRaster& raster );
+void nv12_to_yuv420( const uint8_t* src, BaseRaster& raster );
+
+void yuyv_to_rgb( const uint8_t* src, RGBRaster& raster );
+void nv12_to_rgb( const uint8_t* src, RGBRaster& raster );
+void yuv420_to_rgb( const uint8_t* src, RGBRaster& raster );
+
+/* RGB -> tightly packed planar 4:2:0 (limited-range BT.601), with chroma
+   from the average of each 2x2 block; for recording program output */
+void rgb_to_yuv420( const RGBRaster& raster,
+                    uint8_t* y,
+                    uint8_t* u,
+                    uint8_t* v );
+
+/* planar 4:2:0 or 4:2:2 -> RGB with explicit plane strides */
+void planar_to_rgb( const uint8_t* y,
+                    const size_t y_stride,
+                    const uint8_t* u,
+                    const uint8_t* v,
+                    const size_t chroma_stride,
+                    const bool chroma_subsampled_vertically,
+                    RGBRaster& raster,
+                    const bool full_range = false );
+
+namespace reference {
+
+void yuyv_row_to_planar( const uint8_t* src,
+                         uint8_t* y,
+                         uint8_t* u,
+                         uint8_t* v,
+                         const unsigned int width );
+
+void uv_row_to_planar( const uint8_t* src,
+                       uint8_t* u,
+                       uint8_t* v,
+                       const unsigned int chroma_width );
+
+void yuv422_row_to_rgb( const uint8_t* y,
+                        const uint8_t* u,
+                        const uint8_t* v,
+                        uint8_t* r,
+                        uint8_t* g,
+                        uint8_t* b,
+                        const unsigned int width,
+                        const bool full_range = false );
+
+void yuv444_row_to_rgb( const uint8_t* y,
+                        const uint8_t* u,
+                        const uint8_t* v,
+                        uint8_t* r,
+                        uint8_t* g,
+                        uint8_t* b,
+                        const unsigned int width );
+
+void nv12_row_to_rgb( const uint8_t* y,
+                      const uint8_t* uv,
+                      uint8_t* r,
+                      uint8_t* g,
+                      uint8_t* b,
+                      const unsigned int width );
+
+void yuyv_row_to_rgb( const uint8_t* src,
+                      uint8_t* r,
+                      uint8_t* g,
+                      uint8_t* b,
+                      const unsigned int width );
+
+void rgb_row_to_rgba( const uint8_t* r,
+                      const uint8_t* g,
+                      const uint8_t* b,
+                      uint8_t* rgba,
+                      const unsigned int width );
+
+}
+}
+
+#endif /* PIXEL_CONVERT_HH */
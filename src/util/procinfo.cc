@@ -28,6 +28,8 @@
 
 #include "procinfo.hh"
 
+#include <unistd.h>
+
 #include <fstream>
 
 using namespace std;
@@ -39,3 +41,11 @@ size_t procinfo::memory_usage()
   fin >> v;
   return v * 4096 /* page size */;
 }
+
+size_t procinfo::resident_set_size()
+{
+  ifstream fin( "/proc/self/statm" );
+  size_t size, resident;
+  fin >> size >> resident;
+  return resident * sysconf( _SC_PAGESIZE );
+}
@@ -33,6 +33,9 @@
 
 namespace procinfo {
 size_t memory_usage();
+
+// Bytes of the process's memory that are resident in RAM
+size_t resident_set_size();
 }
 
 #endif /* PROCINFO_HH */
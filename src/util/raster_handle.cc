@@ -26,12 +26,10 @@
 
 #include <cassert>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
-#include <unordered_map>
-
-#include "util/exception.hh"
 
 using namespace std;
 
@@ -44,6 +42,8 @@ static T dequeue( queue<T>& q )
   return ret;
 }
 
+/* Unused rasters are kept per size, so consumers that decode at different
+   resolutions (e.g. a scaled-down preview) can share the pool */
 template<class RasterType>
 class RasterPool
 {
@@ -51,7 +51,9 @@ public:
   typedef std::unique_ptr<RasterType, RasterDeleter<RasterType>> RasterHolder;
 
 private:
-  queue<RasterHolder> unused_rasters_ {};
+  map<pair<unsigned int, unsigned int>, queue<RasterHolder>> unused_rasters_ {};
+  size_t allocated_ { 0 };
+  size_t in_use_ { 0 };
   mutex mutex_ {};
 
 public:
@@ -61,18 +63,16 @@ public:
     unique_lock<mutex> lock { mutex_ };
     RasterHolder ret;
 
-    if ( unused_rasters_.empty() ) {
+    auto& unused = unused_rasters_[{ display_width, display_height }];
+
+    if ( unused.empty() ) {
       ret.reset( new RasterType(
         display_width, display_height, display_width, display_height ) );
+      allocated_++;
     } else {
-      if ( ( unused_rasters_.front()->display_width() != display_width )
-           or ( unused_rasters_.front()->display_height()
-                != display_height ) ) {
-        throw Unsupported( "raster size has changed" );
-      } else {
-        ret = dequeue( unused_rasters_ );
-      }
+      ret = dequeue( unused );
     }
+    in_use_++;
 
     ret.get_deleter().set_raster_pool( this );
 
@@ -84,7 +84,15 @@ public:
     unique_lock<mutex> lock { mutex_ };
 
     assert( raster );
-    unused_rasters_.emplace( raster );
+    unused_rasters_[{ raster->display_width(), raster->display_height() }]
+      .emplace( raster );
+    in_use_--;
+  }
+
+  RasterPoolStatistics statistics()
+  {
+    unique_lock<mutex> lock { mutex_ };
+    return { allocated_, in_use_ };
   }
 };
 
@@ -135,7 +143,15 @@ BaseRasterHandle<RasterType>::BaseRasterHandle(
   : raster_( raster_pool.make_raster( display_width, display_height ) )
 {}
 
+template<class RasterType>
+RasterPoolStatistics global_raster_pool_statistics()
+{
+  return global_raster_pool<RasterType>().statistics();
+}
+
 template class RasterDeleter<BaseRaster>;
 template class BaseRasterHandle<BaseRaster>;
 template class RasterDeleter<RGBRaster>;
 template class BaseRasterHandle<RGBRaster>;
+template RasterPoolStatistics global_raster_pool_statistics<BaseRaster>();
+template RasterPoolStatistics global_raster_pool_statistics<RGBRaster>();
@@ -69,4 +69,14 @@ public:
 using RasterHandle = BaseRasterHandle<BaseRaster>;
 using RGBRasterHandle = BaseRasterHandle<RGBRaster>;
 
+struct RasterPoolStatistics
+{
+  size_t allocated; // rasters ever created by the pool
+  size_t in_use;    // of those, how many are held by a handle right now
+};
+
+// Occupancy of the pool that handles of this type use by default
+template<class RasterType>
+RasterPoolStatistics global_raster_pool_statistics();
+
 #endif /* RASTER_POOL_HH */
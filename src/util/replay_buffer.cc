@@ -0,0 +1,222 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "replay_buffer.hh"
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+
+#include "bytes.hh"
+#include "exception.hh"
+
+using namespace std;
+
+static const TwoD<uint8_t>& plane( const RGBRaster& frame,
+                                   const unsigned int index )
+{
+  switch ( index ) {
+    case 0:
+      return frame.R();
+    case 1:
+      return frame.G();
+    case 2:
+      return frame.B();
+    default:
+      return frame.A();
+  }
+}
+
+static TwoD<uint8_t>& plane( RGBRaster& frame, const unsigned int index )
+{
+  return const_cast<TwoD<uint8_t>&>(
+    plane( static_cast<const RGBRaster&>( frame ), index ) );
+}
+
+static FileDescriptor create_file( const string& filename,
+                                   const size_t length )
+{
+  FileDescriptor fd { SystemCall(
+    filename, open( filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) ) };
+
+  /* reserve the blocks now so that a full disk can't turn a later store
+     into the mapping into SIGBUS */
+  const int error = posix_fallocate( fd.fd_num(), 0, length );
+  if ( error ) {
+    throw unix_error( "posix_fallocate", error );
+  }
+
+  return fd;
+}
+
+ReplayBuffer::ReplayBuffer( const string& filename,
+                            const uint16_t width,
+                            const uint16_t height,
+                            const uint32_t slot_count )
+  : width_( width )
+  , height_( height )
+  , slot_count_( slot_count )
+  , plane_length_( size_t { width } * height )
+  , slot_length_( round_up( PLANE_COUNT * plane_length_, page_size() ) )
+  , slots_offset_(
+      round_up( sizeof( Header ) + slot_count * sizeof( SlotIndex ),
+                page_size() ) )
+  , fd_( create_file( filename, slots_offset_ + slot_count * slot_length_ ) )
+  , region_( slots_offset_ + slot_count * slot_length_,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE,
+             fd_.fd_num() )
+{
+  static_assert( atomic<uint64_t>::is_always_lock_free );
+
+  /* one slot is always the next to be overwritten, so it takes two to keep
+     any frame replayable */
+  if ( width == 0 or height == 0 or slot_count < 2 ) {
+    throw runtime_error(
+      "ReplayBuffer needs a nonzero size and at least two slots" );
+  }
+
+  Header* const header = new ( region_.addr() ) Header;
+  memcpy( header->magic, "RPLYBUF1", sizeof( header->magic ) );
+  header->width = width_;
+  header->height = height_;
+  header->slot_count = slot_count_;
+  header->plane_count = PLANE_COUNT;
+  header->slot_length = slot_length_;
+  header->frames_written.store( 0 );
+
+  SlotIndex* const index
+    = new ( region_.addr() + sizeof( Header ) ) SlotIndex[slot_count_];
+  for ( uint32_t i = 0; i < slot_count_; i++ ) {
+    index[i].sequence.store( 0 );
+    index[i].timestamp_ns.store( 0 );
+  }
+}
+
+ReplayBuffer::Header& ReplayBuffer::header() const
+{
+  return *reinterpret_cast<Header*>( region_.addr() );
+}
+
+ReplayBuffer::SlotIndex& ReplayBuffer::slot_index(
+  const uint64_t frame_no ) const
+{
+  return reinterpret_cast<SlotIndex*>(
+    region_.addr() + sizeof( Header ) )[frame_no % slot_count_];
+}
+
+uint8_t* ReplayBuffer::slot( const uint64_t frame_no ) const
+{
+  return region_.addr() + slots_offset_
+         + ( frame_no % slot_count_ ) * slot_length_;
+}
+
+void ReplayBuffer::record( const RGBRaster& frame )
+{
+  record( frame,
+          chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch() )
+            .count() );
+}
+
+void ReplayBuffer::record( const RGBRaster& frame,
+                           const uint64_t timestamp_ns )
+{
+  if ( frame.width() != width_ or frame.height() != height_ ) {
+    throw runtime_error( "size mismatch" );
+  }
+
+  /* there is one writer, so nobody else moves frames_written */
+  const uint64_t frame_no
+    = header().frames_written.load( memory_order_relaxed );
+  SlotIndex& index = slot_index( frame_no );
+
+  index.sequence.store( 2 * frame_no + 1, memory_order_relaxed );
+  atomic_thread_fence( memory_order_release );
+
+  uint8_t* destination = slot( frame_no );
+  for ( unsigned int i = 0; i < PLANE_COUNT; i++ ) {
+    memcpy( destination, &plane( frame, i ).at( 0, 0 ), plane_length_ );
+    destination += plane_length_;
+  }
+
+  index.timestamp_ns.store( timestamp_ns, memory_order_relaxed );
+  index.sequence.store( 2 * frame_no + 2, memory_order_release );
+  header().frames_written.store( frame_no + 1, memory_order_release );
+}
+
+uint64_t ReplayBuffer::next_frame() const
+{
+  return header().frames_written.load( memory_order_acquire );
+}
+
+uint64_t ReplayBuffer::oldest_frame() const
+{
+  const uint64_t next = next_frame();
+
+  /* once every slot has been used, the slot of frame next - slot_count is
+     the next to be overwritten, so it is left out */
+  return next >= slot_count_ ? next - slot_count_ + 1 : 0;
+}
+
+uint64_t ReplayBuffer::frame_at( const uint64_t timestamp_ns ) const
+{
+  uint64_t low = oldest_frame(), high = next_frame();
+
+  /* timestamps increase with sequence number */
+  while ( low < high ) {
+    const uint64_t middle = low + ( high - low ) / 2;
+    if ( slot_index( middle ).timestamp_ns.load( memory_order_relaxed )
+         < timestamp_ns ) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+optional<uint64_t> ReplayBuffer::timestamp( const uint64_t frame_no ) const
+{
+  const SlotIndex& index = slot_index( frame_no );
+  const uint64_t sequence = index.sequence.load( memory_order_acquire );
+  const uint64_t timestamp_ns
+    = index.timestamp_ns.load( memory_order_relaxed );
+
+  atomic_thread_fence( memory_order_acquire );
+  if ( sequence != 2 * frame_no + 2
+       or index.sequence.load( memory_order_relaxed ) != sequence ) {
+    return {};
+  }
+
+  return timestamp_ns;
+}
+
+bool ReplayBuffer::read( const uint64_t frame_no,
+                         RGBRaster& frame,
+                         uint64_t& timestamp_ns ) const
+{
+  if ( frame.width() != width_ or frame.height() != height_ ) {
+    throw runtime_error( "size mismatch" );
+  }
+
+  const SlotIndex& index = slot_index( frame_no );
+  const uint64_t sequence = index.sequence.load( memory_order_acquire );
+
+  if ( sequence != 2 * frame_no + 2 ) {
+    return false;
+  }
+
+  const uint8_t* source = slot( frame_no );
+  for ( unsigned int i = 0; i < PLANE_COUNT; i++ ) {
+    memcpy( &plane( frame, i ).at( 0, 0 ), source, plane_length_ );
+    source += plane_length_;
+  }
+  timestamp_ns = index.timestamp_ns.load( memory_order_relaxed );
+
+  /* if the writer got to this slot meanwhile, the copy may be torn */
+  atomic_thread_fence( memory_order_acquire );
+  return index.sequence.load( memory_order_relaxed ) == sequence;
+}
@@ -0,0 +1,107 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef REPLAY_BUFFER_HH
+#define REPLAY_BUFFER_HH
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "file_descriptor.hh"
+#include "mmap_region.hh"
+#include "raster.hh"
+
+/* Keeps the most recent frames of a source in a preallocated, memory-mapped
+   circular file of `slot_count` slots, so that any of them can be replayed
+   at once without decoding. One slot is always the next to be overwritten,
+   so `slot_count - 1` frames are replayable.
+
+   The file holds a header, one index entry per slot (the frame's sequence
+   number and timestamp) and the slots themselves, each with the R, G, B
+   and A planes stored exactly as a raster holds them. record() is meant to
+   be called on the capture thread: it copies each plane with one memcpy
+   into pages that were faulted in when the file was created, and takes no
+   lock and makes no system call. Keeping the file on tmpfs (e.g. /dev/shm)
+   keeps writeback out of the picture too.
+
+   Readers never block the writer. Each index entry is a sequence lock: it
+   is odd while its slot is being written, and readers check that it did
+   not change while they copied the slot out. */
+
+class ReplayBuffer
+{
+public:
+  struct Header
+  {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t slot_count;
+    uint32_t plane_count;
+    uint64_t slot_length;
+
+    // frames recorded so far, i.e. the sequence number of the next frame
+    std::atomic<uint64_t> frames_written;
+  };
+
+  struct SlotIndex
+  {
+    // 2 * frame_no + 1 while frame_no is being written, + 2 once it is done
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> timestamp_ns;
+  };
+
+private:
+  static constexpr uint32_t PLANE_COUNT = 4;
+
+  const uint16_t width_;
+  const uint16_t height_;
+  const uint32_t slot_count_;
+  const size_t plane_length_;
+  const size_t slot_length_;
+  const size_t slots_offset_;
+
+  FileDescriptor fd_;
+  MMap_Region region_;
+
+  Header& header() const;
+  SlotIndex& slot_index( const uint64_t frame_no ) const;
+  uint8_t* slot( const uint64_t frame_no ) const;
+
+public:
+  ReplayBuffer( const std::string& filename,
+                const uint16_t width,
+                const uint16_t height,
+                const uint32_t slot_count );
+
+  /* forbid copying */
+  ReplayBuffer( const ReplayBuffer& other ) = delete;
+  ReplayBuffer& operator=( const ReplayBuffer& other ) = delete;
+
+  // Stamps the frame with the steady clock
+  void record( const RGBRaster& frame );
+  void record( const RGBRaster& frame, const uint64_t timestamp_ns );
+
+  // Sequence numbers of the frames available for replay: [oldest, next),
+  // at most slot_count - 1 of them
+  uint64_t oldest_frame() const;
+  uint64_t next_frame() const;
+
+  // The first available frame with a timestamp >= timestamp_ns (or next)
+  uint64_t frame_at( const uint64_t timestamp_ns ) const;
+
+  // Timestamp of a frame, if it is still in the buffer
+  std::optional<uint64_t> timestamp( const uint64_t frame_no ) const;
+
+  // Copies a frame out; false if it is not (or no longer) in the buffer
+  bool read( const uint64_t frame_no,
+             RGBRaster& frame,
+             uint64_t& timestamp_ns ) const;
+
+  uint16_t width() const { return width_; }
+  uint16_t height() const { return height_; }
+  uint32_t slot_count() const { return slot_count_; }
+};
+
+#endif /* REPLAY_BUFFER_HH */
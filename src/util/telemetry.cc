@@ -0,0 +1,266 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "telemetry.hh"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <sstream>
+
+#include "exception.hh"
+#include "latency.hh"
+#include "procinfo.hh"
+
+using namespace std;
+using namespace telemetry;
+
+namespace {
+
+optional<string> read_file( const string& filename )
+{
+  ifstream file { filename };
+  if ( not file ) {
+    return {};
+  }
+  stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+/* The fields of a stat file after the command name, which is in
+   parentheses and may itself contain spaces or parentheses. The first of
+   these is field 3 (the state) in proc(5). */
+vector<string> stat_fields( const string& stat, string* name = nullptr )
+{
+  const size_t name_start = stat.find( '(' );
+  const size_t name_end = stat.rfind( ')' );
+  if ( name_start == string::npos or name_end == string::npos ) {
+    throw runtime_error( "unexpected /proc stat format" );
+  }
+  if ( name ) {
+    *name = stat.substr( name_start + 1, name_end - name_start - 1 );
+  }
+
+  istringstream rest { stat.substr( name_end + 1 ) };
+  return { istream_iterator<string>( rest ), istream_iterator<string>() };
+}
+
+uint64_t stat_field( const vector<string>& fields, const unsigned int number )
+{
+  if ( number < 3 or number - 3 >= fields.size() ) {
+    throw runtime_error( "/proc stat field " + to_string( number )
+                         + " is missing" );
+  }
+  return stoull( fields[number - 3] );
+}
+
+// The value on the line of a status or sched file that starts with `key`
+uint64_t keyed_value( const string& contents, const string& key )
+{
+  istringstream lines { contents };
+  string line;
+  while ( getline( lines, line ) ) {
+    if ( line.compare( 0, key.size(), key ) == 0 ) {
+      const size_t value_start = line.find_first_of( "0123456789", key.size() );
+      if ( value_start != string::npos ) {
+        return stoull( line.substr( value_start ) );
+      }
+    }
+  }
+  return 0;
+}
+
+optional<ThreadSample> sample_thread( const pid_t tid )
+{
+  const string directory = "/proc/self/task/" + to_string( tid ) + "/";
+
+  /* the thread may exit at any point, so give up on it quietly */
+  const auto stat = read_file( directory + "stat" );
+  const auto status = read_file( directory + "status" );
+  if ( not stat.has_value() or not status.has_value() ) {
+    return {};
+  }
+
+  ThreadSample thread {};
+  thread.tid = tid;
+
+  const vector<string> fields = stat_fields( *stat, &thread.name );
+  thread.minor_faults = stat_field( fields, 10 );
+  thread.major_faults = stat_field( fields, 12 );
+  thread.last_cpu = stat_field( fields, 39 );
+
+  thread.voluntary_switches = keyed_value( *status, "voluntary_ctxt_switches" );
+  thread.involuntary_switches
+    = keyed_value( *status, "nonvoluntary_ctxt_switches" );
+
+  /* schedstat has nanosecond run and wait times; without it, fall back to
+     the clock-tick CPU time in stat */
+  const auto schedstat = read_file( directory + "schedstat" );
+  if ( schedstat.has_value() ) {
+    istringstream times { *schedstat };
+    times >> thread.cpu_ns >> thread.run_delay_ns;
+  } else {
+    const uint64_t ticks = stat_field( fields, 14 ) + stat_field( fields, 15 );
+    thread.cpu_ns = ticks * 1'000'000'000 / sysconf( _SC_CLK_TCK );
+  }
+
+  /* only with CONFIG_SCHED_DEBUG */
+  const auto sched = read_file( directory + "sched" );
+  if ( sched.has_value() ) {
+    thread.migrations = keyed_value( *sched, "se.nr_migrations" );
+  }
+
+  return thread;
+}
+
+}
+
+Sample telemetry::sample()
+{
+  Sample sample {};
+  sample.timestamp_ns = latency::now_ns();
+
+  const auto stat = read_file( "/proc/self/stat" );
+  if ( not stat.has_value() ) {
+    throw runtime_error( "could not read /proc/self/stat" );
+  }
+  const vector<string> fields = stat_fields( *stat );
+  sample.minor_faults = stat_field( fields, 10 );
+  sample.major_faults = stat_field( fields, 12 );
+  sample.resident_bytes = procinfo::resident_set_size();
+
+  sample.raster_pool = global_raster_pool_statistics<BaseRaster>();
+  sample.rgb_raster_pool = global_raster_pool_statistics<RGBRaster>();
+
+  const unique_ptr<DIR, int ( * )( DIR* )> tasks { opendir( "/proc/self/task" ),
+                                                  closedir };
+  if ( not tasks ) {
+    throw unix_error( "opendir /proc/self/task" );
+  }
+
+  while ( const dirent* entry = readdir( tasks.get() ) ) {
+    if ( entry->d_name[0] == '.' ) {
+      continue;
+    }
+    auto thread = sample_thread( stoi( entry->d_name ) );
+    if ( thread.has_value() ) {
+      sample.threads.push_back( move( *thread ) );
+    }
+  }
+
+  sort( sample.threads.begin(),
+        sample.threads.end(),
+        []( const ThreadSample& a, const ThreadSample& b ) {
+          return a.tid < b.tid;
+        } );
+
+  return sample;
+}
+
+void telemetry::report( ostream& out,
+                        const Sample& previous,
+                        const Sample& current )
+{
+  const double elapsed_ns
+    = max( uint64_t { 1 }, current.timestamp_ns - previous.timestamp_ns );
+  const auto percent = [&]( const uint64_t duration_ns ) {
+    return 100.0 * duration_ns / elapsed_ns;
+  };
+
+  out << fixed << setprecision( 1 ) << "telemetry over "
+      << elapsed_ns / 1'000'000 << " ms: rss "
+      << current.resident_bytes / 1048576.0 << " MiB, faults +"
+      << current.minor_faults - previous.minor_faults << " minor +"
+      << current.major_faults - previous.major_faults << " major, rasters "
+      << current.raster_pool.in_use << "/" << current.raster_pool.allocated
+      << " (+"
+      << current.raster_pool.allocated - previous.raster_pool.allocated
+      << "), RGB rasters " << current.rgb_raster_pool.in_use << "/"
+      << current.rgb_raster_pool.allocated << " (+"
+      << current.rgb_raster_pool.allocated
+           - previous.rgb_raster_pool.allocated
+      << ")\n";
+
+  for ( const ThreadSample& thread : current.threads ) {
+    /* a thread that started since the previous sample counts from zero */
+    const auto match = find_if(
+      previous.threads.begin(),
+      previous.threads.end(),
+      [&]( const ThreadSample& other ) { return other.tid == thread.tid; } );
+    const ThreadSample before
+      = match == previous.threads.end() ? ThreadSample {} : *match;
+
+    out << "  " << thread.tid << " " << thread.name << ": cpu "
+        << percent( thread.cpu_ns - before.cpu_ns ) << "%, waiting "
+        << percent( thread.run_delay_ns - before.run_delay_ns )
+        << "%, switches +"
+        << thread.voluntary_switches - before.voluntary_switches
+        << " voluntary +"
+        << thread.involuntary_switches - before.involuntary_switches
+        << " involuntary, migrations +"
+        << thread.migrations - before.migrations << ", faults +"
+        << thread.minor_faults - before.minor_faults << " minor +"
+        << thread.major_faults - before.major_faults << " major, on cpu "
+        << thread.last_cpu << "\n";
+  }
+}
+
+void telemetry::set_thread_name( const string& name )
+{
+  pthread_setname_np( pthread_self(), name.substr( 0, 15 ).c_str() );
+}
+
+Publisher::Publisher( const string& filename,
+                      const chrono::milliseconds interval )
+  : output_( SystemCall(
+      filename,
+      open( filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644 ) ) )
+  , interval_( interval )
+  , thread_( &Publisher::publish_loop, this )
+{}
+
+Publisher::~Publisher()
+{
+  {
+    lock_guard<mutex> lock { mutex_ };
+    terminate_ = true;
+  } // End of lock scope
+  terminate_signal_.notify_all();
+  thread_.join();
+}
+
+void Publisher::publish_loop()
+{
+  set_thread_name( "telemetry" );
+
+  try {
+    Sample previous = sample();
+    while ( true ) {
+      {
+        unique_lock<mutex> lock { mutex_ };
+        if ( terminate_signal_.wait_for(
+               lock, interval_, [&] { return terminate_; } ) ) {
+          return;
+        }
+      } // End of lock scope
+
+      const Sample current = sample();
+      ostringstream text;
+      report( text, previous, current );
+      output_.write( text.str() );
+      previous = current;
+    }
+  } catch ( const exception& e ) {
+    /* telemetry is never worth stopping the show for */
+    cerr << "telemetry stopped: " << e.what() << endl;
+  }
+}
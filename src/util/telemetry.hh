@@ -0,0 +1,98 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TELEMETRY_HH
+#define TELEMETRY_HH
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_descriptor.hh"
+#include "raster_handle.hh"
+
+/* Process and per-thread resource usage, for telling apart the causes of
+   a stutter: a thread starved of CPU (high run-queue wait, involuntary
+   context switches, migrations), page faults, or a raster pool that had
+   to keep allocating.
+
+   The per-thread counters come from /proc/self/task/TID/{stat,schedstat,
+   status,sched}. Counters are cumulative; report() prints the change
+   between two samples. */
+
+namespace telemetry {
+
+struct ThreadSample
+{
+  pid_t tid;
+  std::string name;
+
+  uint64_t cpu_ns;        // time spent running
+  uint64_t run_delay_ns;  // time spent runnable but waiting for a CPU
+  uint64_t voluntary_switches;
+  uint64_t involuntary_switches;
+  uint64_t migrations;    // 0 if the kernel does not export it
+  uint64_t minor_faults;
+  uint64_t major_faults;
+  int last_cpu;
+};
+
+struct Sample
+{
+  uint64_t timestamp_ns; // steady_clock
+
+  size_t resident_bytes;
+  uint64_t minor_faults;
+  uint64_t major_faults;
+
+  RasterPoolStatistics raster_pool;
+  RasterPoolStatistics rgb_raster_pool;
+
+  std::vector<ThreadSample> threads;
+};
+
+Sample sample();
+
+// One line for the process, then one per thread, with rates and deltas
+// computed since `previous`
+void report( std::ostream& out, const Sample& previous, const Sample& current );
+
+// Names the calling thread (as shown in the report, top and gdb); the
+// kernel keeps at most 15 characters
+void set_thread_name( const std::string& name );
+
+/* Samples every `interval` on its own thread and appends each report to a
+   file (which may also be a named pipe or a device like /dev/stderr) */
+class Publisher
+{
+private:
+  FileDescriptor output_;
+  std::chrono::milliseconds interval_;
+
+  std::mutex mutex_ {};
+  std::condition_variable terminate_signal_ {};
+  bool terminate_ { false };
+
+  std::thread thread_;
+
+  void publish_loop();
+
+public:
+  Publisher( const std::string& filename,
+             const std::chrono::milliseconds interval );
+  ~Publisher();
+
+  /* forbid copying */
+  Publisher( const Publisher& other ) = delete;
+  Publisher& operator=( const Publisher& other ) = delete;
+};
+
+}
+
+#endif /* TELEMETRY_HH */
@@ -8,15 +8,19 @@
 #include "thread_pool.hh"
 #include "util/chroma_key.hh"
 #include "util/compositor.hh"
+#include "util/telemetry.hh"
+#include "util/trace.hh"
 
 using namespace std;
 
 template<class Module>
-ThreadPool<Module>::ThreadPool( const uint8_t thread_count,
+ThreadPool<Module>::ThreadPool( const char* name,
+                                const uint8_t thread_count,
                                 const uint16_t width,
                                 const uint16_t height,
                                 Module* module )
-  : width_( width )
+  : name_( name )
+  , width_( width )
   , height_( height )
   , module_( module )
   , thread_count_( thread_count )
@@ -71,6 +75,7 @@ void ThreadPool<Module>::process_rows( const uint8_t id )
   const uint16_t num_rows = height_ / thread_count_;
   const uint16_t row_start_idx = id * num_rows;
   const uint16_t row_end_idx = row_start_idx + num_rows;
+  telemetry::set_thread_name( string( name_ ) + "-" + to_string( id ) );
   while ( true ) {
     {
       unique_lock<mutex> lock( lock_ );
@@ -86,7 +91,11 @@ void ThreadPool<Module>::process_rows( const uint8_t id )
       auto task = task_list_[i];
       // This level corresponds to the current task, since 0 is Start
       const int sync_level = i + 1;
-      task( *module_, row_start_idx, row_end_idx );
+      {
+        const trace::Span span { task_names_[i], name_ };
+        task( *module_, row_start_idx, row_end_idx );
+      }
+      const trace::Span wait { "barrier wait", name_ };
       synchronize_threads( id, sync_level );
     }
 
@@ -97,16 +106,21 @@ void ThreadPool<Module>::process_rows( const uint8_t id )
         output_complete_ = true;
       }
     } // End of lock scope
-    synchronize_threads( id, End );
+    {
+      const trace::Span wait { "barrier wait", name_ };
+      synchronize_threads( id, End );
+    }
     cv_main_.notify_one();
   }
 }
 
 template<class Module>
 void ThreadPool<Module>::append_task(
-  function<void( Module&, const uint16_t, const uint16_t )> task )
+  function<void( Module&, const uint16_t, const uint16_t )> task,
+  const char* task_name )
 {
   task_list_.push_back( task );
+  task_names_.push_back( task_name );
   End = task_list_.size() + 1;
 }
 
@@ -123,6 +137,7 @@ void ThreadPool<Module>::input_complete()
 template<class Module>
 void ThreadPool<Module>::wait_for_result()
 {
+  const trace::Span span { "wait for workers", name_ };
   unique_lock<mutex> lock( lock_ );
   cv_main_.wait( lock, [&] {
     return output_complete_
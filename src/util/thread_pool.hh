@@ -23,6 +23,9 @@ template<class Module>
 class ThreadPool
 {
 private:
+  // Names the workers, and is the category of their trace events
+  const char* name_;
+
   // For internal operations
   uint16_t width_, height_;
 
@@ -37,11 +40,13 @@ private:
   bool input_ready_ { false };
   std::vector<std::function<void( Module&, const uint16_t, const uint16_t )>>
     task_list_ {};
+  std::vector<const char*> task_names_ {};
   std::vector<int> output_level_;
   bool output_complete_ { false };
 
   void process_rows( const uint8_t id );
-  const int Start { 0 };
+  // static, so it is set before output_level_ is filled with it
+  static constexpr int Start = 0;
   int End { 0 };
   // Only return when all the threads completed their current level work
   // For N tasks, each task is synchronized based on their level:
@@ -54,14 +59,16 @@ private:
   ThreadPool& operator=( const ThreadPool& ) = delete;
 
 public:
-  ThreadPool( const uint8_t thread_count,
+  ThreadPool( const char* name,
+              const uint8_t thread_count,
               const uint16_t width,
               const uint16_t height,
               Module* module );
   ~ThreadPool();
 
   void append_task(
-    std::function<void( Module&, const uint16_t, const uint16_t )> task );
+    std::function<void( Module&, const uint16_t, const uint16_t )> task,
+    const char* task_name );
   // Mark input ready and allow threads to start processing the tasks
   void input_complete();
   // Returns only when all tasks are completed
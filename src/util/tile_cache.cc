@@ -0,0 +1,266 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "tile_cache.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+uint64_t row_sad( const uint8_t* a, const uint8_t* b, const unsigned int n )
+{
+  unsigned int i = 0;
+  uint64_t sum = 0;
+
+#ifdef __SSE2__
+  __m128i sums = _mm_setzero_si128();
+  for ( ; i + 16 <= n; i += 16 ) {
+    const __m128i x
+      = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) );
+    const __m128i y
+      = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i ) );
+    sums = _mm_add_epi64( sums, _mm_sad_epu8( x, y ) );
+  }
+  /* a partial sum in each 64-bit half, far below 2^32 for one row */
+  sum = _mm_cvtsi128_si32( sums )
+        + _mm_cvtsi128_si32( _mm_srli_si128( sums, 8 ) );
+#endif
+
+  for ( ; i < n; i++ ) {
+    sum += abs( a[i] - b[i] );
+  }
+  return sum;
+}
+
+}
+
+TileCache::TileCache( const uint16_t width, const uint16_t height )
+  : width_( width )
+  , height_( height )
+  , tiles_x_( ( width + TILE_SIZE - 1 ) / TILE_SIZE )
+  , tiles_y_( ( height + TILE_SIZE - 1 ) / TILE_SIZE )
+  , static_( tiles_x_ * tiles_y_ )
+{}
+
+void TileCache::set_threshold( const double threshold )
+{
+  threshold_ = max( 0.0, threshold );
+}
+
+void TileCache::set_halo( const int pixels )
+{
+  neighbor_radius_ = ( max( 0, pixels ) + TILE_SIZE - 1 ) / TILE_SIZE;
+  invalidate();
+}
+
+void TileCache::begin_frame()
+{
+  frame_threshold_ = threshold_;
+  frame_generation_ = generation_;
+  frame_neighbor_radius_ = neighbor_radius_;
+  frame_reuse_ = frame_threshold_ > 0 and cached_
+                 and cached_generation_ == frame_generation_;
+
+  /* allocated the first time the cache is turned on */
+  if ( frame_threshold_ > 0 and planes_.empty() ) {
+    for ( int i = 0; i < 3; i++ ) {
+      reference_.emplace_back( width_, height_ );
+    }
+    for ( int i = 0; i < static_cast<int>( Plane::Count ); i++ ) {
+      planes_.emplace_back( width_, height_ );
+    }
+  }
+}
+
+void TileCache::end_frame()
+{
+  cached_ = frame_threshold_ > 0;
+  cached_generation_ = frame_generation_;
+
+  if ( frame_threshold_ > 0 ) {
+    uint64_t reused = 0;
+    for ( int tile_y = 0; frame_reuse_ and tile_y < tiles_y_; tile_y++ ) {
+      for ( int tile_x = 0; tile_x < tiles_x_; tile_x++ ) {
+        reused += reusable( tile_x, tile_y );
+      }
+    }
+    frames_++;
+    tiles_ += tiles_x_ * tiles_y_;
+    reused_tiles_ += reused;
+  }
+}
+
+bool TileCache::tile_static( const RGBRaster& frame,
+                             const uint16_t tile_x,
+                             const uint16_t tile_y ) const
+{
+  const uint16_t col_start = tile_x * TILE_SIZE;
+  const uint16_t row_start = tile_y * TILE_SIZE;
+  const uint16_t cols = min<int>( TILE_SIZE, width_ - col_start );
+  const uint16_t rows = min<int>( TILE_SIZE, height_ - row_start );
+  const uint64_t limit = frame_threshold_ * cols * rows * 3;
+
+  const TwoD<uint8_t>* const input[3] = { &frame.R(), &frame.G(), &frame.B() };
+  uint64_t sum = 0;
+  for ( uint16_t row = row_start; row < row_start + rows; row++ ) {
+    for ( int i = 0; i < 3; i++ ) {
+      sum += row_sad( &input[i]->at( col_start, row ),
+                      &reference_[i].at( col_start, row ),
+                      cols );
+    }
+    if ( sum > limit ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TileCache::reusable( const int tile_x, const int tile_y ) const
+{
+  const int radius = frame_neighbor_radius_;
+  for ( int y = max( 0, tile_y - radius );
+        y <= min( tiles_y_ - 1, tile_y + radius );
+        y++ ) {
+    for ( int x = max( 0, tile_x - radius );
+          x <= min( tiles_x_ - 1, tile_x + radius );
+          x++ ) {
+      if ( not static_[y * tiles_x_ + x] ) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void TileCache::compare_tiles( const RGBRaster& frame,
+                               const uint16_t row_start_idx,
+                               const uint16_t row_end_idx )
+{
+  if ( not frame_reuse_ ) {
+    return;
+  }
+
+  /* each tile row belongs to the worker whose rows it starts in */
+  for ( int tile_y = ( row_start_idx + TILE_SIZE - 1 ) / TILE_SIZE;
+        tile_y * TILE_SIZE < row_end_idx;
+        tile_y++ ) {
+    for ( int tile_x = 0; tile_x < tiles_x_; tile_x++ ) {
+      static_[tile_y * tiles_x_ + tile_x]
+        = tile_static( frame, tile_x, tile_y );
+    }
+  }
+}
+
+void TileCache::copy( const TwoD<uint8_t>& source,
+                      TwoD<uint8_t>& destination,
+                      const uint16_t row_start_idx,
+                      const uint16_t row_end_idx,
+                      const uint16_t col_start_idx,
+                      const uint16_t col_end_idx ) const
+{
+  for ( uint16_t row = row_start_idx; row < row_end_idx; row++ ) {
+    memcpy( &destination.at( col_start_idx, row ),
+            &source.at( col_start_idx, row ),
+            col_end_idx - col_start_idx );
+  }
+}
+
+void TileCache::save_reference( const RGBRaster& frame,
+                                const uint16_t row_start_idx,
+                                const uint16_t row_end_idx,
+                                const uint16_t col_start_idx,
+                                const uint16_t col_end_idx )
+{
+  if ( frame_threshold_ == 0 ) {
+    return;
+  }
+  const TwoD<uint8_t>* const input[3] = { &frame.R(), &frame.G(), &frame.B() };
+  for ( int i = 0; i < 3; i++ ) {
+    copy( *input[i],
+          reference_[i],
+          row_start_idx,
+          row_end_idx,
+          col_start_idx,
+          col_end_idx );
+  }
+}
+
+void TileCache::process( const uint16_t row_start_idx,
+                         const uint16_t row_end_idx,
+                         const RegionFunction& compute,
+                         const initializer_list<Binding> bindings )
+{
+  if ( frame_threshold_ == 0 ) {
+    compute( row_start_idx, row_end_idx, 0, width_ );
+    return;
+  }
+
+  const auto save = [&]( const uint16_t row_start,
+                         const uint16_t row_end,
+                         const uint16_t col_start,
+                         const uint16_t col_end ) {
+    for ( const Binding& binding : bindings ) {
+      copy( binding.plane,
+            planes_[static_cast<int>( binding.cached )],
+            row_start,
+            row_end,
+            col_start,
+            col_end );
+    }
+  };
+
+  if ( not frame_reuse_ ) {
+    compute( row_start_idx, row_end_idx, 0, width_ );
+    save( row_start_idx, row_end_idx, 0, width_ );
+    return;
+  }
+
+  /* the rows of each tile row, in runs of tiles that are all reused or all
+     computed */
+  for ( int tile_y = row_start_idx / TILE_SIZE;
+        tile_y * TILE_SIZE < row_end_idx;
+        tile_y++ ) {
+    const uint16_t row_start = max<int>( row_start_idx, tile_y * TILE_SIZE );
+    const uint16_t row_end
+      = min<int>( row_end_idx, ( tile_y + 1 ) * TILE_SIZE );
+
+    int tile_x = 0;
+    while ( tile_x < tiles_x_ ) {
+      const bool reuse = reusable( tile_x, tile_y );
+      int run_end = tile_x + 1;
+      while ( run_end < tiles_x_ and reusable( run_end, tile_y ) == reuse ) {
+        run_end++;
+      }
+
+      const uint16_t col_start = tile_x * TILE_SIZE;
+      const uint16_t col_end = min<int>( width_, run_end * TILE_SIZE );
+      if ( reuse ) {
+        for ( const Binding& binding : bindings ) {
+          copy( planes_[static_cast<int>( binding.cached )],
+                binding.plane,
+                row_start,
+                row_end,
+                col_start,
+                col_end );
+        }
+      } else {
+        compute( row_start, row_end, col_start, col_end );
+        save( row_start, row_end, col_start, col_end );
+      }
+
+      tile_x = run_end;
+    }
+  }
+}
+
+TileCache::Statistics TileCache::statistics() const
+{
+  return { frames_, tiles_, reused_tiles_ };
+}
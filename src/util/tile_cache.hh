@@ -0,0 +1,144 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TILE_CACHE_HH
+#define TILE_CACHE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+#include "util/2d.hh"
+#include "util/raster.hh"
+
+/* Reuses ChromaKey results for the parts of the picture that have not
+   changed since they were last computed (with a locked-off camera, most of
+   the screen and the set).
+
+   The frame is divided into TILE_SIZE x TILE_SIZE tiles. At the start of
+   each frame, every tile is compared (sum of absolute differences over R, G
+   and B) against the input its cached results came from; a tile is static
+   if the mean difference is within the threshold. Because the clip and
+   dilate/erode passes read neighbouring pixels, a tile's results are only
+   reused if every tile within the halo around it is static too.
+
+   Each pass hands process() the rows it owns and a function that computes
+   a region; tiles that are reused get the cached output of that pass
+   copied in, the rest are computed and their output saved.
+
+   Off (threshold 0) by default. Any change to the keying settings must
+   call invalidate(). */
+class TileCache
+{
+public:
+  static constexpr uint16_t TILE_SIZE = 32;
+
+  enum class Plane : uint8_t
+  {
+    RawAlpha,
+    ClippedAlpha,
+    FinalAlpha,
+    DespilledR,
+    DespilledG,
+    DespilledB,
+    Count
+  };
+
+  struct Binding
+  {
+    TwoD<uint8_t>& plane;
+    Plane cached;
+  };
+
+  using RegionFunction = std::function<void( const uint16_t row_start_idx,
+                                             const uint16_t row_end_idx,
+                                             const uint16_t col_start_idx,
+                                             const uint16_t col_end_idx )>;
+
+  struct Statistics
+  {
+    uint64_t frames;
+    uint64_t tiles;
+    uint64_t reused_tiles;
+  };
+
+private:
+  uint16_t width_, height_;
+  uint16_t tiles_x_, tiles_y_;
+
+  std::atomic<double> threshold_ { 0 };
+  std::atomic<uint64_t> generation_ { 0 };
+  std::atomic<int> neighbor_radius_ { 0 }; // in tiles
+
+  /* per frame, set by begin_frame(), so that every pass of a frame agrees
+     even if the settings change in the middle of it */
+  double frame_threshold_ { 0 };
+  uint64_t frame_generation_ { 0 };
+  int frame_neighbor_radius_ { 0 };
+  bool frame_reuse_ { false };
+
+  /* the generation the cache contents were computed under, once complete */
+  uint64_t cached_generation_ { 0 };
+  bool cached_ { false };
+
+  std::vector<TwoD<uint8_t>> reference_ {}; // input R, G, B
+  std::vector<TwoD<uint8_t>> planes_ {};    // one per Plane
+  std::vector<uint8_t> static_ {}; // per tile, from compare_tiles()
+
+  std::atomic<uint64_t> frames_ { 0 };
+  std::atomic<uint64_t> tiles_ { 0 };
+  std::atomic<uint64_t> reused_tiles_ { 0 };
+
+  bool tile_static( const RGBRaster& frame,
+                    const uint16_t tile_x,
+                    const uint16_t tile_y ) const;
+  void copy( const TwoD<uint8_t>& source,
+             TwoD<uint8_t>& destination,
+             const uint16_t row_start_idx,
+             const uint16_t row_end_idx,
+             const uint16_t col_start_idx,
+             const uint16_t col_end_idx ) const;
+
+  // Whether the tile and every tile within the halo around it are static
+  bool reusable( const int tile_x, const int tile_y ) const;
+
+public:
+  TileCache( const uint16_t width, const uint16_t height );
+
+  // Mean absolute difference per sample (0-255) below which a tile counts
+  // as unchanged; 0 turns the cache off
+  void set_threshold( const double threshold );
+  double threshold() const { return threshold_.load(); }
+
+  // How far (in pixels) one output pixel's inputs can be from it
+  void set_halo( const int pixels );
+
+  void invalidate() { generation_++; }
+
+  /* called on the thread that starts and waits for each frame */
+  void begin_frame();
+  void end_frame();
+
+  /* called by the workers, in pool order */
+  void compare_tiles( const RGBRaster& frame,
+                      const uint16_t row_start_idx,
+                      const uint16_t row_end_idx );
+  void save_reference( const RGBRaster& frame,
+                       const uint16_t row_start_idx,
+                       const uint16_t row_end_idx,
+                       const uint16_t col_start_idx,
+                       const uint16_t col_end_idx );
+  void process( const uint16_t row_start_idx,
+                const uint16_t row_end_idx,
+                const RegionFunction& compute,
+                const std::initializer_list<Binding> bindings );
+
+  Statistics statistics() const;
+
+  /* forbid copying */
+  TileCache( const TileCache& other ) = delete;
+  TileCache& operator=( const TileCache& other ) = delete;
+};
+
+#endif /* TILE_CACHE_HH */
@@ -0,0 +1,226 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "trace.hh"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+/* The fields are atomic (and accessed relaxed) because write_json() can
+   read a slot while it is being overwritten; the sequence number tells it
+   to skip the slot when that happens. */
+struct Event
+{
+  // 2 * index + 1 while event `index` is being written, + 2 once it is done
+  atomic<uint64_t> sequence { 0 };
+
+  atomic<const char*> name { nullptr };
+  atomic<const char*> category { nullptr };
+  atomic<uint64_t> start_ns { 0 };
+  atomic<uint64_t> duration_ns { 0 };
+  atomic<pid_t> tid { 0 };
+  atomic<char> phase { 0 }; // 'X' for a span, 'i' for an instant
+};
+
+/* never destroyed, so threads can keep recording while the process exits */
+struct Buffer
+{
+  unique_ptr<Event[]> events;
+  size_t capacity;
+  uint64_t start_ns;
+
+  // events recorded so far; event `index` goes in slot index % capacity
+  atomic<uint64_t> next { 0 };
+
+  // events given up because their slot was still being written
+  atomic<uint64_t> dropped { 0 };
+
+  Buffer( const size_t s_capacity )
+    : events( new Event[s_capacity] )
+    , capacity( s_capacity )
+    , start_ns( latency::now_ns() )
+  {}
+};
+
+atomic<Buffer*> buffer { nullptr };
+
+pid_t thread_id()
+{
+  thread_local const pid_t tid = syscall( SYS_gettid );
+  return tid;
+}
+
+void record( const char phase,
+             const char* name,
+             const char* category,
+             const uint64_t start_ns,
+             const uint64_t duration_ns )
+{
+  Buffer* const active = buffer.load( memory_order_acquire );
+  if ( not active ) {
+    return;
+  }
+
+  const uint64_t index = active->next.fetch_add( 1, memory_order_relaxed );
+  Event& event = active->events[index % active->capacity];
+
+  /* claim the slot, unless a writer from an earlier lap is still filling
+     it in (or, having been preempted for a whole lap, this writer is the
+     late one) */
+  uint64_t sequence = event.sequence.load( memory_order_relaxed );
+  do {
+    if ( sequence & 1 or sequence > 2 * index ) {
+      active->dropped.fetch_add( 1, memory_order_relaxed );
+      return;
+    }
+  } while ( not event.sequence.compare_exchange_weak(
+    sequence, 2 * index + 1, memory_order_relaxed ) );
+  atomic_thread_fence( memory_order_release );
+
+  event.name.store( name, memory_order_relaxed );
+  event.category.store( category, memory_order_relaxed );
+  event.start_ns.store( start_ns, memory_order_relaxed );
+  event.duration_ns.store( duration_ns, memory_order_relaxed );
+  event.tid.store( thread_id(), memory_order_relaxed );
+  event.phase.store( phase, memory_order_relaxed );
+  event.sequence.store( 2 * index + 2, memory_order_release );
+}
+
+string json_escape( const string& text )
+{
+  string escaped;
+  for ( const char c : text ) {
+    if ( c == '"' or c == '\\' ) {
+      escaped += '\\';
+    }
+    if ( static_cast<unsigned char>( c ) >= 0x20 ) {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// The thread's name, if it is still running
+string thread_name( const pid_t tid )
+{
+  ifstream comm { "/proc/self/task/" + to_string( tid ) + "/comm" };
+  string name;
+  getline( comm, name );
+  return name.empty() ? "thread " + to_string( tid ) : name;
+}
+
+}
+
+namespace trace {
+
+void enable( const size_t capacity )
+{
+  if ( buffer.load( memory_order_acquire ) ) {
+    throw runtime_error( "tracing is already enabled" );
+  }
+  buffer.store( new Buffer { capacity }, memory_order_release );
+  enabled_flag.store( true, memory_order_relaxed );
+}
+
+void record_span( const char* name,
+                  const char* category,
+                  const uint64_t start_ns,
+                  const uint64_t end_ns )
+{
+  record( 'X', name, category, start_ns, end_ns - start_ns );
+}
+
+void record_instant( const char* name, const char* category )
+{
+  if ( enabled() ) {
+    record( 'i', name, category, latency::now_ns(), 0 );
+  }
+}
+
+size_t write_json( const string& filename )
+{
+  const Buffer* const active = buffer.load( memory_order_acquire );
+  if ( not active ) {
+    throw runtime_error( "tracing is not enabled" );
+  }
+
+  const pid_t pid = getpid();
+  const auto microseconds = [&]( const uint64_t ns ) {
+    return static_cast<double>( ns ) / 1000;
+  };
+
+  ostringstream json;
+  json << fixed << setprecision( 3 ) << "{\"traceEvents\":[\n";
+
+  /* the most recent `capacity` events, oldest first; events still being
+     filled in, or overwritten while being read, are left out */
+  const uint64_t end = active->next.load( memory_order_relaxed );
+  const uint64_t begin = end - min<uint64_t>( end, active->capacity );
+  size_t written = 0;
+  set<pid_t> threads;
+  for ( uint64_t index = begin; index < end; index++ ) {
+    const Event& event = active->events[index % active->capacity];
+    const uint64_t sequence = event.sequence.load( memory_order_acquire );
+    if ( sequence != 2 * index + 2 ) {
+      continue;
+    }
+
+    const char* const name = event.name.load( memory_order_relaxed );
+    const char* const category = event.category.load( memory_order_relaxed );
+    const uint64_t start_ns = event.start_ns.load( memory_order_relaxed );
+    const uint64_t duration_ns
+      = event.duration_ns.load( memory_order_relaxed );
+    const pid_t tid = event.tid.load( memory_order_relaxed );
+    const char phase = event.phase.load( memory_order_relaxed );
+
+    atomic_thread_fence( memory_order_acquire );
+    if ( event.sequence.load( memory_order_relaxed ) != sequence ) {
+      continue;
+    }
+
+    json << ( written ? ",\n" : "" ) << "{\"name\":\"" << name
+         << "\",\"cat\":\"" << category << "\",\"ph\":\"" << phase
+         << "\",\"ts\":"
+         << microseconds( start_ns - min( start_ns, active->start_ns ) )
+         << ",\"pid\":" << pid << ",\"tid\":" << tid;
+    if ( phase == 'X' ) {
+      json << ",\"dur\":" << microseconds( duration_ns );
+    } else {
+      json << ",\"s\":\"t\"";
+    }
+    json << "}";
+
+    threads.insert( tid );
+    written++;
+  }
+
+  for ( const pid_t tid : threads ) {
+    json << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+         << ",\"tid\":" << tid << ",\"args\":{\"name\":\""
+         << json_escape( thread_name( tid ) ) << "\"}}";
+  }
+
+  json << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":"
+       << active->dropped.load( memory_order_relaxed )
+       << ",\"overwritten_events\":" << begin << "}}\n";
+
+  ofstream file { filename };
+  file << json.str();
+  if ( not file ) {
+    throw runtime_error( "could not write " + filename );
+  }
+
+  return written;
+}
+
+}
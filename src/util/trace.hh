@@ -0,0 +1,79 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "latency.hh"
+
+/* Optional event tracing, written out in Chrome's trace-event JSON format
+   (for chrome://tracing or ui.perfetto.dev).
+
+   enable() allocates a fixed-size ring; after that, each event claims the
+   next slot with one atomic increment and fills it in, so recording never
+   locks or allocates. Once the ring is full, each event overwrites the
+   oldest one, so the trace always holds the most recent `capacity` events.
+   Each slot carries a sequence number, so write_json() skips slots that
+   are being written while it reads them. Until enable() is called, a Span
+   costs one relaxed load and a branch.
+
+   Event names and categories must be string literals (or otherwise live
+   for the rest of the process), since only the pointers are stored. */
+
+namespace trace {
+
+inline std::atomic<bool> enabled_flag { false };
+
+inline bool enabled()
+{
+  return enabled_flag.load( std::memory_order_relaxed );
+}
+
+// Starts recording, into a ring of `capacity` events; call at most once
+void enable( const size_t capacity = 1 << 20 );
+
+void record_span( const char* name,
+                  const char* category,
+                  const uint64_t start_ns,
+                  const uint64_t end_ns );
+
+void record_instant( const char* name, const char* category );
+
+// Records the time from construction to destruction, if tracing is enabled
+class Span
+{
+private:
+  const char* name_;
+  const char* category_;
+  uint64_t start_ns_;
+
+public:
+  Span( const char* name, const char* category )
+    : name_( name )
+    , category_( category )
+    , start_ns_( enabled() ? latency::now_ns() : 0 )
+  {}
+
+  ~Span()
+  {
+    if ( start_ns_ ) {
+      record_span( name_, category_, start_ns_, latency::now_ns() );
+    }
+  }
+
+  /* forbid copying */
+  Span( const Span& other ) = delete;
+  Span& operator=( const Span& other ) = delete;
+};
+
+// Writes the events still in the ring, oldest first; returns how many were
+// written
+size_t write_json( const std::string& filename );
+
+}
+
+#endif /* TRACE_HH */
@@ -0,0 +1,242 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#include "y4m_recorder.hh"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+
+#include "exception.hh"
+#include "input/yuv4mpeg.hh"
+#include "pixel_convert.hh"
+
+using namespace std;
+
+static int open_output( const string& filename, bool& direct_io )
+{
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+  if ( direct_io ) {
+    const int fd = open( filename.c_str(), flags | O_DIRECT, 0644 );
+    if ( fd >= 0 ) {
+      return fd;
+    }
+
+    /* some filesystems (e.g. tmpfs) don't support O_DIRECT */
+    if ( errno != EINVAL ) {
+      throw unix_error( filename );
+    }
+    direct_io = false;
+  }
+
+  return SystemCall( filename, open( filename.c_str(), flags, 0644 ) );
+}
+
+Y4MRecorder::Y4MRecorder( const string& filename,
+                          const uint16_t width,
+                          const uint16_t height,
+                          const uint16_t fps_numerator,
+                          const uint16_t fps_denominator,
+                          const unsigned int queue_depth,
+                          const OverflowPolicy overflow_policy,
+                          const bool direct_io )
+  : width_( width )
+  , height_( height )
+  , overflow_policy_( overflow_policy )
+  , direct_io_( direct_io )
+  , fd_( open_output( filename, direct_io_ ) )
+{
+  if ( queue_depth == 0 ) {
+    throw runtime_error( "Y4MRecorder needs at least one slot" );
+  }
+
+  void* staging;
+  if ( posix_memalign( &staging, IO_ALIGNMENT, STAGING_SIZE ) ) {
+    throw runtime_error( "could not allocate staging buffer" );
+  }
+  staging_.reset( static_cast<uint8_t*>( staging ) );
+
+  for ( unsigned int i = 0; i < queue_depth; i++ ) {
+    slots_.emplace_back(
+      make_unique<RGBRaster>( width, height, width, height ) );
+    free_slots_.push( slots_.back().get() );
+  }
+
+  const BaseRaster shape { width, height, width, height };
+  YUV4MPEGHeader header { shape };
+  header.fps_numerator = fps_numerator;
+  header.fps_denominator = fps_denominator;
+  yuv_.resize( header.frame_length() );
+
+  const string header_str = header.to_string();
+  stage( reinterpret_cast<const uint8_t*>( header_str.data() ),
+         header_str.size() );
+
+  writer_thread_ = thread( &Y4MRecorder::writer_loop, this );
+}
+
+Y4MRecorder::~Y4MRecorder()
+{
+  {
+    lock_guard<mutex> lock( lock_ );
+    terminate_ = true;
+  } // End of lock scope
+  cv_filled_.notify_all();
+
+  writer_thread_.join();
+
+  if ( writer_error_ ) {
+    try {
+      rethrow_exception( writer_error_ );
+    } catch ( const exception& e ) {
+      cerr << "Y4MRecorder: " << e.what() << endl;
+    }
+  }
+}
+
+bool Y4MRecorder::record( const RGBRaster& frame )
+{
+  if ( frame.display_width() != width_ or frame.display_height() != height_ ) {
+    throw runtime_error( "size mismatch" );
+  }
+
+  RGBRaster* slot;
+
+  {
+    unique_lock<mutex> lock( lock_ );
+
+    if ( writer_error_ ) {
+      rethrow_exception( writer_error_ );
+    }
+
+    if ( free_slots_.empty() ) {
+      if ( overflow_policy_ == OverflowPolicy::Drop ) {
+        statistics_.dropped_frames++;
+        return false;
+      }
+
+      statistics_.backpressured_frames++;
+      cv_free_.wait(
+        lock, [&] { return not free_slots_.empty() or writer_error_; } );
+
+      if ( writer_error_ ) {
+        rethrow_exception( writer_error_ );
+      }
+    }
+
+    slot = free_slots_.front();
+    free_slots_.pop();
+  } // End of lock scope
+
+  slot->R().copy_from( frame.R() );
+  slot->G().copy_from( frame.G() );
+  slot->B().copy_from( frame.B() );
+
+  {
+    lock_guard<mutex> lock( lock_ );
+    filled_slots_.push( slot );
+  } // End of lock scope
+  cv_filled_.notify_one();
+
+  return true;
+}
+
+Y4MRecorder::Statistics Y4MRecorder::statistics()
+{
+  lock_guard<mutex> lock( lock_ );
+  return statistics_;
+}
+
+void Y4MRecorder::writer_loop()
+{
+  static const string frame_header = "FRAME\n";
+
+  const size_t y_length = width_ * height_;
+  const size_t uv_length = ( yuv_.size() - y_length ) / 2;
+
+  try {
+    while ( true ) {
+      RGBRaster* slot;
+
+      {
+        unique_lock<mutex> lock( lock_ );
+        cv_filled_.wait(
+          lock, [&] { return terminate_ or not filled_slots_.empty(); } );
+
+        /* drain the queue before exiting */
+        if ( filled_slots_.empty() ) {
+          break;
+        }
+
+        slot = filled_slots_.front();
+        filled_slots_.pop();
+      } // End of lock scope
+
+      pixel_convert::rgb_to_yuv420( *slot,
+                                    yuv_.data(),
+                                    yuv_.data() + y_length,
+                                    yuv_.data() + y_length + uv_length );
+
+      {
+        lock_guard<mutex> lock( lock_ );
+        free_slots_.push( slot );
+      } // End of lock scope
+      cv_free_.notify_one();
+
+      stage( reinterpret_cast<const uint8_t*>( frame_header.data() ),
+             frame_header.size() );
+      stage( yuv_.data(), yuv_.size() );
+
+      {
+        lock_guard<mutex> lock( lock_ );
+        statistics_.recorded_frames++;
+      } // End of lock scope
+    }
+
+    flush_staging( true );
+  } catch ( ... ) {
+    {
+      lock_guard<mutex> lock( lock_ );
+      writer_error_ = current_exception();
+    } // End of lock scope
+    cv_free_.notify_all();
+  }
+}
+
+void Y4MRecorder::stage( const uint8_t* data, size_t length )
+{
+  while ( length > 0 ) {
+    const size_t amount = min( length, STAGING_SIZE - staged_ );
+    memcpy( staging_.get() + staged_, data, amount );
+    staged_ += amount;
+    data += amount;
+    length -= amount;
+
+    if ( staged_ == STAGING_SIZE ) {
+      flush_staging( false );
+    }
+  }
+}
+
+void Y4MRecorder::flush_staging( const bool final )
+{
+  if ( staged_ == 0 ) {
+    return;
+  }
+
+  /* O_DIRECT needs aligned lengths; the tail of the file is written
+     through the page cache */
+  if ( final and direct_io_ and staged_ % IO_ALIGNMENT ) {
+    const int flags = SystemCall( "fcntl", fcntl( fd_.fd_num(), F_GETFL ) );
+    SystemCall( "fcntl", fcntl( fd_.fd_num(), F_SETFL, flags & ~O_DIRECT ) );
+  }
+
+  fd_.write( Chunk { staging_.get(), staged_ } );
+
+  {
+    lock_guard<mutex> lock( lock_ );
+    statistics_.bytes_written += staged_;
+  } // End of lock scope
+
+  staged_ = 0;
+}
@@ -0,0 +1,103 @@
+/* -*-mode:c++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+
+#ifndef Y4M_RECORDER_HH
+#define Y4M_RECORDER_HH
+
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_descriptor.hh"
+#include "raster.hh"
+
+/* Records RGB frames (e.g. the composited program output) to a 4:2:0 Y4M
+   file without doing any I/O on the caller's thread.
+
+   record() copies the frame into one of a fixed number of preallocated
+   slots and returns. A writer thread converts each queued frame to 4:2:0,
+   appends it to a large aligned staging buffer, and writes the buffer out
+   whenever it fills, optionally with O_DIRECT to keep the recording out of
+   the page cache. When every slot is in use, record() either drops the
+   frame or waits for the writer, depending on the overflow policy, and
+   counts the event either way. */
+
+class Y4MRecorder
+{
+public:
+  enum class OverflowPolicy
+  {
+    Drop,
+    Block
+  };
+
+  struct Statistics
+  {
+    uint64_t recorded_frames;
+    uint64_t dropped_frames;
+    uint64_t backpressured_frames;
+    uint64_t bytes_written;
+  };
+
+private:
+  static constexpr size_t IO_ALIGNMENT = 4096;
+  static constexpr size_t STAGING_SIZE = 4 << 20;
+
+  const uint16_t width_;
+  const uint16_t height_;
+  const OverflowPolicy overflow_policy_;
+
+  bool direct_io_;
+  FileDescriptor fd_;
+
+  std::vector<std::unique_ptr<RGBRaster>> slots_ {};
+
+  std::mutex lock_ {};
+  std::condition_variable cv_free_ {};
+  std::condition_variable cv_filled_ {};
+  std::queue<RGBRaster*> free_slots_ {};
+  std::queue<RGBRaster*> filled_slots_ {};
+  Statistics statistics_ {};
+  std::exception_ptr writer_error_ {};
+  bool terminate_ { false };
+
+  // Used only by the writer thread
+  std::unique_ptr<uint8_t, decltype( &free )> staging_ { nullptr, free };
+  size_t staged_ { 0 };
+  std::vector<uint8_t> yuv_ {};
+
+  std::thread writer_thread_ {};
+
+  void writer_loop();
+  void stage( const uint8_t* data, size_t length );
+  void flush_staging( const bool final );
+
+public:
+  Y4MRecorder( const std::string& filename,
+               const uint16_t width,
+               const uint16_t height,
+               const uint16_t fps_numerator = 30,
+               const uint16_t fps_denominator = 1,
+               const unsigned int queue_depth = 8,
+               const OverflowPolicy overflow_policy = OverflowPolicy::Drop,
+               const bool direct_io = false );
+
+  // Writes out every queued frame before closing the file
+  ~Y4MRecorder();
+
+  /* forbid copying */
+  Y4MRecorder( const Y4MRecorder& other ) = delete;
+  Y4MRecorder& operator=( const Y4MRecorder& other ) = delete;
+
+  // Returns false if the frame was dropped
+  bool record( const RGBRaster& frame );
+
+  Statistics statistics();
+};
+
+#endif /* Y4M_RECORDER_HH */